@@ -0,0 +1,89 @@
+#ifndef INCLUDE_LABYRINTH_CORE_DIM_ARRAY_HPP_
+#define INCLUDE_LABYRINTH_CORE_DIM_ARRAY_HPP_
+
+#include <array>
+
+#include <cstddef>
+
+namespace labyrinth_core {
+
+/**
+ * One value per axis. If N is positive, the number of axes is known at
+ * compile time and this is just a std::array, so loops over it can be
+ * unrolled and the values kept in registers. If N is 0, the number of axes
+ * is only known at runtime, and the values live on the heap.
+ */
+template<class T, size_t N>
+class DimArray {
+
+	std::array<T, N> arr;
+
+public:
+	DimArray() {}
+
+	// the size is N no matter what; this is so both kinds construct the same
+	explicit DimArray(size_t) {}
+
+	T* data() {
+		return arr.data();
+	}
+
+	const T* data() const {
+		return arr.data();
+	}
+
+	T& operator[](size_t i) {
+		return arr[i];
+	}
+
+	const T& operator[](size_t i) const {
+		return arr[i];
+	}
+
+};
+
+template<class T>
+class DimArray<T, 0> {
+
+	T* arr;
+
+public:
+	/**
+	 * Doesn't allocate anything. Don't index into this.
+	 */
+	DimArray(): arr(nullptr) {}
+
+	explicit DimArray(size_t size): arr(new T[size]) {}
+
+	DimArray(DimArray& other) = delete;
+	DimArray(const DimArray& other) = delete;
+	DimArray(DimArray&& other) = delete;
+	DimArray& operator=(DimArray& other) = delete;
+	DimArray& operator=(const DimArray& other) = delete;
+	DimArray& operator=(DimArray&& other) = delete;
+
+	~DimArray() {
+		delete[] arr;
+	}
+
+	T* data() {
+		return arr;
+	}
+
+	const T* data() const {
+		return arr;
+	}
+
+	T& operator[](size_t i) {
+		return arr[i];
+	}
+
+	const T& operator[](size_t i) const {
+		return arr[i];
+	}
+
+};
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_DIM_ARRAY_HPP_ */
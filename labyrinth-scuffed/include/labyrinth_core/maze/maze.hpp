@@ -2,14 +2,25 @@
 #define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_HPP_
 
 #include <labyrinth_core/color.hpp>
+#include <labyrinth_core/num_threads.hpp>
+#include <labyrinth_core/maze/maze_random.hpp>
+#include <labyrinth_core/maze/maze_storage.hpp>
+#include <labyrinth_core/maze/occupancy_pyramid.hpp>
+#include <labyrinth_core/maze/paged_array.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <random>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 
@@ -17,13 +28,79 @@ namespace labyrinth_core {
 
 namespace maze {
 
+/**
+ * Where each block goes in memory. ROW_MAJOR is the usual thing, so a ray
+ * going along the first axis jumps a whole slice each step. BRICKED splits
+ * the maze into bricks of 4 by 4 by ... blocks, each stored contiguously,
+ * so that a ray stays within the same few cache lines along any axis.
+ * BRICKED pads each axis to a multiple of 4, and bricks have 4^numDims
+ * blocks, so it is meant for mazes of not too many dimensions.
+ * CHUNKED is BRICKED, but with each brick allocated on its own, and
+ * bricks that are all the same block stored as just that block, so that
+ * big mazes only take up memory where there is something going on.
+ * Generating a CHUNKED maze starts each brick off as a single random
+ * wall block instead of every block being random, so a seed doesn't give
+ * the same maze as it does with the other layouts.
+ */
+enum class MazeLayout {
+	ROW_MAJOR, BRICKED, CHUNKED
+};
+
+/**
+ * How a maze gets carved. HEADS sends out random walkers that branch and
+ * die, which is what most of the generation options are for, and how long
+ * it takes depends on luck and on maxUseless.
+ * The others carve only the blocks at odd coordinates and walls between
+ * them, so that there is exactly one path between any two of those, and
+ * only look at the seed, the dimensions, the storage mode and the layout.
+ * KRUSKAL knocks walls down in a random order, unless what is on both
+ * sides is already connected. BACKTRACKER goes wherever it hasn't been
+ * yet, backing up when it gets stuck, which makes long winding passages.
+ * WILSON joins random walks up with their loops taken out, which makes
+ * every possible maze equally likely, but takes a random amount of time.
+ */
+enum class MazeAlgorithm {
+	HEADS, KRUSKAL, BACKTRACKER, WILSON
+};
+
+class MazeFile;
+class MazeGenerator;
+
+/**
+ * Copying a maze is cheap: the copy shares everything with it, and
+ * whichever of them gets changed first copies what it changes then, so
+ * a copy is a snapshot of the maze that stays the same however the maze
+ * changes later. With the CHUNKED layout, only the bricks that get changed
+ * are copied; otherwise, the first change after a copy copies all the
+ * blocks. The distance field and the occupancy pyramid are split into
+ * pages, and only the pages a change touches are copied. Copies can be
+ * read from on other threads while the maze is changed, but the maze must
+ * be copied on the thread changing it.
+ */
 class Maze {
 
-	std::uint8_t* data;
+	friend MazeFile;
+	friend MazeGenerator;
+
+	std::shared_ptr<MazeStorage> data;
 	size_t dataLength;
 	size_t numDims;
-	std::uint32_t* dimensions;
-	size_t* tempProds;
+	// these four never change once made, so copies just share them
+	std::shared_ptr<std::uint32_t[]> dimensions;
+	// row-major products of the dimensions, whatever the layout
+	std::shared_ptr<size_t[]> tempProds;
+	MazeLayout layout;
+	// the index of a block is the sum over each axis of
+	// brickStrides[i] * (coord / 4) + innerStrides[i] * (coord % 4)
+	std::shared_ptr<size_t[]> brickStrides;
+	std::shared_ptr<size_t[]> innerStrides;
+	// Chebyshev distance from each block to the nearest non-air block,
+	// capped at maxDistance, in pages of 2^16. nullptr unless
+	// buildDistanceField is called.
+	std::shared_ptr<PagedArray<std::uint8_t>> distances;
+	std::uint8_t maxDistance;
+	// nullptr unless buildOccupancyPyramid is called.
+	std::shared_ptr<OccupancyPyramid> pyramid;
 
 public:
 	class MazeGenerationOptions {
@@ -39,6 +116,11 @@ public:
 		double loopProbability;
 		double blockProbability;
 		size_t maxUseless;
+		StorageMode storageMode = StorageMode::BYTE;
+		MazeLayout layout = MazeLayout::ROW_MAJOR;
+		size_t numThreads = 1;
+		MazeAlgorithm algorithm = MazeAlgorithm::HEADS;
+		RandomEngine randomEngine = RandomEngine::MT19937;
 
 		void validateDimensions() {
 			for (size_t i = 0; i < dimensions.size(); i++) {
@@ -164,94 +246,250 @@ public:
 			}
 		}
 
+		StorageMode getStorageMode() const {
+			return storageMode;
+		}
+
+		void setStorageMode(StorageMode newStorageMode) {
+			storageMode = newStorageMode;
+		}
+
+		MazeLayout getLayout() const {
+			return layout;
+		}
+
+		void setLayout(MazeLayout newLayout) {
+			layout = newLayout;
+		}
+
+		size_t getNumThreads() const {
+			return numThreads;
+		}
+
+		/**
+		 * More than 1 splits the maze into that many slabs along the first
+		 * axis, which get carved at once and then joined up, so the maze
+		 * depends on this as well as on the seed. Fewer slabs get used if
+		 * the maze is too thin for that many.
+		 */
+		void setNumThreads(size_t newNumThreads) {
+			numThreads = std::max(static_cast<size_t>(1), newNumThreads);
+		}
+
+		MazeAlgorithm getAlgorithm() const {
+			return algorithm;
+		}
+
+		/**
+		 * Only HEADS uses more than 1 thread.
+		 */
+		void setAlgorithm(MazeAlgorithm newAlgorithm) {
+			algorithm = newAlgorithm;
+		}
+
+		RandomEngine getRandomEngine() const {
+			return randomEngine;
+		}
+
+		void setRandomEngine(RandomEngine newRandomEngine) {
+			randomEngine = newRandomEngine;
+		}
+
 	};
 
-	Maze(size_t inNumDims, const std::uint32_t* inDimensions): numDims(inNumDims) {
-		if (numDims < 2) {
-			numDims = 2;
+	/**
+	 * How far along generating a maze is. Every block carved since the last
+	 * one of these is in the box [dirtyLo, dirtyHi), which is empty if
+	 * nothing was. Once it is done, the box is the whole maze.
+	 */
+	struct MazeGenerationProgress {
+
+		size_t numBlocksBroken;
+		// heads still carving, over all the slabs. 0 unless HEADS.
+		size_t numHeads;
+		// the longest streak of useless steps of any slab. 0 unless HEADS.
+		size_t streakOfUseless;
+		std::vector<std::int32_t> dirtyLo;
+		std::vector<std::int32_t> dirtyHi;
+		bool isDone;
+
+	};
+
+	/**
+	 * What solve found. distances has how many steps it takes to get from
+	 * (1, 1, ...) to each block, by index, or unreachable. path has the
+	 * indices of the blocks along a shortest way from (1, 1, ...) to the
+	 * nearest air block on the outside of the maze, and is empty if there
+	 * is no way out.
+	 */
+	struct MazeSolution {
+
+		static constexpr std::uint32_t unreachable = 0xFFFFFFFF;
+
+		std::vector<std::uint32_t> distances;
+		std::vector<size_t> path;
+		// how many blocks can be got to, and how far the farthest one is
+		size_t numReached;
+		std::uint32_t maxDistance;
+
+	};
+
+private:
+	/**
+	 * Works out brickStrides, innerStrides and dataLength
+	 * from dimensions and tempProds.
+	 */
+	void initLayout(MazeLayout newLayout) {
+		layout = newLayout;
+		brickStrides.reset(new size_t[numDims]);
+		innerStrides.reset(new size_t[numDims]);
+		if (layout == MazeLayout::ROW_MAJOR) {
+			for (size_t i = 0; i < numDims; i++) {
+				innerStrides[i] = tempProds[i];
+				brickStrides[i] = 4 * tempProds[i];
+			}
+			dataLength = tempProds[0] * dimensions[0];
+			return;
+		}
+		size_t brickSize = 1;
+		for (size_t i = numDims; i-- > 0;) {
+			innerStrides[i] = brickSize;
+			brickSize *= 4;
+		}
+		size_t currProd = brickSize;
+		for (size_t i = numDims; i-- > 0;) {
+			brickStrides[i] = currProd;
+			currProd *= (dimensions[i] + 3) / 4;
+		}
+		dataLength = currProd;
+	}
+
+	/**
+	 * A new MazeStorage for the blocks, chunked if the layout says so.
+	 */
+	MazeStorage* makeStorage(StorageMode storageMode) const {
+		// the stride of the last axis is how long a brick is
+		size_t chunkLength = (layout == MazeLayout::CHUNKED)?
+				brickStrides[numDims - 1]: 0;
+		return new MazeStorage(dataLength, storageMode, chunkLength);
+	}
+
+	/**
+	 * Calls f(ind) for every block, in row-major order
+	 * of their coordinates, whatever the layout.
+	 */
+	template<class F>
+	void forEachBlock(const F& f) const {
+		std::vector<std::int32_t> loc (numDims, 0);
+		size_t numBlocks = tempProds[0] * dimensions[0];
+		for (size_t k = 0; k < numBlocks; k++) {
+			f(getInd(loc.begin()));
+			for (size_t i = numDims; i-- > 0;) {
+				if (++loc[i] < static_cast<std::int32_t>(dimensions[i])) {
+					break;
+				}
+				loc[i] = 0;
+			}
+		}
+	}
+
+	/**
+	 * The index of the block that would be at rowMajorInd if the layout
+	 * were ROW_MAJOR.
+	 */
+	size_t fromRowMajor(size_t rowMajorInd) const {
+		if (layout == MazeLayout::ROW_MAJOR) {
+			return rowMajorInd;
 		}
-		dimensions = new std::uint32_t[numDims];
-		tempProds = new std::uint64_t[numDims];
+		size_t toreturn = 0;
+		for (size_t i = 0; i < numDims; i++) {
+			std::int32_t coord = rowMajorInd / tempProds[i];
+			rowMajorInd -= coord * tempProds[i];
+			toreturn += getAxisOffset(i, coord);
+		}
+		return toreturn;
+	}
+
+	/**
+	 * For MazeFile. Takes ownership of storage.
+	 */
+	Maze(size_t inNumDims, const std::uint32_t* inDimensions,
+			MazeLayout inLayout, MazeStorage* storage): numDims(inNumDims) {
+		dimensions.reset(new std::uint32_t[numDims]);
+		tempProds.reset(new size_t[numDims]);
 		size_t currProd = 1;
 		for (std::int64_t j = numDims - 1; j >= 0; j--) {
 			tempProds[j] = currProd;
-			currProd *=
-					(dimensions[j] =
-							std::max(
-									static_cast<std::uint32_t>(3),
-									inDimensions[j]));
-		}
-		dataLength = currProd;
-		data = new std::uint8_t[dataLength];
-		std::mt19937 mtrand (1);
-		std::uniform_int_distribution<std::int16_t> distro (0, 20);
-		for (size_t i = 0; i < dataLength; i++) {
-			data[i] = distro(mtrand) > 0? 0: 1;
+			currProd *= (dimensions[j] = inDimensions[j]);
 		}
+		initLayout(inLayout);
+		data.reset(storage);
+		maxDistance = 0;
 	}
 
-	explicit Maze(const MazeGenerationOptions& options) {
-		std::vector<std::uint32_t> dims = options.getDimensions();
+	/**
+	 * For generating into, here and in MazeGenerator. Every block is 0
+	 * until it gets filled.
+	 */
+	Maze(const std::vector<std::uint32_t>& dims, StorageMode storageMode,
+			MazeLayout inLayout) {
 		numDims = dims.size();
 		if (numDims < 2) {
 			numDims = 2;
 		}
-		dimensions = new std::uint32_t[numDims];
-		tempProds = new std::uint64_t[numDims];
+		dimensions.reset(new std::uint32_t[numDims]);
+		tempProds.reset(new size_t[numDims]);
 		size_t currProd = 1;
 		for (std::int64_t j = numDims - 1; j >= 0; j--) {
 			tempProds[j] = currProd;
 			currProd *= (dimensions[j] = dims[j]);
 		}
-		dataLength = currProd;
-		data = new std::uint8_t[dataLength];
-		generate(options);
+		initLayout(inLayout);
+		data.reset(makeStorage(storageMode));
+		maxDistance = 0;
 	}
 
-	Maze(Maze& other) = delete;
-	Maze(const Maze& other) = delete;
-	Maze(Maze&& other) = delete;
-	Maze& operator=(Maze& other) = delete;
-	Maze& operator=(const Maze& other) = delete;
-	Maze& operator=(Maze&& other) = delete;
-
-	/**
-	 * Shallow copy.
-	 */
-	Maze(const Maze& other, int): data(other.data), dataLength(other.dataLength),
-			numDims(other.numDims), dimensions(other.dimensions),
-			tempProds(other.tempProds) {}
+public:
+	Maze(size_t inNumDims, const std::uint32_t* inDimensions,
+			StorageMode storageMode = StorageMode::BYTE,
+			MazeLayout inLayout = MazeLayout::ROW_MAJOR): numDims(inNumDims) {
+		if (numDims < 2) {
+			numDims = 2;
+		}
+		dimensions.reset(new std::uint32_t[numDims]);
+		tempProds.reset(new size_t[numDims]);
+		size_t currProd = 1;
+		for (std::int64_t j = numDims - 1; j >= 0; j--) {
+			tempProds[j] = currProd;
+			currProd *=
+					(dimensions[j] =
+							std::max(
+									static_cast<std::uint32_t>(3),
+									inDimensions[j]));
+		}
+		initLayout(inLayout);
+		data.reset(makeStorage(storageMode));
+		maxDistance = 0;
+		std::mt19937 mtrand (1);
+		std::uniform_int_distribution<std::int16_t> distro (0, 20);
+		forEachBlock([this, &mtrand, &distro] (size_t ind) -> void {
+			data->set(ind, distro(mtrand) > 0? 0: 1);
+		});
+	}
 
-	/**
-	 * Shallow copy.
-	 */
-	Maze& operator()(const Maze& other, int) {
-		delete[] data;
-		data = other.data;
-		dataLength = other.dataLength;
-		numDims = other.numDims;
-		delete[] dimensions;
-		dimensions = other.dimensions;
-		delete[] tempProds;
-		tempProds = other.tempProds;
-		return *this;
+	explicit Maze(const MazeGenerationOptions& options):
+			Maze(options.getDimensions(), options.getStorageMode(),
+					options.getLayout()) {
+		generate(options);
 	}
 
 	/**
-	 * If you shallow copied it somewhere,
-	 * call this before going out of scope.
+	 * Shares everything with other, until one of them is changed.
 	 */
-	void invalidate() {
-		data = nullptr;
-		dimensions = nullptr;
-		tempProds = nullptr;
-	}
-
-	~Maze() {
-		delete[] data;
-		delete[] dimensions;
-		delete[] tempProds;
-	}
+	Maze(const Maze& other) = default;
+	Maze(Maze&& other) = default;
+	Maze& operator=(const Maze& other) = default;
+	Maze& operator=(Maze&& other) = default;
 
 	size_t getNumDims() const {
 		return numDims;
@@ -262,7 +500,7 @@ public:
 	 */
 	std::uint32_t* getDimensions() const {
 		std::uint32_t* toreturn = new std::uint32_t[numDims];
-		std::copy(dimensions, dimensions + numDims, toreturn);
+		std::copy(dimensions.get(), dimensions.get() + numDims, toreturn);
 		return toreturn;
 	}
 
@@ -272,11 +510,9 @@ public:
 				std::int32_t
 				>::value>::type>
 	size_t getInd(Iter location) const {
-		std::uint64_t* tmpTempProds = tempProds;
-		std::uint64_t* tempProdsEnd = tempProds + numDims;
 		size_t result = 0;
-		for (; tmpTempProds < tempProdsEnd; ++tmpTempProds, ++location) {
-			result += (*tmpTempProds) * (*location);
+		for (size_t i = 0; i < numDims; ++i, ++location) {
+			result += getAxisOffset(i, *location);
 		}
 		return result;
 	}
@@ -287,8 +523,20 @@ public:
 			std::int32_t
 			>::value>::type>
 	void fromInd(size_t ind, Iter location) const {
-		std::uint64_t* tmpTempProds = tempProds;
-		std::uint64_t* tempProdsEnd = tempProds + numDims;
+		if (layout != MazeLayout::ROW_MAJOR) {
+			Iter brickLocation = location;
+			for (size_t i = 0; i < numDims; ++i, ++brickLocation) {
+				*brickLocation = 4 * (ind / brickStrides[i]);
+				ind %= brickStrides[i];
+			}
+			for (size_t i = 0; i < numDims; ++i, ++location) {
+				*location += ind / innerStrides[i];
+				ind %= innerStrides[i];
+			}
+			return;
+		}
+		std::uint64_t* tmpTempProds = tempProds.get();
+		std::uint64_t* tempProdsEnd = tempProds.get() + numDims;
 		std::uint64_t tmp;
 		std::uint64_t tmpTempProd;
 		for (; tmpTempProds < tempProdsEnd; ++tmpTempProds, ++location) {
@@ -298,8 +546,57 @@ public:
 		}
 	}
 
+	MazeLayout getLayout() const {
+		return layout;
+	}
+
+	/**
+	 * What coordinate coord along axis adds to the index of a block.
+	 * The index of a block is the sum of these over all the axes.
+	 */
+	size_t getAxisOffset(size_t axis, std::int32_t coord) const {
+		return brickStrides[axis] * (coord >> 2) +
+				innerStrides[axis] * (coord & 3);
+	}
+
+	/**
+	 * How much the index of a block changes when its coordinate
+	 * along axis goes from coord to coord + 1.
+	 */
+	size_t getStride(size_t axis, std::int32_t coord) const {
+		return ((coord & 3) == 3)?
+				brickStrides[axis] - 3 * innerStrides[axis]: innerStrides[axis];
+	}
+
+	/**
+	 * Copies what getAxisOffset uses, numDims of each.
+	 */
+	void getLayoutStrides(size_t* outBrickStrides,
+			size_t* outInnerStrides) const {
+		std::copy(brickStrides.get(), brickStrides.get() + numDims,
+				outBrickStrides);
+		std::copy(innerStrides.get(), innerStrides.get() + numDims,
+				outInnerStrides);
+	}
+
 	std::uint8_t getBlock(size_t ind) const {
-		return data[ind];
+		return data->get(ind);
+	}
+
+	/**
+	 * Same as getBlock(ind) != 0, but only looks at a bit.
+	 */
+	bool isOccupied(size_t ind) const {
+		return data->isOccupied(ind);
+	}
+
+	/**
+	 * Whether the block at ind is in a brick that is all air, which means
+	 * 4 by 4 by ... blocks, starting at multiples of 4. Only ever true if
+	 * the layout is CHUNKED.
+	 */
+	bool isChunkEmpty(size_t ind) const {
+		return data->isChunkEmpty(ind);
 	}
 
 	template<class Iter, class = typename std::enable_if<
@@ -311,8 +608,33 @@ public:
 		return getBlock(getInd(location));
 	}
 
+	/**
+	 * Copies of this made before keep the block they had.
+	 * With a distance field, putting a wall in looks at the
+	 * (2 * maxDistance + 1)^numDims blocks within maxDistance of it, but
+	 * taking one out works all of those out again from the
+	 * (4 * maxDistance + 1)^numDims blocks within 2 * maxDistance, which is
+	 * about 1.2 million in 4D at the default maxDistance of 8.
+	 */
 	void setBlock(size_t ind, std::uint8_t newBlock) {
-		data[ind] = newBlock;
+		bool isChange = data->isOccupied(ind) != (newBlock != 0);
+		unshareBlocks();
+		data->set(ind, newBlock);
+		if (distances && isChange) {
+			if (distances.use_count() > 1) {
+				// just the table of pages, which are copied as they change
+				distances = std::make_shared<PagedArray<std::uint8_t>>(*distances);
+			}
+			updateDistanceField(ind, newBlock != 0);
+		}
+		if (pyramid && isChange) {
+			if (pyramid.use_count() > 1) {
+				pyramid = std::make_shared<OccupancyPyramid>(*pyramid);
+			}
+			std::vector<std::int32_t> location (numDims);
+			fromInd(ind, location.begin());
+			pyramid->update(location.data(), newBlock != 0);
+		}
 	}
 
 	template<class Iter, class = typename std::enable_if<
@@ -325,149 +647,708 @@ public:
 	}
 
 	/**
-	 * Offsets is location relative to the center of the block.
+	 * Copies everything this still shares with copies of it, the blocks,
+	 * the distance field and the occupancy pyramid, so that changing it
+	 * later doesn't have to copy any of them.
 	 */
-	static Color getBlockColor(std::uint8_t block,
-			size_t numDims, const double* offsets) {
-		if (block == 0) {
-			return Color{0, 0, 0, 0};
-		} else {
-			double sum = 0;
-			const double* offsetsEnd = offsets + numDims;
-			for (; offsets < offsetsEnd; ++offsets) {
-				sum += *offsets;
-			}
-			// normalize from (-n/2, n/2) to (50, 206)
-			std::uint8_t value = 128 + (sum * 106 / numDims);
-			switch(block) {
-			case 1:
-				return Color{value, value, value, 0xFF};
-			case 2:
-				return Color{value, 0, 0, 0xFF};
-			case 3:
-				return Color{0, value, 0, 0xFF};
-			case 4:
-				return Color{0, 0, value, 0xFF};
-			case 5:
-				return Color{value, value, 0, 0xFF};
-			case 6:
-				return Color{value, 0, value, 0xFF};
-			case 7:
-				return Color{0, value, value, 0xFF};
-			}
-			return Color{value, value, value, 0xFF};
+	void unshare() {
+		unshareBlocks();
+		data->ownChunks();
+		if (distances) {
+			distances = std::make_shared<PagedArray<std::uint8_t>>(*distances);
+			distances->ownPages();
+		}
+		if (pyramid) {
+			pyramid = std::make_shared<OccupancyPyramid>(*pyramid);
+			pyramid->ownWords();
 		}
 	}
 
 private:
-	class Head {
-
-		// this is positive only when it is just created from branching.
-		size_t newNess;
-		// location
-		size_t ind;
-		std::vector<std::int32_t> loc;
-		// index of dimension if positive,
-		// plus numDims if negative.
-		std::vector<size_t> prevDirs;
+	/**
+	 * Makes sure no copy of this shares data, so that it can be changed.
+	 * With chunks, the copies still share the chunks, until they change.
+	 */
+	void unshareBlocks() {
+		if (data.use_count() > 1) {
+			data.reset(data->share());
+		}
+	}
 
-		bool isLocFine(const Maze& maze, size_t prevInd) const {
-			size_t numDims = maze.getNumDims();
-			if (maze.getBlock(ind) == 0) {
-				return false;
-			}
-			for (size_t dir = 0; dir < numDims * 2; dir++) {
-				size_t indInConsideration;
-				if (dir < numDims) {
-					if (loc[dir] + 1 >=
-							static_cast<std::int32_t>(maze.dimensions[dir] - 1)) {
-						continue;
-					}
-					indInConsideration = ind + maze.tempProds[dir];
-				} else {
-					if (loc[dir - numDims] - 1 <= 0) {
-						continue;
-					}
-					indInConsideration = ind - maze.tempProds[dir - numDims];
-				}
-				if (indInConsideration == prevInd) {
-					continue;
-				}
-				if (maze.getBlock(indInConsideration) == 0) {
-					return false;
+	/**
+	 * Computes the Chebyshev distance from each block in the box [lo, hi)
+	 * to the nearest non-air block in the box, capped at maxDistance,
+	 * into box, which is laid out row-major over the box.
+	 * This is the separable algorithm by Meijster et al., done one axis at
+	 * a time, so it is linear in the size of the box.
+	 */
+	void transformBox(const std::int32_t* lo, const std::int32_t* hi,
+			std::int32_t* box) const {
+		// bigger than any distance, but with room to add coordinates to it
+		const std::int32_t inf = 1 << 29;
+		std::vector<size_t> boxDims (numDims);
+		std::vector<size_t> boxProds (numDims);
+		size_t boxSize = 1;
+		for (size_t i = numDims; i-- > 0;) {
+			boxDims[i] = hi[i] - lo[i];
+			boxProds[i] = boxSize;
+			boxSize *= boxDims[i];
+		}
+		std::vector<std::int32_t> loc (lo, lo + numDims);
+		for (size_t k = 0; k < boxSize; k++) {
+			box[k] = (getBlock(loc.begin()) == 0)? inf: 0;
+			for (size_t i = numDims; i-- > 0;) {
+				if (++loc[i] < hi[i]) {
+					break;
 				}
+				loc[i] = lo[i];
 			}
-			return true;
 		}
 
-		/**
-		 * Returns true if setting ind to air would not result in a 2x2 block.
-		 */
-		bool isLocNoBlock(const Maze& maze) {
-			size_t numDims = maze.getNumDims();
-			for (size_t dir = 0; dir < numDims * 2 - 1; dir++) {
-				for (size_t dir2 = dir + 1; dir2 < numDims * 2; dir2++) {
-					if (dir2 - dir == numDims) {
-						continue;
-					}
-					size_t inDir;
-					if (dir < numDims) {
-						if (loc[dir] + 1 >=
-								static_cast<std::int32_t>(maze.dimensions[dir] - 1)) {
-							continue;
-						}
-						inDir = ind + maze.tempProds[dir];
-					} else {
-						if (loc[dir - numDims] - 1 <= 0) {
-							continue;
-						}
-						inDir = ind - maze.tempProds[dir - numDims];
-					}
-					if (maze.getBlock(inDir) > 0) {
-						continue;
+		size_t maxLength = *std::max_element(boxDims.begin(), boxDims.end());
+		std::vector<std::int32_t> g (maxLength);
+		// s[q] are the blocks whose distances make up the lower envelope,
+		// and t[q] is where s[q] starts being the minimum.
+		std::vector<std::int32_t> s (maxLength);
+		std::vector<std::int32_t> t (maxLength);
+		auto f = [&g] (std::int32_t x, std::int32_t i) -> std::int32_t {
+			return std::max(std::abs(x - i), g[i]);
+		};
+		auto sep = [&g] (std::int32_t i, std::int32_t u) -> std::int32_t {
+			if (g[i] <= g[u]) {
+				return std::max(i + g[u], (i + u) / 2);
+			}
+			return std::min(u - g[i], (i + u) / 2);
+		};
+		for (size_t axis = 0; axis < numDims; axis++) {
+			std::int32_t m = boxDims[axis];
+			size_t stride = boxProds[axis];
+			size_t numLines = boxSize / m;
+			for (size_t line = 0; line < numLines; line++) {
+				std::int32_t* lineStart = box +
+						(line / stride) * stride * m + (line % stride);
+				for (std::int32_t u = 0; u < m; u++) {
+					g[u] = lineStart[u * stride];
+				}
+				std::int32_t q = 0;
+				s[0] = 0;
+				t[0] = 0;
+				for (std::int32_t u = 1; u < m; u++) {
+					while ((q >= 0) && (f(t[q], s[q]) > f(t[q], u))) {
+						q--;
 					}
-					size_t inDir2;
-					size_t inDirDir2;
-					if (dir2 < numDims) {
-						if (loc[dir2] + 1 >=
-								static_cast<std::int32_t>(maze.dimensions[dir2] - 1)) {
-							continue;
-						}
-						inDir2 = ind + maze.tempProds[dir2];
-						inDirDir2 = inDir + maze.tempProds[dir2];
+					if (q < 0) {
+						q = 0;
+						s[0] = u;
 					} else {
-						if (loc[dir2 - numDims] - 1 <= 0) {
-							continue;
+						std::int32_t w = 1 + sep(s[q], u);
+						if (w < m) {
+							q++;
+							s[q] = u;
+							t[q] = w;
 						}
-						inDir2 = ind - maze.tempProds[dir2 - numDims];
-						inDirDir2 = inDir - maze.tempProds[dir2 - numDims];
-					}
-					if (maze.getBlock(inDir2) > 0) {
-						continue;
 					}
-					if (maze.getBlock(inDirDir2) > 0) {
-						continue;
+				}
+				for (std::int32_t u = m - 1; u >= 0; u--) {
+					lineStart[u * stride] = f(u, s[q]);
+					if (u == t[q]) {
+						q--;
 					}
-					return false;
 				}
 			}
-			return true;
 		}
+		for (size_t k = 0; k < boxSize; k++) {
+			box[k] = std::min(box[k], static_cast<std::int32_t>(maxDistance));
+		}
+	}
 
-		size_t getPrevDir(size_t numDims) const {
-			if (prevDirs.empty()) {
-				return numDims * 2;
-			} else {
-				return prevDirs.back();
+	/**
+	 * Fixes the distances after the block at ind changed between air and
+	 * not air, to isNowOccupied.
+	 */
+	void updateDistanceField(size_t ind, bool isNowOccupied) {
+		// only distances within maxDistance of ind can change,
+		// and those only depend on blocks within maxDistance of them.
+		std::vector<std::int32_t> center (numDims);
+		fromInd(ind, center.begin());
+		std::vector<std::int32_t> lo (numDims), hi (numDims);
+		std::vector<std::int32_t> changedLo (numDims), changedHi (numDims);
+		size_t boxSize = 1;
+		for (size_t i = 0; i < numDims; i++) {
+			std::int32_t dim = dimensions[i];
+			lo[i] = std::max(0, center[i] - 2 * maxDistance);
+			hi[i] = std::min(dim, center[i] + 2 * maxDistance + 1);
+			changedLo[i] = std::max(0, center[i] - maxDistance);
+			changedHi[i] = std::min(dim, center[i] + maxDistance + 1);
+			boxSize *= hi[i] - lo[i];
+		}
+		std::vector<std::int32_t> loc (changedLo);
+		if (isNowOccupied) {
+			// a new wall can only bring blocks closer to a wall, to however
+			// far they are from it, so nothing else needs looking at
+			while (true) {
+				std::int32_t distance = 0;
+				for (size_t i = 0; i < numDims; i++) {
+					distance = std::max(distance, std::abs(loc[i] - center[i]));
+				}
+				size_t locInd = getInd(loc.begin());
+				if (distance < (*distances)[locInd]) {
+					distances->set(locInd, distance);
+				}
+				size_t i = numDims;
+				while ((i-- > 0) && (++loc[i] >= changedHi[i])) {
+					loc[i] = changedLo[i];
+				}
+				if (i >= numDims) {
+					return;
+				}
 			}
 		}
-
-	public:
-		Head(const Maze& maze,
-				size_t inInd): ind(inInd) {
-			loc.resize(maze.getNumDims());
-			maze.fromInd(inInd, loc.begin());
-			newNess = 0;
+		std::vector<std::int32_t> box (boxSize);
+		transformBox(lo.data(), hi.data(), box.data());
+		while (true) {
+			size_t boxInd = 0;
+			size_t boxProd = 1;
+			for (size_t i = numDims; i-- > 0;) {
+				boxInd += (loc[i] - lo[i]) * boxProd;
+				boxProd *= hi[i] - lo[i];
+			}
+			distances->set(getInd(loc.begin()), box[boxInd]);
+			size_t i = numDims;
+			while (i-- > 0) {
+				if (++loc[i] < changedHi[i]) {
+					break;
+				}
+				loc[i] = changedLo[i];
+			}
+			if (i >= numDims) {
+				break;
+			}
+		}
+	}
+
+public:
+	/**
+	 * Precomputes, for every block, how far away the nearest non-air block
+	 * is, so that rays can skip over open space. Distances are capped at
+	 * newMaxDistance, which also bounds the work setBlock has to do to keep
+	 * them up to date, as it says there. Copies made before this don't
+	 * get it.
+	 */
+	void buildDistanceField(std::uint8_t newMaxDistance = 8) {
+		if (newMaxDistance < 1) {
+			newMaxDistance = 1;
+		}
+		maxDistance = newMaxDistance;
+		std::vector<std::int32_t> lo (numDims, 0);
+		std::vector<std::int32_t> hi (dimensions.get(), dimensions.get() + numDims);
+		std::int32_t* box = new std::int32_t[dataLength];
+		transformBox(lo.data(), hi.data(), box);
+		if (!distances || (distances.use_count() > 1)) {
+			distances = std::make_shared<PagedArray<std::uint8_t>>(dataLength, 16);
+		}
+		// box is row-major
+		size_t boxInd = 0;
+		PagedArray<std::uint8_t>* newDistances = distances.get();
+		forEachBlock([newDistances, box, &boxInd] (size_t ind) -> void {
+			newDistances->set(ind, box[boxInd++]);
+		});
+		delete[] box;
+	}
+
+	bool hasDistanceField() const {
+		return distances != nullptr;
+	}
+
+	/**
+	 * Returns r such that every block at most r away from the block at ind,
+	 * along every axis, is air. 0 if there is no distance field.
+	 */
+	std::uint8_t getEmptyRadius(size_t ind) const {
+		if (!distances || ((*distances)[ind] == 0)) {
+			return 0;
+		}
+		return (*distances)[ind] - 1;
+	}
+
+	StorageMode getStorageMode() const {
+		return data->getMode();
+	}
+
+	/**
+	 * Repacks the blocks. Returns false if newMode can't hold all the
+	 * different blocks there are. Copies of this made before keep theirs
+	 * packed the way they were.
+	 */
+	bool setStorageMode(StorageMode newMode) {
+		if (newMode == data->getMode()) {
+			return true;
+		}
+		unshareBlocks();
+		return data->setMode(newMode);
+	}
+
+	/**
+	 * How much memory the blocks take up, not counting
+	 * the distance field or the occupancy pyramid.
+	 * With the CHUNKED layout, this only counts bricks that aren't tags.
+	 */
+	size_t getNumBytes() const {
+		return data->getNumBytes();
+	}
+
+	/**
+	 * Builds an OccupancyPyramid over the blocks, on numThreads threads,
+	 * so that rays can skip over empty cells of it. Does nothing if there
+	 * already is one, since setBlock keeps it up to date.
+	 * Copies made before this don't get it.
+	 */
+	void buildOccupancyPyramid(
+			size_t numThreads = multithread::getNumThreads()) {
+		if (pyramid) {
+			return;
+		}
+		pyramid = std::make_shared<OccupancyPyramid>(numDims, dimensions.get(),
+				[this] (size_t ind) -> bool {
+			return data->isOccupied(fromRowMajor(ind));
+		}, numThreads);
+	}
+
+	/**
+	 * nullptr if buildOccupancyPyramid was never called.
+	 */
+	const OccupancyPyramid* getOccupancyPyramid() const {
+		return pyramid.get();
+	}
+
+private:
+	/**
+	 * The index of the block next to the block at ind, which is at loc,
+	 * along axis by delta, or dataLength if that is outside the maze.
+	 */
+	size_t getNeighbour(size_t ind, const std::vector<std::int32_t>& loc,
+			size_t axis, std::int32_t delta) const {
+		std::int32_t coord = loc[axis] + delta;
+		if ((coord < 0) || (coord >= static_cast<std::int32_t>(dimensions[axis]))) {
+			return dataLength;
+		}
+		return ind - getAxisOffset(axis, loc[axis]) + getAxisOffset(axis, coord);
+	}
+
+	/**
+	 * Adds the blocks next to frontier[begin] to frontier[end - 1] that are
+	 * air, and that nothing got to before, to next, at distance. Lowers
+	 * exit to the index of any of those on the outside of the maze, which
+	 * only ever happens going along an axis, unless the block it went from
+	 * is on the outside too. Different threads can do this at once.
+	 */
+	void expandFrontier(const std::vector<size_t>& frontier,
+			size_t begin, size_t end, std::uint32_t distance,
+			std::atomic<std::uint64_t>* visited, std::uint32_t* distances,
+			std::vector<size_t>& next, size_t& exit) const {
+		std::vector<std::int32_t> loc (numDims);
+		for (size_t k = begin; k < end; k++) {
+			size_t ind = frontier[k];
+			fromInd(ind, loc.begin());
+			for (size_t axis = 0; axis < numDims; axis++) {
+				for (std::int32_t delta: {-1, 1}) {
+					size_t nextInd = getNeighbour(ind, loc, axis, delta);
+					if ((nextInd == dataLength) || isOccupied(nextInd)) {
+						continue;
+					}
+					std::atomic<std::uint64_t>& word = visited[nextInd >> 6];
+					std::uint64_t bit = static_cast<std::uint64_t>(1) <<
+							(nextInd & 63);
+					// looking first saves writing to the word most of the time
+					if ((word.load(std::memory_order_relaxed) & bit) ||
+							(word.fetch_or(bit, std::memory_order_relaxed) & bit)) {
+						continue;
+					}
+					distances[nextInd] = distance;
+					next.push_back(nextInd);
+					std::int32_t coord = loc[axis] + delta;
+					if ((coord == 0) || (coord ==
+							static_cast<std::int32_t>(dimensions[axis] - 1))) {
+						exit = std::min(exit, nextInd);
+					}
+				}
+			}
+		}
+	}
+
+public:
+	/**
+	 * Finds how far every block is from (1, 1, ...), one distance at a time,
+	 * splitting up each frontier between numThreads threads when it is big
+	 * enough to be worth it, and a shortest way out of the maze. Blocks that
+	 * have been got to are kept as bits, which threads set atomically.
+	 * The solution is the same whatever numThreads is.
+	 * Takes O(number of blocks) time and memory.
+	 */
+	MazeSolution solve(size_t numThreads = multithread::getNumThreads()) const {
+		// frontiers smaller than this per thread are done on this thread
+		const size_t minPerThread = 4096;
+		MazeSolution solution;
+		solution.distances.assign(dataLength, MazeSolution::unreachable);
+		solution.numReached = 0;
+		solution.maxDistance = 0;
+		std::vector<std::int32_t> loc (numDims, 1);
+		size_t start = getInd(loc.begin());
+		if (isOccupied(start)) {
+			return solution;
+		}
+		std::atomic<std::uint64_t>* visited =
+				new std::atomic<std::uint64_t>[(dataLength + 63) / 64]();
+		visited[start >> 6] |= static_cast<std::uint64_t>(1) << (start & 63);
+		solution.distances[start] = 0;
+		solution.numReached = 1;
+		size_t exit = dataLength;
+		std::vector<size_t> frontier {start};
+		std::vector<std::vector<size_t>> nexts (std::max(
+				static_cast<size_t>(1), numThreads));
+		std::vector<size_t> exits (nexts.size(), dataLength);
+		for (std::uint32_t distance = 1; !frontier.empty(); distance++) {
+			size_t numUsed = std::min(nexts.size(),
+					frontier.size() / minPerThread);
+			if (numUsed <= 1) {
+				numUsed = 1;
+				expandFrontier(frontier, 0, frontier.size(), distance,
+						visited, solution.distances.data(), nexts[0], exits[0]);
+			} else {
+				std::vector<std::thread> threads;
+				for (size_t t = 0; t < numUsed; t++) {
+					size_t begin = frontier.size() * t / numUsed;
+					size_t end = frontier.size() * (t + 1) / numUsed;
+					threads.push_back(std::thread([this, &frontier, begin, end,
+							distance, visited, &solution, &nexts, &exits, t]
+							() -> void {
+						expandFrontier(frontier, begin, end, distance, visited,
+								solution.distances.data(), nexts[t], exits[t]);
+					}));
+				}
+				for (std::thread& thread: threads) {
+					thread.join();
+				}
+			}
+			frontier.clear();
+			for (size_t t = 0; t < numUsed; t++) {
+				frontier.insert(frontier.end(), nexts[t].begin(), nexts[t].end());
+				nexts[t].clear();
+			}
+			if (frontier.empty()) {
+				break;
+			}
+			solution.numReached += frontier.size();
+			solution.maxDistance = distance;
+			if (exit == dataLength) {
+				exit = *std::min_element(exits.begin(), exits.end());
+			}
+		}
+		delete[] visited;
+		for (size_t ind = exit; ind != dataLength;) {
+			solution.path.push_back(ind);
+			std::uint32_t distance = solution.distances[ind];
+			if (distance == 0) {
+				break;
+			}
+			// the first way back, so that the path is always the same
+			fromInd(ind, loc.begin());
+			size_t prev = dataLength;
+			for (size_t axis = 0; (prev == dataLength) && (axis < numDims); axis++) {
+				for (std::int32_t delta: {-1, 1}) {
+					size_t prevInd = getNeighbour(ind, loc, axis, delta);
+					if ((prevInd != dataLength) &&
+							(solution.distances[prevInd] == distance - 1)) {
+						prev = prevInd;
+						break;
+					}
+				}
+			}
+			ind = prev;
+		}
+		std::reverse(solution.path.begin(), solution.path.end());
+		return solution;
+	}
+
+	/**
+	 * Offsets is location relative to the center of the block.
+	 */
+	static Color getBlockColor(std::uint8_t block,
+			size_t numDims, const double* offsets) {
+		if (block == 0) {
+			return Color{0, 0, 0, 0};
+		} else {
+			double sum = 0;
+			const double* offsetsEnd = offsets + numDims;
+			for (; offsets < offsetsEnd; ++offsets) {
+				sum += *offsets;
+			}
+			// normalize from (-n/2, n/2) to (50, 206)
+			std::uint8_t value = 128 + (sum * 106 / numDims);
+			switch(block) {
+			case 1:
+				return Color{value, value, value, 0xFF};
+			case 2:
+				return Color{value, 0, 0, 0xFF};
+			case 3:
+				return Color{0, value, 0, 0xFF};
+			case 4:
+				return Color{0, 0, value, 0xFF};
+			case 5:
+				return Color{value, value, 0, 0xFF};
+			case 6:
+				return Color{value, 0, value, 0xFF};
+			case 7:
+				return Color{0, value, value, 0xFF};
+			}
+			return Color{value, value, value, 0xFF};
+		}
+	}
+
+private:
+	/**
+	 * The directions heads have gone in, as lists going backwards from the
+	 * last step of each head, all in one place. A head that branches off
+	 * another shares the steps it took to get there instead of copying them.
+	 * Steps are never taken back out, so this only grows.
+	 */
+	class Trail {
+
+		// each is the index of the step before it shifted left by 8,
+		// or'ed with the direction. 0 is before the first step of any head.
+		std::vector<std::uint64_t> steps;
+
+	public:
+		Trail(): steps(1, 0) {}
+
+		/**
+		 * Returns the new step.
+		 */
+		size_t push(size_t prevStep, size_t dir) {
+			steps.push_back((static_cast<std::uint64_t>(prevStep) << 8) | dir);
+			return steps.size() - 1;
+		}
+
+		size_t getDir(size_t step) const {
+			return steps[step] & 255;
+		}
+
+		size_t getPrevStep(size_t step) const {
+			return steps[step] >> 8;
+		}
+
+	};
+
+	/**
+	 * What a head needs to know about the blocks next to a block, worked
+	 * out once for a maze instead of from its strides on every probe.
+	 * Going in dir from a block whose coordinate along the axis of dir is
+	 * coord changes its index by getOffset(dir, coord), which only depends
+	 * on coord % 4, because of bricks.
+	 * The outermost blocks of the box being carved are never carved, so they
+	 * are walls to everything that looks at them, and nothing that looks
+	 * around a block inside the box needs to check where the box ends.
+	 * Also remembers which blocks next to the last block gather looked
+	 * around are air, as a bitmask in 2 and 3 dimensions, where a table
+	 * says which pairs of those would make a 2x2 block, and as a list in more.
+	 */
+	class Neighbours {
+
+		size_t numDims;
+		// the index is dir * 4 + coord % 4
+		std::vector<std::ptrdiff_t> offsets;
+		// the directions of air around the last block gathered, numAir of them
+		std::vector<size_t> airDirs;
+		size_t numAir;
+		// in 2 and 3 dimensions, bit dir is set if the block in dir is air
+		std::uint32_t airMask;
+		// the directions that make up each pair that isn't opposite
+		std::vector<size_t> pairDirs;
+		// in 2 and 3 dimensions, indexed by airMask, bit pair is set
+		// if both directions of the pair are air
+		std::vector<std::uint16_t> pairsByMask;
+
+	public:
+		Neighbours(const Maze& maze): numDims(maze.getNumDims()),
+				offsets(numDims * 8), airDirs(numDims * 2), numAir(0),
+				airMask(0) {
+			for (size_t axis = 0; axis < numDims; axis++) {
+				for (std::int32_t coord = 0; coord < 4; coord++) {
+					offsets[axis * 4 + coord] = maze.getStride(axis, coord);
+					offsets[(axis + numDims) * 4 + coord] =
+							-static_cast<std::ptrdiff_t>(
+									maze.getStride(axis, (coord + 3) & 3));
+				}
+			}
+			if (numDims > 3) {
+				return;
+			}
+			for (size_t dir = 0; dir < numDims * 2 - 1; dir++) {
+				for (size_t dir2 = dir + 1; dir2 < numDims * 2; dir2++) {
+					if (dir2 - dir != numDims) {
+						pairDirs.push_back(dir);
+						pairDirs.push_back(dir2);
+					}
+				}
+			}
+			pairsByMask.resize(1 << (numDims * 2));
+			for (size_t mask = 0; mask < pairsByMask.size(); mask++) {
+				for (size_t pair = 0; pair < pairDirs.size() / 2; pair++) {
+					if ((mask >> pairDirs[pair * 2] & 1) &&
+							(mask >> pairDirs[pair * 2 + 1] & 1)) {
+						pairsByMask[mask] |= 1 << pair;
+					}
+				}
+			}
+		}
+
+		std::ptrdiff_t getOffset(size_t dir, std::int32_t coord) const {
+			return offsets[dir * 4 + (coord & 3)];
+		}
+
+		size_t getAxis(size_t dir) const {
+			return (dir < numDims)? dir: dir - numDims;
+		}
+
+		size_t getOpposite(size_t dir) const {
+			return (dir < numDims)? dir + numDims: dir - numDims;
+		}
+
+		/**
+		 * Looks at which blocks next to the block at ind are air.
+		 */
+		void gather(const Maze& maze, size_t ind,
+				const std::vector<std::int32_t>& loc) {
+			if (numDims <= 3) {
+				airMask = 0;
+				for (size_t dir = 0; dir < numDims * 2; dir++) {
+					if (!maze.isOccupied(ind +
+							getOffset(dir, loc[getAxis(dir)]))) {
+						airMask |= 1 << dir;
+					}
+				}
+				return;
+			}
+			numAir = 0;
+			for (size_t dir = 0; dir < numDims * 2; dir++) {
+				if (!maze.isOccupied(ind +
+						getOffset(dir, loc[getAxis(dir)]))) {
+					airDirs[numAir++] = dir;
+				}
+			}
+		}
+
+		/**
+		 * Whether any block next to the block at ind is air, other than the
+		 * one in direction exceptDir.
+		 */
+		bool hasAir(const Maze& maze, size_t ind,
+				const std::vector<std::int32_t>& loc, size_t exceptDir) const {
+			for (size_t dir = 0; dir < numDims * 2; dir++) {
+				if ((dir != exceptDir) && !maze.isOccupied(ind +
+						getOffset(dir, loc[getAxis(dir)]))) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		 * Whether setting the block gathered to air would make a 2x2 block
+		 * of air, with two blocks next to it and the one diagonal to both.
+		 */
+		bool isMakingBlock(const Maze& maze, size_t ind,
+				const std::vector<std::int32_t>& loc) const {
+			if (numDims <= 3) {
+				for (std::uint32_t pairs = pairsByMask[airMask]; pairs != 0;
+						pairs &= pairs - 1) {
+					size_t pair = __builtin_ctz(pairs);
+					size_t dir = pairDirs[pair * 2];
+					size_t dir2 = pairDirs[pair * 2 + 1];
+					// dir and dir2 are along different axes, so the block in
+					// dir has the same coordinate along dir2 as ind
+					if (!maze.isOccupied(ind +
+							getOffset(dir, loc[getAxis(dir)]) +
+							getOffset(dir2, loc[getAxis(dir2)]))) {
+						return true;
+					}
+				}
+				return false;
+			}
+			for (size_t i = 0; i + 1 < numAir; i++) {
+				size_t dir = airDirs[i];
+				for (size_t j = i + 1; j < numAir; j++) {
+					size_t dir2 = airDirs[j];
+					if (dir2 - dir == numDims) {
+						continue;
+					}
+					if (!maze.isOccupied(ind +
+							getOffset(dir, loc[getAxis(dir)]) +
+							getOffset(dir2, loc[getAxis(dir2)]))) {
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+	};
+
+	class Head {
+
+		// this is positive only when it is just created from branching.
+		size_t newNess;
+		// location
+		size_t ind;
+		std::vector<std::int32_t> loc;
+		// where its last step is in trail, or 0 if it hasn't moved.
+		// directions are the index of the dimension if positive,
+		// plus numDims if negative.
+		Trail* trail;
+		size_t lastStep;
+		Neighbours* neighbours;
+		// the box [lo, hi) to carve in, whose outermost blocks stay walls
+		const std::int32_t* lo;
+		const std::int32_t* hi;
+
+		/**
+		 * Returns true if ind is a wall with no air next to it other than
+		 * the block in direction backDir, where the head came from.
+		 */
+		bool isLocFine(const Maze& maze, size_t backDir) const {
+			return maze.isOccupied(ind) &&
+					!neighbours->hasAir(maze, ind, loc, backDir);
+		}
+
+		/**
+		 * Returns true if setting ind to air would not result in a 2x2 block.
+		 */
+		bool isLocNoBlock(const Maze& maze) {
+			neighbours->gather(maze, ind, loc);
+			return !neighbours->isMakingBlock(maze, ind, loc);
+		}
+
+		size_t getPrevDir(size_t numDims) const {
+			if (lastStep == 0) {
+				return numDims * 2;
+			} else {
+				return trail->getDir(lastStep);
+			}
+		}
+
+	public:
+		Head(const Maze& maze, size_t inInd, Trail& inTrail,
+				Neighbours& inNeighbours,
+				const std::int32_t* inLo, const std::int32_t* inHi):
+					ind(inInd), trail(&inTrail), lastStep(0),
+					neighbours(&inNeighbours), lo(inLo), hi(inHi) {
+			loc.resize(maze.getNumDims());
+			maze.fromInd(inInd, loc.begin());
+			newNess = 0;
+		}
+
+		const std::vector<std::int32_t>& getLoc() const {
+			return loc;
 		}
 
 		void markNew(const Maze& maze, const MazeGenerationOptions& options) {
@@ -476,7 +1357,7 @@ private:
 
 		size_t getNextDir(const Maze& maze,
 				const MazeGenerationOptions& options,
-				std::mt19937& mtrand,
+				MazeRandom& mazeRand,
 				std::uniform_real_distribution<double>& unitDistro,
 				// direction is index, value is cumulative weight
 				// I don't want to call operator new[] each time.
@@ -488,49 +1369,53 @@ private:
 			double noLoopProbability = 1 - options.getLoopProbability();
 			double noBlockProbability = 1 - options.getBlockProbability();
 
+			size_t prevDir = getPrevDir(numDims);
 			double currWeight = 0;
 			for (size_t dir = 0; dir < numDims * 2; dir++) {
 				// go in inverse directions
 				// static_cast for overload ambiguity resolution
-				if (std::abs(static_cast<int>(dir - getPrevDir(numDims))) ==
+				if (std::abs(static_cast<int>(dir - prevDir)) ==
 						static_cast<int>(numDims)) {
 					possibilities[dir] = currWeight;
 					continue;
 				}
 				if (dir < numDims) {
-					if (loc[dir] + 1 >=
-							static_cast<std::int32_t>(maze.dimensions[dir] - 1)) {
+					if (loc[dir] + 1 >= hi[dir] - 1) {
 						possibilities[dir] = currWeight;
 						continue;
 					}
 				} else {
-					if (loc[dir - numDims] - 1 <= 0) {
+					if (loc[dir - numDims] - 1 <= lo[dir - numDims]) {
 						possibilities[dir] = currWeight;
 						continue;
 					}
 				}
+				size_t backDir = neighbours->getOpposite(dir);
+				// if nothing but where the head came from is air next to it,
+				// it can't make a 2x2 block either
+				bool isFine = false;
 				if (newNess ||
-						(unitDistro(mtrand) < noLoopProbability)) {
-					size_t prevInd = ind;
-					move(maze, dir);
-					if (!isLocFine(maze, prevInd)) {
+						(unitDistro(mazeRand) < noLoopProbability)) {
+					move(dir);
+					if (!isLocFine(maze, backDir)) {
 						possibilities[dir] = currWeight;
-						reverse(maze, dir);
+						move(backDir);
 						continue;
 					}
-					reverse(maze, dir);
+					move(backDir);
+					isFine = true;
 				}
-				if (unitDistro(mtrand) < noBlockProbability) {
-					move(maze, dir);
+				if ((unitDistro(mazeRand) < noBlockProbability) && !isFine) {
+					move(dir);
 					if (!isLocNoBlock(maze)) {
 						possibilities[dir] = currWeight;
-						reverse(maze, dir);
+						move(backDir);
 						continue;
 					}
-					reverse(maze, dir);
+					move(backDir);
 				}
 				double weight;
-				if (dir == getPrevDir(numDims)) {
+				if (dir == prevDir) {
 					weight = 1 - twistProbability;
 				} else {
 					weight = twistProbability;
@@ -547,7 +1432,7 @@ private:
 				return numDims * 2;
 			}
 			std::uniform_real_distribution<double> distro (0, currWeight);
-			double result = distro(mtrand);
+			double result = distro(mazeRand);
 			size_t toreturn = 0;
 			for (; toreturn < numDims * 2; toreturn++) {
 				if (possibilities[toreturn] > result) {
@@ -557,26 +1442,10 @@ private:
 			return toreturn;
 		}
 
-		void move(const Maze& maze, size_t dir) {
-			size_t numDims = maze.getNumDims();
-			if (dir < numDims) {
-				ind += maze.tempProds[dir];
-				loc[dir]++;
-			} else {
-				ind -= maze.tempProds[dir - numDims];
-				loc[dir - numDims]--;
-			}
-		}
-
-		void reverse(const Maze& maze, size_t dir) {
-			size_t numDims = maze.getNumDims();
-			if (dir < numDims) {
-				ind -= maze.tempProds[dir];
-				loc[dir]--;
-			} else {
-				ind += maze.tempProds[dir - numDims];
-				loc[dir - numDims]++;
-			}
+		void move(size_t dir) {
+			size_t axis = neighbours->getAxis(dir);
+			ind += neighbours->getOffset(dir, loc[axis]);
+			loc[axis] += (dir == axis)? 1: -1;
 		}
 
 		bool reverse(const Maze& maze) {
@@ -584,33 +1453,29 @@ private:
 			if (getPrevDir(numDims) >= numDims * 2) {
 				return false;
 			}
-			size_t prevDir = prevDirs.back();
+			size_t prevDir = trail->getDir(lastStep);
 			if (prevDir < numDims) {
-				if (loc[prevDir] - 1 <= 0) {
+				if (loc[prevDir] - 1 <= lo[prevDir]) {
 					return false;
 				}
 			} else {
-				if (loc[prevDir - numDims] + 1 >=
-						static_cast<std::int32_t>(
-								maze.dimensions[prevDir - numDims] - 1)) {
+				if (loc[prevDir - numDims] + 1 >= hi[prevDir - numDims] - 1) {
 					return false;
 				}
 			}
-			reverse(maze, prevDir);
-			prevDirs.pop_back();
+			move(neighbours->getOpposite(prevDir));
+			lastStep = trail->getPrevStep(lastStep);
 			return true;
 		}
 
-		bool isEatUseful(const Maze& maze, size_t dir) {
-			move(maze, dir);
-			bool toreturn = maze.getBlock(ind) > 0;
-			reverse(maze, dir);
-			return toreturn;
+		bool isEatUseful(const Maze& maze, size_t dir) const {
+			return maze.isOccupied(ind +
+					neighbours->getOffset(dir, loc[neighbours->getAxis(dir)]));
 		}
 
 		void eat(Maze& maze, size_t dir, size_t& numBlocksBroken) {
-			move(maze, dir);
-			prevDirs.push_back(dir);
+			move(dir);
+			lastStep = trail->push(lastStep, dir);
 			if (maze.getBlock(ind) > 0) {
 				numBlocksBroken++;
 			}
@@ -624,93 +1489,811 @@ private:
 
 	friend Head;
 
-	void generate(const MazeGenerationOptions& options) {
-		double density = options.getDensity();
-		double branchProbability = options.getBranchProbability();
-		double branchDeathProbability = options.getBranchDeathProbability();
-		size_t maxUseless = options.getMaxUseless();
-
-		std::string seed = options.getSeed();
-		std::seed_seq seq (seed.begin(), seed.end());
-		std::mt19937 mtrand (seq);
-		std::uniform_int_distribution<std::uint8_t> iDistro (1, 7);
-		// fill the maze before generating
-		std::uint8_t* iter_data = data;
-		std::uint8_t* data_end = data + dataLength;
-		for (; iter_data < data_end; ++iter_data) {
-			*iter_data = iDistro(mtrand);
+	/**
+	 * Carves a maze into the box [lo, hi), leaving its outermost blocks as
+	 * walls, starting from the block at start, until enough of it is carved
+	 * and the block at last is air, or the heads all die. It does this a few
+	 * blocks at a time, picking up where it left off, and gives the same
+	 * maze however many it does at a time.
+	 * Only reads and writes blocks inside the box.
+	 */
+	class Carver {
+
+		Maze& maze;
+		const MazeGenerationOptions& options;
+		std::vector<std::int32_t> lo;
+		std::vector<std::int32_t> hi;
+		size_t last;
+		MazeRandom& mazeRand;
+		std::uniform_real_distribution<double> unitDistro;
+		Trail trail;
+		Neighbours neighbours;
+		// heads[0] carves until it dies, and branches go on the back
+		std::deque<Head> heads;
+		std::vector<double> possibilities;
+		size_t totalBlocks;
+		size_t numBlocksBroken;
+		size_t streakOfUseless;
+		bool isDone;
+		// the box of blocks carved since the last takeDirty
+		std::vector<std::int32_t> dirtyLo;
+		std::vector<std::int32_t> dirtyHi;
+
+		void markDirty(const std::vector<std::int32_t>& loc) {
+			for (size_t i = 0; i < loc.size(); i++) {
+				dirtyLo[i] = std::min(dirtyLo[i], loc[i]);
+				dirtyHi[i] = std::max(dirtyHi[i], loc[i] + 1);
+			}
 		}
 
-		// oneoneone is literally the ind of (1, 1, 1, 1, ....)
-		size_t oneoneone = 0;
-		// last is the ind of (dims[0] - 2, dims[1] - 2, dims[2] - 2, ...)
-		size_t last = 0;
-		for (size_t i = 0; i < numDims; i++) {
-			oneoneone += tempProds[i];
-			last += (dimensions[i] - 2) * tempProds[i];
+		bool isFinished() const {
+			return heads.empty() ||
+					((numBlocksBroken >= options.getDensity() * totalBlocks) &&
+							(maze.getBlock(last) == 0));
 		}
-		setBlock(oneoneone, 0);
-		std::vector<Head> heads;
-		heads.push_back(Head(*this, oneoneone));
-		std::uniform_real_distribution<double> unitDistro;
-		size_t numBlocksBroken = 1;
-		size_t totalBlocks = 1;
-		for (size_t i = 0; i < numDims; i++) {
-			totalBlocks *= dimensions[i] - 2;
-		}
-		double* possibilities = new double[numDims * 2];
-		size_t streakOfUseless = 0;
-		while (!heads.empty() &&
-				((numBlocksBroken < density * totalBlocks) ||
-						(getBlock(last) > 0))) {
-			if ((unitDistro(mtrand) < branchDeathProbability) &&
-					(heads.size() > 2)) {
-				heads.erase(heads.begin());
-				continue;
+
+	public:
+		Carver(Maze& inMaze, const MazeGenerationOptions& inOptions,
+				const std::int32_t* inLo, const std::int32_t* inHi,
+				size_t start, size_t inLast, MazeRandom& inMazeRand):
+					maze(inMaze), options(inOptions),
+					lo(inLo, inLo + inMaze.numDims),
+					hi(inHi, inHi + inMaze.numDims),
+					last(inLast), mazeRand(inMazeRand), neighbours(inMaze),
+					possibilities(inMaze.numDims * 2), totalBlocks(1),
+					numBlocksBroken(1), streakOfUseless(0), isDone(false),
+					dirtyLo(hi), dirtyHi(lo) {
+			maze.setBlock(start, 0);
+			heads.push_back(Head(maze, start, trail, neighbours,
+					lo.data(), hi.data()));
+			for (size_t i = 0; i < lo.size(); i++) {
+				totalBlocks *= hi[i] - lo[i] - 2;
 			}
-			size_t dir = heads[0].getNextDir(*this, options,
-					mtrand, unitDistro, possibilities);
-			if (dir >= numDims * 2) {
-				bool shouldContinue = false;
-				while (true) {
-					if (!heads[0].reverse(*this)) {
-						heads.erase(heads.begin());
-						shouldContinue = true;
-						break;
+			markDirty(heads[0].getLoc());
+		}
+
+		/**
+		 * Carves until it has broken maxBlocks more blocks, or is done.
+		 * Returns whether it is done.
+		 */
+		bool carveSome(size_t maxBlocks) {
+			size_t numDims = maze.getNumDims();
+			double branchProbability = options.getBranchProbability();
+			double branchDeathProbability = options.getBranchDeathProbability();
+			size_t maxUseless = options.getMaxUseless();
+			size_t numBlocksBefore = numBlocksBroken;
+			while (!isDone && (numBlocksBroken - numBlocksBefore < maxBlocks)) {
+				if (isFinished()) {
+					isDone = true;
+					break;
+				}
+				if ((unitDistro(mazeRand) < branchDeathProbability) &&
+						(heads.size() > 2)) {
+					heads.pop_front();
+					continue;
+				}
+				size_t dir = heads[0].getNextDir(maze, options,
+						mazeRand, unitDistro, possibilities.data());
+				if (dir >= numDims * 2) {
+					bool shouldContinue = false;
+					while (true) {
+						if (!heads[0].reverse(maze)) {
+							heads.pop_front();
+							shouldContinue = true;
+							break;
+						}
+						dir = heads[0].getNextDir(maze, options,
+								mazeRand, unitDistro, possibilities.data());
+						if (dir < numDims * 2) {
+							break;
+						}
 					}
-					dir = heads[0].getNextDir(*this, options,
-							mtrand, unitDistro, possibilities);
-					if (dir < numDims * 2) {
-						break;
+					if (shouldContinue) {
+						continue;
 					}
 				}
-				if (shouldContinue) {
-					continue;
+				bool isUseful = heads[0].isEatUseful(maze, dir);
+				if (isUseful) {
+					size_t i = 0;
+					while ((i < numDims * 2) &&
+							(unitDistro(mazeRand) < branchProbability)) {
+						heads.push_back(heads[0]);
+						heads.back().markNew(maze, options);
+						i++;
+					}
+					if (streakOfUseless > 0) streakOfUseless--;
+				} else {
+					streakOfUseless++;
+				}
+				heads[0].eat(maze, dir, numBlocksBroken);
+				markDirty(heads[0].getLoc());
+				if ((streakOfUseless >= maxUseless) && (maze.getBlock(last) == 0)) {
+					isDone = true;
 				}
 			}
-			bool isUseful = heads[0].isEatUseful(*this, dir);
-			if (isUseful) {
-				size_t i = 0;
-				while ((i < numDims * 2) &&
-						(unitDistro(mtrand) < branchProbability)) {
-					heads.push_back(heads[0]);
-					heads.back().markNew(*this, options);
-					i++;
+			return isDone;
+		}
+
+		bool getIsDone() const {
+			return isDone;
+		}
+
+		size_t getNumBlocksBroken() const {
+			return numBlocksBroken;
+		}
+
+		size_t getNumHeads() const {
+			return heads.size();
+		}
+
+		size_t getStreakOfUseless() const {
+			return streakOfUseless;
+		}
+
+		/**
+		 * Grows the box [outLo, outHi) to have the blocks carved since the
+		 * last time, and starts over.
+		 */
+		void takeDirty(std::vector<std::int32_t>& outLo,
+				std::vector<std::int32_t>& outHi) {
+			if (dirtyLo[0] >= dirtyHi[0]) {
+				return;
+			}
+			for (size_t i = 0; i < lo.size(); i++) {
+				outLo[i] = std::min(outLo[i], dirtyLo[i]);
+				outHi[i] = std::max(outHi[i], dirtyHi[i]);
+			}
+			dirtyLo = hi;
+			dirtyHi = lo;
+		}
+
+	};
+
+	/**
+	 * Runs carvers until they are all done, each on a thread of its own if
+	 * there is more than 1. Returns how many blocks were broken.
+	 */
+	size_t carveAll(std::deque<Carver>& carvers) {
+		if (carvers.size() == 1) {
+			carvers[0].carveSome(static_cast<size_t>(-1));
+		} else {
+			std::vector<std::thread> threads;
+			for (Carver& carver: carvers) {
+				threads.push_back(std::thread([&carver] () -> void {
+					carver.carveSome(static_cast<size_t>(-1));
+				}));
+			}
+			for (std::thread& thread: threads) {
+				thread.join();
+			}
+		}
+		size_t toreturn = 0;
+		for (const Carver& carver: carvers) {
+			toreturn += carver.getNumBlocksBroken();
+		}
+		return toreturn;
+	}
+
+	/**
+	 * Sets the blocks in the box [lo, hi) to what other has there.
+	 * other has to have the same dimensions and storage mode, but can be
+	 * laid out differently.
+	 */
+	void copyBox(const Maze& other, const std::int32_t* lo,
+			const std::int32_t* hi) {
+		unshareBlocks();
+		bool isSameLayout = (layout == other.layout);
+		std::vector<std::int32_t> loc (lo, lo + numDims);
+		while (true) {
+			size_t ind = getInd(loc.begin());
+			data->set(ind, other.data->get(
+					isSameLayout? ind: other.getInd(loc.begin())));
+			size_t i = numDims;
+			while ((i-- > 0) && (++loc[i] >= hi[i])) {
+				loc[i] = lo[i];
+			}
+			if (i >= numDims) {
+				break;
+			}
+		}
+	}
+
+	/**
+	 * How many layers along the first axis are left between two slabs
+	 * that get carved at once, which neither of them reads or writes, so
+	 * that no word of the storage, and no brick, has blocks of both. The
+	 * most blocks a word holds is 64, in the occupancy bits, so these
+	 * layers hold at least that many.
+	 */
+	std::int32_t getBandThickness() const {
+		if (layout == MazeLayout::ROW_MAJOR) {
+			return (64 + tempProds[0] - 1) / tempProds[0];
+		}
+		// whole bricks, and bands start at multiples of 4
+		return 4 * ((64 + brickStrides[0] - 1) / brickStrides[0]);
+	}
+
+	/**
+	 * Where each band of layers between slabs starts along the first axis,
+	 * for as many slabs up to numSlabs as fit. Empty if only one fits.
+	 */
+	std::vector<std::int32_t> getBands(size_t numSlabs) const {
+		std::int32_t thickness = getBandThickness();
+		std::int32_t align = (layout == MazeLayout::ROW_MAJOR)? 1: 4;
+		std::int32_t dim = dimensions[0];
+		for (; numSlabs > 1; numSlabs--) {
+			std::vector<std::int32_t> toreturn;
+			// where the inside of the current slab starts
+			std::int32_t begin = 1;
+			for (size_t slab = 1; slab < numSlabs; slab++) {
+				std::int32_t band = dim * slab / numSlabs / align * align;
+				// each slab gets at least 2 layers to carve in, inside the
+				// walls on either side of the band
+				if (band - 1 - begin < 2) {
+					break;
 				}
-				if (streakOfUseless > 0) streakOfUseless--;
-			} else {
-				streakOfUseless++;
+				toreturn.push_back(band);
+				begin = band + thickness + 1;
+			}
+			if ((toreturn.size() == numSlabs - 1) && (dim - 1 - begin >= 2)) {
+				return toreturn;
+			}
+		}
+		return std::vector<std::int32_t>();
+	}
+
+	/**
+	 * Adds a carver to carvers for each slab between bands, each with its
+	 * own random numbers in slabRands, from where the corridor through the
+	 * band below it is to where the one above it is.
+	 */
+	void makeSlabCarvers(const MazeGenerationOptions& options,
+			const std::vector<std::int32_t>& bands,
+			const std::vector<std::vector<std::int32_t>>& corridors,
+			std::vector<MazeRandom>& slabRands,
+			std::deque<Carver>& carvers) {
+		std::int32_t thickness = getBandThickness();
+		size_t numSlabs = bands.size() + 1;
+		for (size_t slab = 0; slab < numSlabs; slab++) {
+			std::vector<std::uint32_t> streams {
+				static_cast<std::uint32_t>(slab),
+				static_cast<std::uint32_t>(numSlabs)
+			};
+			slabRands.push_back(MazeRandom(options.getRandomEngine(),
+					options.getSeed(), streams));
+		}
+		for (size_t slab = 0; slab < numSlabs; slab++) {
+			std::vector<std::int32_t> lo (numDims, 0);
+			std::vector<std::int32_t> hi (dimensions.get(), dimensions.get() + numDims);
+			// the band itself belongs to neither
+			if (slab > 0) {
+				lo[0] = bands[slab - 1] + thickness;
+			}
+			if (slab < numSlabs - 1) {
+				hi[0] = bands[slab];
+			}
+			// from the corridor below to the corridor above
+			std::vector<std::int32_t> corner (numDims, 1);
+			if (slab > 0) {
+				corner = corridors[slab - 1];
+			}
+			corner[0] = lo[0] + 1;
+			size_t start = getInd(corner.begin());
+			for (size_t i = 0; i < numDims; i++) {
+				corner[i] = dimensions[i] - 2;
 			}
-			heads[0].eat(*this, dir, numBlocksBroken);
-			if ((streakOfUseless >= maxUseless) && (getBlock(last) == 0)) {
+			if (slab < numSlabs - 1) {
+				corner = corridors[slab];
+			}
+			corner[0] = hi[0] - 2;
+			size_t last = getInd(corner.begin());
+			carvers.emplace_back(*this, options, lo.data(), hi.data(),
+					start, last, slabRands[slab]);
+		}
+	}
+
+	/**
+	 * Joins up the slabs carved between bands, through corridors.
+	 * Returns how many blocks were broken.
+	 */
+	size_t joinAllSlabs(const std::vector<std::int32_t>& bands,
+			const std::vector<std::vector<std::int32_t>>& corridors) {
+		std::int32_t thickness = getBandThickness();
+		size_t toreturn = 0;
+		// through each band and the walls of the slabs on either side
+		for (size_t band = 0; band < bands.size(); band++) {
+			toreturn += joinSlabs(bands[band] - 1, thickness + 2,
+					corridors[band]);
+		}
+		// the last slab might not have got to the end either
+		std::vector<std::int32_t> last (dimensions.get(), dimensions.get() + numDims);
+		for (size_t i = 0; i < numDims; i++) {
+			last[i] -= 2;
+		}
+		toreturn += digToAir(last, -1);
+		return toreturn;
+	}
+
+	/**
+	 * Carves a corridor along the first axis through the band of walls
+	 * from band to band + thickness, joining up the slabs on either side.
+	 * The slabs try to carve out the ends of corridor, but might not have,
+	 * so it goes at the first place, from corridor on in row-major order of
+	 * the other axes, where both slabs are air right next to the band.
+	 * If there is no such place, it goes at corridor, and digs into each
+	 * slab until it gets to air.
+	 * Returns how many blocks were broken.
+	 */
+	size_t joinSlabs(std::int32_t band, std::int32_t thickness,
+			std::vector<std::int32_t> corridor) {
+		size_t numPlaces = 1;
+		for (size_t i = 1; i < numDims; i++) {
+			numPlaces *= dimensions[i] - 2;
+		}
+		std::vector<std::int32_t> place (corridor);
+		bool isFound = false;
+		for (size_t k = 0; !isFound && (k < numPlaces); k++) {
+			place[0] = band - 1;
+			bool isBelowAir = !isOccupied(getInd(place.begin()));
+			place[0] = band + thickness;
+			isFound = isBelowAir && !isOccupied(getInd(place.begin()));
+			for (size_t i = numDims; !isFound && (i-- > 1);) {
+				if (++place[i] < static_cast<std::int32_t>(dimensions[i] - 1)) {
+					break;
+				}
+				place[i] = 1;
+			}
+		}
+		if (isFound) {
+			corridor = place;
+		}
+		size_t toreturn = 0;
+		for (std::int32_t layer = 0; layer < thickness; layer++) {
+			corridor[0] = band + layer;
+			setBlock(corridor.begin(), 0);
+			toreturn++;
+		}
+		corridor[0] = band - 1;
+		toreturn += digToAir(corridor, -1);
+		corridor[0] = band + thickness;
+		toreturn += digToAir(corridor, 1);
+		return toreturn;
+	}
+
+	/**
+	 * Carves from loc along the first axis, going by step, until it gets
+	 * to air or to the outer walls. Returns how many blocks were broken.
+	 */
+	size_t digToAir(std::vector<std::int32_t> loc, std::int32_t step) {
+		size_t toreturn = 0;
+		while ((loc[0] >= 1) &&
+				(loc[0] <= static_cast<std::int32_t>(dimensions[0] - 2))) {
+			size_t ind = getInd(loc.begin());
+			if (!isOccupied(ind)) {
 				break;
 			}
+			setBlock(ind, 0);
+			toreturn++;
+			loc[0] += step;
+		}
+		return toreturn;
+	}
+
+	/**
+	 * The blocks at odd coordinates, the cells, that the algorithms other
+	 * than HEADS carve mazes out of, with cells next to each other along an
+	 * axis having one wall between them. Cells are numbered row-major.
+	 */
+	class Lattice {
+
+		size_t numDims;
+		std::vector<size_t> cellDims;
+		std::vector<size_t> cellProds;
+		size_t numCells;
+
+		size_t getCoord(size_t cell, size_t axis) const {
+			return (cell / cellProds[axis]) % cellDims[axis];
+		}
+
+		void getLoc(size_t cell, std::vector<std::int32_t>& loc) const {
+			for (size_t i = 0; i < numDims; i++) {
+				loc[i] = 2 * getCoord(cell, i) + 1;
+			}
+		}
+
+	public:
+		Lattice(const Maze& maze): numDims(maze.numDims),
+				cellDims(numDims), cellProds(numDims), numCells(1) {
+			for (size_t i = numDims; i-- > 0;) {
+				cellDims[i] = (maze.dimensions[i] - 1) / 2;
+				cellProds[i] = numCells;
+				numCells *= cellDims[i];
+			}
+		}
+
+		size_t getNumCells() const {
+			return numCells;
+		}
+
+		/**
+		 * The cell next to cell in direction dir, which is an axis, plus
+		 * numDims if negative, or numCells if it would be outside the maze.
+		 */
+		size_t getNeighbour(size_t cell, size_t dir) const {
+			if (dir < numDims) {
+				return (getCoord(cell, dir) + 1 < cellDims[dir])?
+						cell + cellProds[dir]: numCells;
+			}
+			return (getCoord(cell, dir - numDims) > 0)?
+					cell - cellProds[dir - numDims]: numCells;
+		}
+
+		void carveCell(Maze& maze, size_t cell,
+				std::vector<std::int32_t>& loc) const {
+			getLoc(cell, loc);
+			maze.setBlock(loc.begin(), 0);
+		}
+
+		/**
+		 * Carves the wall between cell and the cell in direction dir.
+		 */
+		void carveWall(Maze& maze, size_t cell, size_t dir,
+				std::vector<std::int32_t>& loc) const {
+			getLoc(cell, loc);
+			if (dir < numDims) {
+				loc[dir]++;
+			} else {
+				loc[dir - numDims]--;
+			}
+			maze.setBlock(loc.begin(), 0);
+		}
+
+		/**
+		 * Carves from the last cell out through the outer walls along axis.
+		 * Returns how many blocks it carved.
+		 */
+		size_t carveExit(Maze& maze, size_t axis,
+				std::vector<std::int32_t>& loc) const {
+			getLoc(numCells - 1, loc);
+			size_t toreturn = 0;
+			while (loc[axis] < static_cast<std::int32_t>(
+					maze.dimensions[axis] - 1)) {
+				loc[axis]++;
+				maze.setBlock(loc.begin(), 0);
+				toreturn++;
+			}
+			return toreturn;
+		}
+
+	};
+
+	/**
+	 * Knocks down the walls between cells in a random order, skipping those
+	 * between cells that are already connected.
+	 * Takes O(numCells * numDims) time and memory.
+	 */
+	void carveKruskal(const Lattice& lattice, MazeRandom& mazeRand) {
+		size_t numCells = lattice.getNumCells();
+		std::vector<std::int32_t> loc (numDims);
+		// each is a cell times numDims plus the axis of the wall above it
+		std::vector<std::uint64_t> walls;
+		for (size_t cell = 0; cell < numCells; cell++) {
+			lattice.carveCell(*this, cell, loc);
+			for (size_t axis = 0; axis < numDims; axis++) {
+				if (lattice.getNeighbour(cell, axis) < numCells) {
+					walls.push_back(cell * numDims + axis);
+				}
+			}
+		}
+		std::shuffle(walls.begin(), walls.end(), mazeRand);
+		// union-find, where roots are their own parents
+		std::vector<size_t> parents (numCells);
+		std::vector<size_t> sizes (numCells, 1);
+		for (size_t cell = 0; cell < numCells; cell++) {
+			parents[cell] = cell;
+		}
+		auto find = [&parents] (size_t cell) -> size_t {
+			while (parents[cell] != cell) {
+				parents[cell] = parents[parents[cell]];
+				cell = parents[cell];
+			}
+			return cell;
+		};
+		for (std::uint64_t wall: walls) {
+			size_t cell = wall / numDims;
+			size_t axis = wall % numDims;
+			size_t root = find(cell);
+			size_t otherRoot = find(lattice.getNeighbour(cell, axis));
+			if (root == otherRoot) {
+				continue;
+			}
+			if (sizes[root] < sizes[otherRoot]) {
+				std::swap(root, otherRoot);
+			}
+			parents[otherRoot] = root;
+			sizes[root] += sizes[otherRoot];
+			lattice.carveWall(*this, cell, axis, loc);
+		}
+	}
+
+	/**
+	 * Walks from the first cell to random cells it hasn't been to yet,
+	 * going back along its stack when there are none.
+	 * Takes O(numCells * numDims) time and O(numCells) memory.
+	 */
+	void carveBacktracker(const Lattice& lattice, MazeRandom& mazeRand) {
+		size_t numCells = lattice.getNumCells();
+		std::vector<std::int32_t> loc (numDims);
+		std::vector<bool> isVisited (numCells);
+		std::vector<size_t> stack {0};
+		std::vector<size_t> dirs (numDims * 2);
+		isVisited[0] = true;
+		lattice.carveCell(*this, 0, loc);
+		while (!stack.empty()) {
+			size_t cell = stack.back();
+			size_t numFree = 0;
+			for (size_t dir = 0; dir < numDims * 2; dir++) {
+				size_t next = lattice.getNeighbour(cell, dir);
+				if ((next < numCells) && !isVisited[next]) {
+					dirs[numFree++] = dir;
+				}
+			}
+			if (numFree == 0) {
+				stack.pop_back();
+				continue;
+			}
+			std::uniform_int_distribution<size_t> distro (0, numFree - 1);
+			size_t dir = dirs[distro(mazeRand)];
+			size_t next = lattice.getNeighbour(cell, dir);
+			isVisited[next] = true;
+			lattice.carveWall(*this, cell, dir, loc);
+			lattice.carveCell(*this, next, loc);
+			stack.push_back(next);
+		}
+	}
+
+	/**
+	 * Starting with just the first cell in the maze, walks randomly from
+	 * each cell not in it yet until it gets to one that is, and adds the
+	 * walk with its loops taken out. Every possible maze is as likely.
+	 * Takes O(numCells) memory. The time is random, but the walks take
+	 * about numCells log numCells steps in all in 2 dimensions, and
+	 * O(numCells) in more.
+	 */
+	void carveWilson(const Lattice& lattice, MazeRandom& mazeRand) {
+		size_t numCells = lattice.getNumCells();
+		std::vector<std::int32_t> loc (numDims);
+		std::vector<bool> isInMaze (numCells);
+		// the direction the walk last left each cell in
+		std::vector<std::uint8_t> exits (numCells);
+		std::vector<size_t> dirs (numDims * 2);
+		isInMaze[0] = true;
+		lattice.carveCell(*this, 0, loc);
+		for (size_t first = 1; first < numCells; first++) {
+			size_t cell = first;
+			while (!isInMaze[cell]) {
+				size_t numFree = 0;
+				for (size_t dir = 0; dir < numDims * 2; dir++) {
+					if (lattice.getNeighbour(cell, dir) < numCells) {
+						dirs[numFree++] = dir;
+					}
+				}
+				std::uniform_int_distribution<size_t> distro (0, numFree - 1);
+				exits[cell] = dirs[distro(mazeRand)];
+				cell = lattice.getNeighbour(cell, exits[cell]);
+			}
+			// following the last exits skips any loops the walk made
+			for (cell = first; !isInMaze[cell];
+					cell = lattice.getNeighbour(cell, exits[cell])) {
+				isInMaze[cell] = true;
+				lattice.carveCell(*this, cell, loc);
+				lattice.carveWall(*this, cell, exits[cell], loc);
+			}
+		}
+	}
+
+	/**
+	 * Fills the blocks from begin to end - 1, in memory, with random walls,
+	 * 1 to 7, from the 16 bits philox gives for each of them at its block
+	 * counter, which has 8 blocks. Padding past the end of an axis stays air.
+	 * Not for CHUNKED.
+	 */
+	void fillRandomRange(const Philox& philox, size_t begin, size_t end) {
+		const size_t batchLength = MazeStorage::rangeAlignment * 16;
+		std::vector<std::uint32_t> words (batchLength / 2);
+		std::vector<std::uint8_t> blocks (batchLength);
+		std::vector<std::int32_t> loc (numDims);
+		size_t brickLength = brickStrides[numDims - 1];
+		for (size_t batch = begin; batch < end; batch += batchLength) {
+			size_t length = std::min(batchLength, end - batch);
+			philox.generate(batch / 8, (length + 7) / 8, words.data());
+			for (size_t i = 0; i < length; i++) {
+				std::uint32_t bits = (words[i >> 1] >> ((i & 1) << 4)) & 0xFFFF;
+				blocks[i] = 1 + ((bits * 7) >> 16);
+			}
+			for (size_t brick = batch / brickLength * brickLength;
+					(layout == MazeLayout::BRICKED) && (brick < batch + length);
+					brick += brickLength) {
+				fromInd(brick, loc.begin());
+				bool isPadded = false;
+				for (size_t i = 0; i < numDims; i++) {
+					isPadded = isPadded ||
+							(loc[i] + 4 > static_cast<std::int32_t>(dimensions[i]));
+				}
+				size_t indEnd = std::min(brick + brickLength, batch + length);
+				for (size_t ind = std::max(brick, batch); isPadded && (ind < indEnd);
+						ind++) {
+					fromInd(ind, loc.begin());
+					for (size_t i = 0; i < numDims; i++) {
+						if (loc[i] >= static_cast<std::int32_t>(dimensions[i])) {
+							blocks[ind - batch] = 0;
+							break;
+						}
+					}
+				}
+			}
+			data->setRange(batch, batch + length, blocks.data());
+		}
+	}
+
+	/**
+	 * Fills the maze with random walls, from where blocks are in memory
+	 * rather than one after the other, so that it can be split up between
+	 * threads and still give the same walls. With CHUNKED, each chunk
+	 * gets a single wall.
+	 */
+	void fillRandom(const Philox& philox,
+			size_t numThreads = multithread::getNumThreads()) {
+		if (layout == MazeLayout::CHUNKED) {
+			size_t numChunks = data->getNumChunks();
+			std::vector<std::uint32_t> words ((numChunks + 7) / 8 * 4);
+			philox.generate(0, words.size() / 4, words.data());
+			for (size_t chunk = 0; chunk < numChunks; chunk++) {
+				std::uint32_t bits =
+						(words[chunk >> 1] >> ((chunk & 1) << 4)) & 0xFFFF;
+				data->setChunk(chunk, 1 + ((bits * 7) >> 16));
+			}
+			return;
+		}
+		data->reserveBlocks(1, 7);
+		size_t align = MazeStorage::rangeAlignment;
+		size_t pieceLength = (dataLength / numThreads + align) / align * align;
+		std::vector<std::thread> threads;
+		for (size_t begin = 0; begin < dataLength; begin += pieceLength) {
+			size_t end = std::min(dataLength, begin + pieceLength);
+			threads.push_back(std::thread([this, &philox, begin, end] () -> void {
+				fillRandomRange(philox, begin, end);
+			}));
+		}
+		for (std::thread& thread: threads) {
+			thread.join();
+		}
+	}
+
+	/**
+	 * Fills the maze with random walls, for carving into.
+	 */
+	void fillForCarving(const MazeGenerationOptions& options,
+			MazeRandom& mazeRand) {
+		std::uniform_int_distribution<std::uint8_t> iDistro (1, 7);
+		if (options.getRandomEngine() == RandomEngine::PHILOX) {
+			fillRandom(mazeRand.getPhilox());
+		} else if (layout == MazeLayout::CHUNKED) {
+			// so that the chunks stay tags until something is carved out
+			size_t numChunks = data->getNumChunks();
+			for (size_t chunk = 0; chunk < numChunks; chunk++) {
+				data->setChunk(chunk, iDistro(mazeRand));
+			}
+		} else {
+			forEachBlock([this, &mazeRand, &iDistro] (size_t ind) -> void {
+				data->set(ind, iDistro(mazeRand));
+			});
+		}
+	}
+
+	/**
+	 * Carves the whole maze with an algorithm other than HEADS, and returns
+	 * how many blocks were broken.
+	 */
+	size_t carveLattice(const MazeGenerationOptions& options,
+			MazeRandom& mazeRand) {
+		MazeAlgorithm algorithm = options.getAlgorithm();
+		Lattice lattice (*this);
+		if (algorithm == MazeAlgorithm::KRUSKAL) {
+			carveKruskal(lattice, mazeRand);
+		} else if (algorithm == MazeAlgorithm::BACKTRACKER) {
+			carveBacktracker(lattice, mazeRand);
+		} else {
+			carveWilson(lattice, mazeRand);
 		}
-		delete[] possibilities;
 		std::uniform_int_distribution<size_t> dirDistro (0, numDims - 1);
-		size_t dir = dirDistro(mtrand);
-		Head head (*this, last);
+		std::vector<std::int32_t> loc (numDims);
+		// every cell, and a wall for each but the first
+		return 2 * lattice.getNumCells() - 1 +
+				lattice.carveExit(*this, dirDistro(mazeRand), loc);
+	}
+
+	/**
+	 * Sets up HEADS: one carver for the whole maze, or one for each slab
+	 * between bands if there are enough threads, each with a corridor
+	 * through the band above it.
+	 */
+	void makeCarvers(const MazeGenerationOptions& options,
+			MazeRandom& mazeRand, std::vector<std::int32_t>& bands,
+			std::vector<std::vector<std::int32_t>>& corridors,
+			std::vector<MazeRandom>& slabRands, std::deque<Carver>& carvers) {
+		std::vector<std::int32_t> corner (numDims, 1);
+		// oneoneone is literally the ind of (1, 1, 1, 1, ....)
+		size_t oneoneone = getInd(corner.begin());
+		std::vector<std::int32_t> lo (numDims, 0);
+		std::vector<std::int32_t> hi (dimensions.get(), dimensions.get() + numDims);
+		bands = getBands(options.getNumThreads());
+		// where the corridor through each band is, along the other axes
+		for (size_t band = 0; band < bands.size(); band++) {
+			std::vector<std::int32_t> corridor (numDims);
+			for (size_t i = 1; i < numDims; i++) {
+				std::uniform_int_distribution<std::int32_t> distro (
+						1, dimensions[i] - 2);
+				corridor[i] = distro(mazeRand);
+			}
+			corridors.push_back(corridor);
+		}
+		if (bands.empty()) {
+			carvers.emplace_back(*this, options, lo.data(), hi.data(),
+					oneoneone, getLastCell(), mazeRand);
+		} else {
+			makeSlabCarvers(options, bands, corridors, slabRands, carvers);
+		}
+	}
+
+	/**
+	 * Finishes HEADS once the carvers are done, having broken
+	 * numBlocksBroken blocks, by joining up the slabs and carving a way
+	 * out. Returns how many blocks were broken altogether.
+	 */
+	size_t finishCarving(MazeRandom& mazeRand,
+			const std::vector<std::int32_t>& bands,
+			const std::vector<std::vector<std::int32_t>>& corridors,
+			size_t numBlocksBroken) {
+		if (!bands.empty()) {
+			numBlocksBroken += joinAllSlabs(bands, corridors);
+		}
+		std::uniform_int_distribution<size_t> dirDistro (0, numDims - 1);
+		size_t dir = dirDistro(mazeRand);
+		std::vector<std::int32_t> lo (numDims, 0);
+		std::vector<std::int32_t> hi (dimensions.get(), dimensions.get() + numDims);
+		Trail trail;
+		Neighbours neighbours (*this);
+		Head head (*this, getLastCell(), trail, neighbours, lo.data(), hi.data());
 		head.eat(*this, dir, numBlocksBroken);
+		return numBlocksBroken;
+	}
+
+	/**
+	 * The ind of (dims[0] - 2, dims[1] - 2, dims[2] - 2, ...)
+	 */
+	size_t getLastCell() const {
+		std::vector<std::int32_t> corner (numDims);
+		for (size_t i = 0; i < numDims; i++) {
+			corner[i] = dimensions[i] - 2;
+		}
+		return getInd(corner.begin());
+	}
+
+	void generate(const MazeGenerationOptions& options) {
+		MazeRandom mazeRand (options.getRandomEngine(), options.getSeed());
+		fillForCarving(options, mazeRand);
+		if (options.getAlgorithm() != MazeAlgorithm::HEADS) {
+			carveLattice(options, mazeRand);
+			return;
+		}
+		std::vector<std::int32_t> bands;
+		std::vector<std::vector<std::int32_t>> corridors;
+		std::vector<MazeRandom> slabRands;
+		// a deque so that heads can point into the carvers
+		std::deque<Carver> carvers;
+		makeCarvers(options, mazeRand, bands, corridors, slabRands, carvers);
+		finishCarving(mazeRand, bands, corridors, carveAll(carvers));
 	}
 
 };
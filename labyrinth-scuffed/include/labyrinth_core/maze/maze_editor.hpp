@@ -0,0 +1,161 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_EDITOR_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_EDITOR_HPP_
+
+#include <labyrinth_core/maze/maze.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * Changes to a maze while it is being rendered. setBlock only queues a
+ * change, and can be called from any thread. apply makes every change
+ * queued so far at once, between frames, and after that getMaze has them,
+ * to give to MazeRenderer::setMaze, which starts rendering it with the
+ * next frame, leaving frames already going on as they were.
+ * There are two mazes behind this, used turn about: apply changes the one
+ * renderers were given the time before last, catching it up with the
+ * changes it missed first. One is copied whole when this is made, and the
+ * other shares everything with maze until the caller lets go of it, so in
+ * steady state, when no frame still holds the older maze, neither the
+ * blocks nor the distance field nor the occupancy pyramid get copied,
+ * just updated where blocks change. If a frame does still hold it, apply
+ * copies what it changes: the bricks with CHUNKED, and the pages of the
+ * distance field and the pyramid it touches, but otherwise all the blocks.
+ */
+class MazeEditor {
+
+public:
+	typedef std::chrono::high_resolution_clock::time_point TimePoint;
+
+private:
+	struct Edit {
+
+		size_t ind;
+		std::uint8_t block;
+
+	};
+
+	// what Maze::getAxisOffset uses, so that setBlock doesn't look at the
+	// mazes while apply swaps them
+	std::vector<size_t> brickStrides;
+	std::vector<size_t> innerStrides;
+	// has every change applied
+	Maze front;
+	// has every change applied except for lastBatch
+	Maze back;
+	std::vector<Edit> lastBatch;
+	// what apply is applying, kept so that it doesn't allocate every time
+	std::vector<Edit> batch;
+	std::mutex queueMutex;
+	std::vector<Edit> queue;
+	// when the first of queue was queued
+	TimePoint queuedAt;
+	// when the first of lastBatch was queued
+	TimePoint changedAt;
+
+public:
+	explicit MazeEditor(const Maze& maze): brickStrides(maze.getNumDims()),
+			innerStrides(maze.getNumDims()), front(maze), back(maze),
+			changedAt(std::chrono::high_resolution_clock::now()) {
+		maze.getLayoutStrides(brickStrides.data(), innerStrides.data());
+		back.unshare();
+	}
+
+	MazeEditor(MazeEditor& other) = delete;
+	MazeEditor(const MazeEditor& other) = delete;
+	MazeEditor(MazeEditor&& other) = delete;
+	MazeEditor& operator=(MazeEditor& other) = delete;
+	MazeEditor& operator=(const MazeEditor& other) = delete;
+	MazeEditor& operator=(MazeEditor&& other) = delete;
+
+	/**
+	 * Queues setting the block at ind to block, for the next apply.
+	 */
+	void setBlock(size_t ind, std::uint8_t block) {
+		std::lock_guard<std::mutex> lock (queueMutex);
+		if (queue.empty()) {
+			queuedAt = std::chrono::high_resolution_clock::now();
+		}
+		queue.push_back(Edit{ind, block});
+	}
+
+	template<class Iter, class = typename std::enable_if<
+				std::is_same<
+				typename std::iterator_traits<Iter>::value_type,
+				std::int32_t
+				>::value>::type>
+	void setBlock(Iter location, std::uint8_t block) {
+		size_t ind = 0;
+		for (size_t i = 0; i < brickStrides.size(); ++i, ++location) {
+			ind += brickStrides[i] * (*location >> 2) +
+					innerStrides[i] * (*location & 3);
+		}
+		setBlock(ind, block);
+	}
+
+	size_t getNumQueued() {
+		std::lock_guard<std::mutex> lock (queueMutex);
+		return queue.size();
+	}
+
+	/**
+	 * Makes every change queued so far, in the order they were queued, and
+	 * returns how many there were. If there were none, getMaze stays the
+	 * same maze. Only one thread can call this, and getMaze, at a time.
+	 */
+	size_t apply() {
+		std::unique_lock<std::mutex> lock (queueMutex);
+		if (queue.empty()) {
+			return 0;
+		}
+		batch.swap(queue);
+		TimePoint batchQueuedAt = queuedAt;
+		lock.unlock();
+		for (const Edit& edit: lastBatch) {
+			back.setBlock(edit.ind, edit.block);
+		}
+		for (const Edit& edit: batch) {
+			back.setBlock(edit.ind, edit.block);
+		}
+		std::swap(front, back);
+		lastBatch.swap(batch);
+		batch.clear();
+		changedAt = batchQueuedAt;
+		return lastBatch.size();
+	}
+
+	/**
+	 * The maze with every change apply has made.
+	 */
+	const Maze& getMaze() const {
+		return front;
+	}
+
+	/**
+	 * When the first of the changes the last apply made was queued. Give
+	 * it to MazeRenderer::setMaze along with getMaze, and the stats of the
+	 * frame that first shows them say how long after that the frame
+	 * started, and was done.
+	 */
+	TimePoint getChangedAt() const {
+		return changedAt;
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_MAZE_EDITOR_HPP_ */
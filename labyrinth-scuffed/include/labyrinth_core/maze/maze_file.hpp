@@ -0,0 +1,440 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_FILE_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_FILE_HPP_
+
+#include <labyrinth_core/maze/maze.hpp>
+#include <labyrinth_core/maze/maze_storage.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * Saves mazes to files, and loads them back, even in other processes.
+ * A file is a header, zeros up to the next multiple of pageSize, and then
+ * the packed blocks and the occupancy bits exactly as MazeStorage keeps
+ * them. So loading can just mmap the file, and the blocks get paged in
+ * as they are used. The header goes:
+ *
+ * magic, version, byteOrder, dataOffset (where the blocks start),
+ * dataLength, numDims, storage mode, layout, palette size, palette,
+ * dimensions, brick strides, inner strides, whether there are generation
+ * options, and if so: seed length, seed, density, branch probability,
+ * branch death probability, twist probability, flow probability,
+ * restrict new amount, loop probability, block probability, max useless,
+ * number of threads, algorithm and random engine.
+ *
+ * Numbers are in the byte order of whatever wrote them, which byteOrder
+ * is there to catch. The distance field and the occupancy pyramid
+ * aren't saved, since they are quick to build again.
+ */
+class MazeFile {
+
+	static constexpr size_t magicLength = 8;
+	static constexpr std::uint32_t version = 1;
+	static constexpr std::uint32_t byteOrder = 0x01020304;
+	static constexpr std::uint64_t pageSize = 4096;
+	// magic, version, byteOrder and dataOffset
+	static constexpr size_t prefixLength = 24;
+
+	static const char* getMagic() {
+		return "LABYMAZE";
+	}
+
+	template<class T>
+	static void put(std::vector<char>& header, T value) {
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		header.insert(header.end(), bytes, bytes + sizeof(T));
+	}
+
+	/**
+	 * Reads header from pos onwards, or returns false if it runs out.
+	 */
+	template<class T>
+	static bool get(const char* header, size_t headerLength, size_t& pos,
+			T& value) {
+		if (pos + sizeof(T) > headerLength) {
+			return false;
+		}
+		std::memcpy(&value, header + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	static bool getOptions(const char* header, size_t headerLength,
+			size_t& pos, Maze::MazeGenerationOptions& options) {
+		std::uint64_t seedLength;
+		if (!get(header, headerLength, pos, seedLength) ||
+				(pos + seedLength > headerLength)) {
+			return false;
+		}
+		options.setSeed(std::string(header + pos, seedLength));
+		pos += seedLength;
+		double density, branchProbability, branchDeathProbability,
+				twistProbability, flowProbability,
+				loopProbability, blockProbability;
+		std::uint64_t restrictNewAmount, maxUseless, numThreads;
+		std::uint8_t algorithm, randomEngine;
+		if (!(get(header, headerLength, pos, density) &&
+				get(header, headerLength, pos, branchProbability) &&
+				get(header, headerLength, pos, branchDeathProbability) &&
+				get(header, headerLength, pos, twistProbability) &&
+				get(header, headerLength, pos, flowProbability) &&
+				get(header, headerLength, pos, restrictNewAmount) &&
+				get(header, headerLength, pos, loopProbability) &&
+				get(header, headerLength, pos, blockProbability) &&
+				get(header, headerLength, pos, maxUseless) &&
+				get(header, headerLength, pos, numThreads) &&
+				get(header, headerLength, pos, algorithm) &&
+				get(header, headerLength, pos, randomEngine)) ||
+				(algorithm > static_cast<std::uint8_t>(MazeAlgorithm::WILSON)) ||
+				(randomEngine > static_cast<std::uint8_t>(RandomEngine::PHILOX))) {
+			return false;
+		}
+		options.setDensity(density);
+		options.setBranchProbability(branchProbability);
+		options.setBranchDeathProbability(branchDeathProbability);
+		options.setTwistProbability(twistProbability);
+		options.setFlowProbability(flowProbability);
+		options.setRestrictNewAmount(restrictNewAmount);
+		options.setLoopProbability(loopProbability);
+		options.setBlockProbability(blockProbability);
+		options.setMaxUseless(maxUseless);
+		options.setNumThreads(numThreads);
+		options.setAlgorithm(static_cast<MazeAlgorithm>(algorithm));
+		options.setRandomEngine(static_cast<RandomEngine>(randomEngine));
+		return true;
+	}
+
+	/**
+	 * Makes a maze out of the header and the blocks, which get owned by it.
+	 * Returns nullptr, and frees the blocks, if the header is wrong.
+	 */
+	static Maze* makeMaze(const char* header, size_t headerLength,
+			std::uint64_t* words, std::uint64_t* occupancy,
+			void* mapping, size_t mappingLength,
+			Maze::MazeGenerationOptions* options) {
+		size_t pos = prefixLength;
+		std::uint64_t dataLength = 0, numDims = 0;
+		std::uint8_t storageMode = 0, layout = 0;
+		std::uint16_t paletteSize = 0;
+		bool isFine = get(header, headerLength, pos, dataLength) &&
+				get(header, headerLength, pos, numDims) &&
+				get(header, headerLength, pos, storageMode) &&
+				get(header, headerLength, pos, layout) &&
+				get(header, headerLength, pos, paletteSize) &&
+				(storageMode <= static_cast<std::uint8_t>(StorageMode::TRIBIT)) &&
+				(layout <= static_cast<std::uint8_t>(MazeLayout::BRICKED)) &&
+				(numDims >= 2) && (numDims <= 64);
+		std::uint8_t palette[256];
+		std::vector<std::uint32_t> dims (isFine? numDims: 0);
+		std::vector<std::uint64_t> brickStrides (dims.size());
+		std::vector<std::uint64_t> innerStrides (dims.size());
+		for (size_t i = 0; isFine && (i < 256); i++) {
+			isFine = get(header, headerLength, pos, palette[i]);
+		}
+		if (isFine && (storageMode != static_cast<std::uint8_t>(StorageMode::BYTE))) {
+			// air has to be code 0
+			isFine = (paletteSize >= 1) && (palette[0] == 0) &&
+					(paletteSize <= MazeStorage::getPaletteCapacity(
+							static_cast<StorageMode>(storageMode)));
+		}
+		for (size_t i = 0; isFine && (i < dims.size()); i++) {
+			isFine = get(header, headerLength, pos, dims[i]) && (dims[i] > 0);
+		}
+		for (size_t i = 0; isFine && (i < dims.size()); i++) {
+			isFine = get(header, headerLength, pos, brickStrides[i]);
+		}
+		for (size_t i = 0; isFine && (i < dims.size()); i++) {
+			isFine = get(header, headerLength, pos, innerStrides[i]);
+		}
+		std::uint8_t hasOptions = 0;
+		isFine = isFine && get(header, headerLength, pos, hasOptions);
+		Maze::MazeGenerationOptions readOptions;
+		if (isFine && hasOptions) {
+			isFine = getOptions(header, headerLength, pos, readOptions);
+		}
+
+		MazeStorage* storage = new MazeStorage(isFine? dataLength: 0,
+				static_cast<StorageMode>(isFine? storageMode: 0),
+				words, occupancy, mapping, mappingLength);
+		if (!isFine) {
+			delete storage;
+			return nullptr;
+		}
+		for (size_t code = 0; code < paletteSize; code++) {
+			storage->palette[code] = palette[code];
+			storage->codes[palette[code]] = code;
+		}
+		if (paletteSize > 0) {
+			storage->paletteSize = paletteSize;
+		}
+		Maze* toreturn = new Maze(numDims, dims.data(),
+				static_cast<MazeLayout>(layout), storage);
+		// in case the file is from something that lays out mazes differently
+		isFine = toreturn->dataLength == dataLength;
+		for (size_t i = 0; isFine && (i < numDims); i++) {
+			isFine = (toreturn->brickStrides[i] == brickStrides[i]) &&
+					(toreturn->innerStrides[i] == innerStrides[i]);
+		}
+		if (!isFine) {
+			delete toreturn;
+			return nullptr;
+		}
+		if (options && hasOptions) {
+			readOptions.setDimensions(dims);
+			readOptions.setStorageMode(static_cast<StorageMode>(storageMode));
+			readOptions.setLayout(static_cast<MazeLayout>(layout));
+			*options = readOptions;
+		}
+		return toreturn;
+	}
+
+	/**
+	 * Checks the prefix, and returns where the blocks start, or 0.
+	 */
+	static std::uint64_t getDataOffset(const char* prefix) {
+		std::uint32_t fileVersion, fileByteOrder;
+		std::uint64_t dataOffset;
+		size_t pos = magicLength;
+		get(prefix, prefixLength, pos, fileVersion);
+		get(prefix, prefixLength, pos, fileByteOrder);
+		get(prefix, prefixLength, pos, dataOffset);
+		if ((std::memcmp(prefix, getMagic(), magicLength) != 0) ||
+				(fileVersion != version) ||
+				(fileByteOrder != byteOrder) ||
+				(dataOffset < prefixLength) || (dataOffset % pageSize != 0)) {
+			return 0;
+		}
+		return dataOffset;
+	}
+
+	/**
+	 * Works out how many words of blocks and of occupancy bits there are,
+	 * from the header. Returns false if the file is too short for them.
+	 */
+	static bool getNumWords(const char* header, size_t headerLength,
+			size_t fileLength, size_t* numWords, size_t* numOccupancyWords) {
+		std::uint64_t dataLength, numDims;
+		std::uint8_t storageMode;
+		size_t pos = prefixLength;
+		if (!get(header, headerLength, pos, dataLength) ||
+				!get(header, headerLength, pos, numDims) ||
+				!get(header, headerLength, pos, storageMode) ||
+				(storageMode > static_cast<std::uint8_t>(StorageMode::TRIBIT)) ||
+				// so that nothing below overflows
+				(dataLength / 8 > fileLength)) {
+			return false;
+		}
+		*numWords = MazeStorage::getNumWords(
+				static_cast<StorageMode>(storageMode), dataLength);
+		*numOccupancyWords = (dataLength + 63) / 64;
+		return (*numWords + *numOccupancyWords) * sizeof(std::uint64_t) <=
+				fileLength - headerLength;
+	}
+
+	static Maze* loadMapped(const std::string& path,
+			Maze::MazeGenerationOptions* options) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return nullptr;
+		}
+		struct stat fileStat;
+		if ((fstat(fd, &fileStat) != 0) ||
+				(static_cast<size_t>(fileStat.st_size) < prefixLength)) {
+			close(fd);
+			return nullptr;
+		}
+		size_t fileLength = fileStat.st_size;
+		// private, so that setBlock changes the maze but not the file
+		void* mapping = mmap(nullptr, fileLength, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE, fd, 0);
+		// the mapping keeps the file around
+		close(fd);
+		if (mapping == MAP_FAILED) {
+			return nullptr;
+		}
+		char* bytes = static_cast<char*>(mapping);
+		std::uint64_t dataOffset = getDataOffset(bytes);
+		size_t numWords, numOccupancyWords;
+		if ((dataOffset == 0) || (dataOffset > fileLength) ||
+				!getNumWords(bytes, dataOffset, fileLength,
+						&numWords, &numOccupancyWords)) {
+			munmap(mapping, fileLength);
+			return nullptr;
+		}
+		std::uint64_t* words =
+				reinterpret_cast<std::uint64_t*>(bytes + dataOffset);
+		return makeMaze(bytes, dataOffset, words, words + numWords,
+				mapping, fileLength, options);
+	}
+
+	static Maze* loadRead(const std::string& path,
+			Maze::MazeGenerationOptions* options) {
+		std::ifstream in (path, std::ios::binary | std::ios::ate);
+		size_t fileLength = in.tellg();
+		in.seekg(0);
+		std::vector<char> header (prefixLength);
+		if (!in.read(header.data(), prefixLength)) {
+			return nullptr;
+		}
+		std::uint64_t dataOffset = getDataOffset(header.data());
+		if ((dataOffset == 0) || (dataOffset > fileLength)) {
+			return nullptr;
+		}
+		header.resize(dataOffset);
+		if (!in.read(header.data() + prefixLength, dataOffset - prefixLength)) {
+			return nullptr;
+		}
+		size_t numWords, numOccupancyWords;
+		if (!getNumWords(header.data(), dataOffset, fileLength,
+				&numWords, &numOccupancyWords)) {
+			return nullptr;
+		}
+		// straight into where they will stay
+		std::uint64_t* words = new std::uint64_t[numWords];
+		std::uint64_t* occupancy = new std::uint64_t[numOccupancyWords];
+		if (!in.read(reinterpret_cast<char*>(words),
+						numWords * sizeof(std::uint64_t)) ||
+				!in.read(reinterpret_cast<char*>(occupancy),
+						numOccupancyWords * sizeof(std::uint64_t))) {
+			delete[] words;
+			delete[] occupancy;
+			return nullptr;
+		}
+		return makeMaze(header.data(), dataOffset, words, occupancy,
+				nullptr, 0, options);
+	}
+
+public:
+	/**
+	 * Writes maze to path, along with options if it isn't nullptr,
+	 * which should be what maze was generated with.
+	 * The blocks are written straight from the maze.
+	 * Returns false if writing failed, or if the layout is CHUNKED,
+	 * since then the blocks aren't all in one piece to be mapped.
+	 * The file is written next to path first, and only then moved over
+	 * it, so saving a maze loaded from path back to path works, even
+	 * though its blocks are still being read from the file being replaced,
+	 * and if writing fails, whatever was at path is left alone.
+	 */
+	static bool save(const Maze& maze, const std::string& path,
+			const Maze::MazeGenerationOptions* options = nullptr) {
+		const MazeStorage& storage = *maze.data;
+		if (storage.chunkLength) {
+			return false;
+		}
+		size_t numDims = maze.numDims;
+		std::vector<char> header (getMagic(), getMagic() + magicLength);
+		put(header, version);
+		put(header, byteOrder);
+		// dataOffset, filled in once the length of the header is known
+		put(header, static_cast<std::uint64_t>(0));
+		put(header, static_cast<std::uint64_t>(maze.dataLength));
+		put(header, static_cast<std::uint64_t>(numDims));
+		put(header, static_cast<std::uint8_t>(storage.mode));
+		put(header, static_cast<std::uint8_t>(maze.layout));
+		put(header, static_cast<std::uint16_t>(
+				(storage.mode == StorageMode::BYTE)? 0: storage.paletteSize));
+		for (size_t i = 0; i < 256; i++) {
+			put(header, storage.palette[i]);
+		}
+		for (size_t i = 0; i < numDims; i++) {
+			put(header, maze.dimensions[i]);
+		}
+		for (size_t i = 0; i < numDims; i++) {
+			put(header, static_cast<std::uint64_t>(maze.brickStrides[i]));
+		}
+		for (size_t i = 0; i < numDims; i++) {
+			put(header, static_cast<std::uint64_t>(maze.innerStrides[i]));
+		}
+		put(header, static_cast<std::uint8_t>(options? 1: 0));
+		if (options) {
+			std::string seed = options->getSeed();
+			put(header, static_cast<std::uint64_t>(seed.size()));
+			header.insert(header.end(), seed.begin(), seed.end());
+			put(header, options->getDensity());
+			put(header, options->getBranchProbability());
+			put(header, options->getBranchDeathProbability());
+			put(header, options->getTwistProbability());
+			put(header, options->getFlowProbability());
+			put(header, static_cast<std::uint64_t>(
+					options->getRestrictNewAmount()));
+			put(header, options->getLoopProbability());
+			put(header, options->getBlockProbability());
+			put(header, static_cast<std::uint64_t>(options->getMaxUseless()));
+			put(header, static_cast<std::uint64_t>(options->getNumThreads()));
+			put(header, static_cast<std::uint8_t>(options->getAlgorithm()));
+			put(header, static_cast<std::uint8_t>(options->getRandomEngine()));
+		}
+		std::uint64_t dataOffset =
+				(header.size() + pageSize - 1) / pageSize * pageSize;
+		std::memcpy(header.data() + prefixLength - sizeof(dataOffset),
+				&dataOffset, sizeof(dataOffset));
+		header.resize(dataOffset, 0);
+
+		// in the same directory, so that rename doesn't have to copy it
+		std::string tmpPath = path + ".XXXXXX";
+		int fd = mkstemp(&tmpPath[0]);
+		if (fd < 0) {
+			return false;
+		}
+		// mkstemp makes it only readable by its owner. Whatever it
+		// replaces keeps its permissions, and new files get the usual.
+		struct stat pathStat;
+		fchmod(fd, (stat(path.c_str(), &pathStat) == 0)?
+				(pathStat.st_mode & 07777): 0644);
+		close(fd);
+		std::ofstream out (tmpPath, std::ios::binary | std::ios::trunc);
+		out.write(header.data(), header.size());
+		out.write(reinterpret_cast<const char*>(storage.words),
+				MazeStorage::getNumWords(storage.mode, storage.length) *
+				sizeof(std::uint64_t));
+		out.write(reinterpret_cast<const char*>(storage.occupancy),
+				(storage.length + 63) / 64 * sizeof(std::uint64_t));
+		out.close();
+		// a mapping of the file being replaced keeps what it had,
+		// as the file only loses its name
+		if (out.fail() || (std::rename(tmpPath.c_str(), path.c_str()) != 0)) {
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Loads a maze saved by save. You delete this. If shouldMap, the file
+	 * is mapped into memory instead of read, and setBlock on the maze
+	 * doesn't touch the file. If the file has generation options and
+	 * options isn't nullptr, they are put in options.
+	 * Returns nullptr if the file can't be read or isn't a maze.
+	 */
+	static Maze* load(const std::string& path,
+			Maze::MazeGenerationOptions* options = nullptr,
+			bool shouldMap = true) {
+		if (shouldMap) {
+			return loadMapped(path, options);
+		}
+		return loadRead(path, options);
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_MAZE_FILE_HPP_ */
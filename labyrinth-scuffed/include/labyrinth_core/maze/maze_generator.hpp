@@ -0,0 +1,253 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_GENERATOR_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_GENERATOR_HPP_
+
+#include <labyrinth_core/maze/maze.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * Generates the same maze as Maze(options), but a step at a time, so that
+ * it can be shown while it gets carved. Each step carves about as many
+ * blocks as it is told to, on a thread for each slab that waits between
+ * steps, and then copies just the box of blocks carved that step into
+ * getMaze, which nothing carves into, so the blocks being carved are only
+ * ever copied whole the once, at the start.
+ * Until it is done, getMaze is CHUNKED, whatever layout the options ask
+ * for, so that a copy of it still around at the next step, like one a
+ * MazeRenderer has, only costs that step copies of the chunks it changes.
+ * Once it is done, getMaze is laid out the way the options ask.
+ * Only HEADS stops along the way; the other algorithms carve everything
+ * in the first step.
+ */
+class MazeGenerator {
+
+	Maze::MazeGenerationOptions options;
+	// what gets carved into, which nothing shares once carving starts
+	Maze maze;
+	// what step has copied out of maze so far, CHUNKED until it's done
+	Maze shown;
+	MazeRandom mazeRand;
+	std::vector<std::int32_t> bands;
+	std::vector<std::vector<std::int32_t>> corridors;
+	std::vector<MazeRandom> slabRands;
+	// a deque so that heads can point into the carvers
+	std::deque<Maze::Carver> carvers;
+	Maze::MazeGenerationProgress progress;
+	// one for each carver if there is more than 1, each carving a round
+	// whenever round goes up, and then adding to numFinished
+	std::vector<std::thread> threads;
+	std::mutex roundMutex;
+	std::condition_variable roundStarted;
+	std::condition_variable roundFinished;
+	size_t round;
+	size_t numFinished;
+	size_t maxBlocks;
+	bool isStopping;
+
+	void carveRounds(Maze::Carver& carver) {
+		size_t lastRound = 0;
+		while (true) {
+			std::unique_lock<std::mutex> lock (roundMutex);
+			roundStarted.wait(lock, [this, lastRound] () -> bool {
+				return isStopping || (round != lastRound);
+			});
+			if (isStopping) {
+				return;
+			}
+			lastRound = round;
+			size_t roundBlocks = maxBlocks;
+			lock.unlock();
+			carver.carveSome(roundBlocks);
+			lock.lock();
+			numFinished++;
+			lock.unlock();
+			roundFinished.notify_one();
+		}
+	}
+
+	void stopThreads() {
+		{
+			std::lock_guard<std::mutex> lock (roundMutex);
+			isStopping = true;
+		}
+		roundStarted.notify_all();
+		for (std::thread& thread: threads) {
+			thread.join();
+		}
+		threads.clear();
+	}
+
+	// once it's done, everything is what's new
+	void finish(size_t numBlocksBroken) {
+		stopThreads();
+		shown = maze;
+		progress.numBlocksBroken = numBlocksBroken;
+		progress.dirtyLo.assign(maze.numDims, 0);
+		progress.dirtyHi.assign(maze.dimensions.get(),
+				maze.dimensions.get() + maze.numDims);
+		progress.isDone = true;
+	}
+
+public:
+	explicit MazeGenerator(const Maze::MazeGenerationOptions& inOptions):
+			options(inOptions), maze(inOptions.getDimensions(),
+					inOptions.getStorageMode(), inOptions.getLayout()),
+			shown(inOptions.getDimensions(), inOptions.getStorageMode(),
+					MazeLayout::CHUNKED),
+			mazeRand(inOptions.getRandomEngine(), inOptions.getSeed()),
+			round(0), numFinished(0), maxBlocks(0), isStopping(false) {
+		maze.fillForCarving(options, mazeRand);
+		size_t numDims = maze.numDims;
+		if (maze.layout == MazeLayout::CHUNKED) {
+			// shares the blocks with maze until the carvers carve their
+			// first, so that is the one time the blocks get copied whole
+			shown = maze;
+		} else {
+			// and here the walls get copied whole the once instead
+			std::vector<std::int32_t> lo (numDims, 0);
+			std::vector<std::int32_t> hi (maze.dimensions.get(),
+					maze.dimensions.get() + numDims);
+			shown.copyBox(maze, lo.data(), hi.data());
+		}
+		progress.numBlocksBroken = 0;
+		progress.numHeads = 0;
+		progress.streakOfUseless = 0;
+		progress.dirtyLo.assign(numDims, 0);
+		progress.dirtyHi.assign(maze.dimensions.get(),
+				maze.dimensions.get() + numDims);
+		progress.isDone = false;
+		if (options.getAlgorithm() == MazeAlgorithm::HEADS) {
+			maze.makeCarvers(options, mazeRand, bands, corridors, slabRands,
+					carvers);
+		}
+		if (carvers.size() > 1) {
+			for (Maze::Carver& carver: carvers) {
+				threads.push_back(std::thread([this, &carver] () -> void {
+					carveRounds(carver);
+				}));
+			}
+		}
+	}
+
+	MazeGenerator(MazeGenerator& other) = delete;
+	MazeGenerator(const MazeGenerator& other) = delete;
+	MazeGenerator(MazeGenerator&& other) = delete;
+	MazeGenerator& operator=(MazeGenerator& other) = delete;
+	MazeGenerator& operator=(const MazeGenerator& other) = delete;
+	MazeGenerator& operator=(MazeGenerator&& other) = delete;
+
+	~MazeGenerator() {
+		stopThreads();
+	}
+
+	/**
+	 * Carves until about numBlocks more blocks are broken, over all the
+	 * slabs, or until it is done if numBlocks is 0, and then updates
+	 * getMaze and getProgress. Returns whether it is done.
+	 */
+	bool step(size_t numBlocks) {
+		if (progress.isDone) {
+			return true;
+		}
+		if (options.getAlgorithm() != MazeAlgorithm::HEADS) {
+			finish(maze.carveLattice(options, mazeRand));
+			return true;
+		}
+		size_t numCarvers = carvers.size();
+		size_t blocksEach = static_cast<size_t>(-1);
+		if (numBlocks > 0) {
+			blocksEach = std::max(static_cast<size_t>(1), numBlocks / numCarvers);
+		}
+		if (threads.empty()) {
+			carvers[0].carveSome(blocksEach);
+		} else {
+			{
+				std::lock_guard<std::mutex> lock (roundMutex);
+				maxBlocks = blocksEach;
+				numFinished = 0;
+				round++;
+			}
+			roundStarted.notify_all();
+			std::unique_lock<std::mutex> lock (roundMutex);
+			roundFinished.wait(lock, [this, numCarvers] () -> bool {
+				return numFinished == numCarvers;
+			});
+		}
+		bool isDone = true;
+		size_t numBlocksBroken = 0;
+		for (const Maze::Carver& carver: carvers) {
+			isDone = isDone && carver.getIsDone();
+			numBlocksBroken += carver.getNumBlocksBroken();
+		}
+		if (isDone) {
+			finish(maze.finishCarving(mazeRand, bands, corridors,
+					numBlocksBroken));
+			return true;
+		}
+		size_t numDims = maze.numDims;
+		progress.numBlocksBroken = numBlocksBroken;
+		progress.numHeads = 0;
+		progress.streakOfUseless = 0;
+		progress.dirtyLo.assign(maze.dimensions.get(),
+				maze.dimensions.get() + numDims);
+		progress.dirtyHi.assign(numDims, 0);
+		std::vector<std::int32_t> lo (numDims), hi (numDims);
+		for (Maze::Carver& carver: carvers) {
+			progress.numHeads += carver.getNumHeads();
+			progress.streakOfUseless = std::max(progress.streakOfUseless,
+					carver.getStreakOfUseless());
+			// each slab's box on its own, so that what gets copied
+			// isn't everything between them
+			lo.assign(maze.dimensions.get(), maze.dimensions.get() + numDims);
+			hi.assign(numDims, 0);
+			carver.takeDirty(lo, hi);
+			if (lo[0] >= hi[0]) {
+				continue;
+			}
+			shown.copyBox(maze, lo.data(), hi.data());
+			for (size_t i = 0; i < numDims; i++) {
+				progress.dirtyLo[i] = std::min(progress.dirtyLo[i], lo[i]);
+				progress.dirtyHi[i] = std::max(progress.dirtyHi[i], hi[i]);
+			}
+		}
+		if (progress.dirtyLo[0] >= progress.dirtyHi[0]) {
+			progress.dirtyHi = progress.dirtyLo;
+		}
+		return false;
+	}
+
+	/**
+	 * The maze as of the last step, and all walls before the first. Once
+	 * it is done, this is the same as Maze(options) would have been.
+	 */
+	const Maze& getMaze() const {
+		return shown;
+	}
+
+	/**
+	 * How far along the last step got. Before the first, the dirty box is
+	 * the whole maze, since none of it has been shown yet.
+	 */
+	const Maze::MazeGenerationProgress& getProgress() const {
+		return progress;
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_MAZE_GENERATOR_HPP_ */
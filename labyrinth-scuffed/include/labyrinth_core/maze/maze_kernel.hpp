@@ -2,6 +2,7 @@
 #define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_KERNEL_HPP_
 
 #include <labyrinth_core/color.hpp>
+#include <labyrinth_core/dim_array.hpp>
 #include <labyrinth_core/maze/maze.hpp>
 
 #include <algorithm>
@@ -13,34 +14,154 @@ namespace labyrinth_core {
 
 namespace maze {
 
+/**
+ * What a ray hit. Doesn't allocate anything,
+ * so it is fine to cast lots of rays.
+ */
+struct RayHit {
+
+	double t;
+	// if this is false, then no intersect, and the rest is meaningless.
+	bool hit;
+	// the index of the block hit, in the maze
+	size_t block;
+	// the axis of the face of the block that was hit. This is numDims
+	// if the camera is inside the block hit, as then there is no face.
+	size_t axis;
+	// the normal of that face is face times the unit vector of axis.
+	// 0 if there is no face.
+	std::int8_t face;
+	// how many blocks the ray looked at on the way
+	size_t numSteps;
+
+};
+
+/**
+ * What a MazeKernel uses to skip over air.
+ * NONE steps through every block, like a plain DDA.
+ * DISTANCE_FIELD needs Maze::buildDistanceField,
+ * and OCCUPANCY_PYRAMID needs Maze::buildOccupancyPyramid.
+ * CHUNKS skips bricks that are all air, and needs the CHUNKED layout.
+ */
+enum class Acceleration {
+	NONE, DISTANCE_FIELD, OCCUPANCY_PYRAMID, CHUNKS
+};
+
+/**
+ * Casts rays through a maze. If N is positive, it must be the number of
+ * dimensions of the maze, and all the per-axis loops get unrolled.
+ * If N is 0, the number of dimensions is only known at runtime.
+ */
+template<size_t N = 0>
 class MazeKernel {
 
+	// the maze as it was when this was made, or when setMaze was last called
 	Maze maze;
 	size_t numDims;
-	std::uint32_t* dimensions;
-	double* camera;
-
-	// these are so that one doesn't have to call new and delete each time
-	double* steps;
-	std::int8_t* signs;
-	std::int32_t* currBlock;
-	// location = camera + t * direction
-	double* location;
-	// currBlock + offsets = location
-	double* offsets;
+	DimArray<std::uint32_t, N> dimensions;
+	// same as the maze's, see Maze::getAxisOffset
+	DimArray<size_t, N> brickStrides;
+	DimArray<size_t, N> innerStrides;
+	DimArray<double, N> camera;
+	Acceleration acceleration;
+
+	// everything about where rays start that doesn't depend on which way
+	// they go, worked out by setCamera once for all the rays cast from there
+	struct Origin {
+
+		// the block the camera is in, and camera = block + offsets
+		DimArray<std::int32_t, N> block;
+		DimArray<double, N> offsets;
+		bool isInBounds;
+		// along each axis, how far the camera is below the far face of the
+		// maze and above the near face, which is what intersectMaze needs
+		DimArray<double, N> toFar;
+		DimArray<double, N> toNear;
+
+		explicit Origin(size_t numDims): block(numDims), offsets(numDims),
+				isInBounds(false), toFar(numDims), toNear(numDims) {}
+
+	};
+
+	Origin origin;
+
+	struct Scratch {
+
+		DimArray<double, N> steps;
+		DimArray<std::int8_t, N> signs;
+		DimArray<std::int32_t, N> currBlock;
+		// location = camera + t * direction
+		DimArray<double, N> location;
+		// currBlock + offsets = location
+		DimArray<double, N> offsets;
+
+		Scratch() {}
+
+		explicit Scratch(size_t numDims): steps(numDims), signs(numDims),
+				currBlock(numDims), location(numDims), offsets(numDims) {}
+
+	};
+
+	// this is so that one doesn't have to call new and delete each time.
+	// only used if N is 0; otherwise the scratch is on the stack.
+	mutable Scratch scratch;
 
 public:
-	MazeKernel(const Maze& maze, const double* inCamera): maze(maze, 0) {
-		numDims = maze.getNumDims();
-		dimensions = maze.getDimensions();
-		camera = new double[numDims];
-		setCamera(inCamera);
+	static constexpr size_t maxPacketSize = 16;
 
-		steps = new double[numDims];
-		signs = new std::int8_t[numDims];
-		currBlock = new std::int32_t[numDims];
-		location = new double[numDims];
-		offsets = new double[numDims];
+private:
+	// same as Scratch but for a packet of rays,
+	// laid out so that [i * W + lane] is axis i of ray lane.
+	// Also only used if N is 0, like scratch.
+	struct PacketScratch {
+
+		DimArray<double, N * maxPacketSize> steps;
+		DimArray<double, N * maxPacketSize> signs;
+		DimArray<std::int32_t, N * maxPacketSize> currBlock;
+		DimArray<double, N * maxPacketSize> location;
+		DimArray<double, N * maxPacketSize> offsets;
+		// same as reach in operator()
+		DimArray<double, N * maxPacketSize> reaches;
+		// for pulling a single ray out of the packet
+		DimArray<double, N> lane;
+		DimArray<std::int32_t, N> laneBlock;
+
+		PacketScratch() {}
+
+		explicit PacketScratch(size_t numDims):
+				steps(numDims * maxPacketSize), signs(numDims * maxPacketSize),
+				currBlock(numDims * maxPacketSize),
+				location(numDims * maxPacketSize),
+				offsets(numDims * maxPacketSize),
+				reaches(numDims * maxPacketSize),
+				lane(numDims), laneBlock(numDims) {}
+
+	};
+
+	mutable PacketScratch packetScratch;
+
+	/**
+	 * Same as std::floor, for anything that fits in an int32_t, but
+	 * without the call that std::floor is without SSE4.1, so that
+	 * loops of it can be vectorized.
+	 */
+	static std::int32_t floorToInt(double value) {
+		std::int32_t truncated = static_cast<std::int32_t>(value);
+		return truncated - (value < truncated);
+	}
+
+public:
+	MazeKernel(const Maze& maze, const double* inCamera): maze(maze),
+			numDims(maze.getNumDims()), dimensions(numDims),
+			brickStrides(numDims), innerStrides(numDims),
+			camera(numDims), acceleration(getDefaultAcceleration(maze)),
+			origin(numDims), scratch(N? 0: numDims),
+			packetScratch(N? 0: numDims) {
+		std::uint32_t* dims = maze.getDimensions();
+		std::copy(dims, dims + numDims, dimensions.data());
+		delete[] dims;
+		maze.getLayoutStrides(brickStrides.data(), innerStrides.data());
+		setCamera(inCamera);
 	}
 
 	MazeKernel(MazeKernel& other) = delete;
@@ -50,37 +171,139 @@ public:
 	MazeKernel& operator=(const MazeKernel& other) = delete;
 	MazeKernel& operator=(MazeKernel&& other) = delete;
 
-	~MazeKernel() {
-		maze.invalidate();
-		delete[] dimensions;
-		delete[] camera;
+	size_t getNumDims() const {
+		return N? N: numDims;
+	}
 
-		delete[] steps;
-		delete[] signs;
-		delete[] currBlock;
-		delete[] location;
-		delete[] offsets;
+	/**
+	 * Casts rays through newMaze from now on, with its default
+	 * acceleration. It has to have the same dimensions as the one before.
+	 * Call setCamera again after.
+	 */
+	void setMaze(const Maze& newMaze) {
+		maze = newMaze;
+		maze.getLayoutStrides(brickStrides.data(), innerStrides.data());
+		acceleration = getDefaultAcceleration(maze);
 	}
 
 	void setCamera(const double* newCamera) {
-		std::copy(newCamera, newCamera + maze.getNumDims(), camera);
+		size_t numDims = getNumDims();
+		std::copy(newCamera, newCamera + numDims, camera.data());
+		for (size_t i = 0; i < numDims; i++) {
+			double loc = camera[i];
+			// since blocks are [-0.5, 0.5]
+			double currB = origin.block[i] = std::floor(loc + 0.5);
+			origin.offsets[i] = loc - currB;
+			origin.toFar[i] = dimensions[i] - 0.5 - loc;
+			origin.toNear[i] = 0.5 + loc;
+		}
+		origin.isInBounds = isInBounds(origin.block);
+	}
+
+	/**
+	 * The best thing maze has: the distance field if there is one,
+	 * then the occupancy pyramid, then its chunks, then nothing.
+	 * Past 3D, the pyramid is left for the chunks or nothing, and only
+	 * used if setAcceleration asks for it; maze_acceleration_test
+	 * compares it with plain DDA there.
+	 */
+	static Acceleration getDefaultAcceleration(const Maze& maze) {
+		if (maze.hasDistanceField()) {
+			return Acceleration::DISTANCE_FIELD;
+		}
+		if (maze.getOccupancyPyramid() && (maze.getNumDims() <= 3)) {
+			return Acceleration::OCCUPANCY_PYRAMID;
+		}
+		if (maze.getLayout() == MazeLayout::CHUNKED) {
+			return Acceleration::CHUNKS;
+		}
+		return Acceleration::NONE;
+	}
+
+	Acceleration getAcceleration() const {
+		return acceleration;
+	}
+
+	/**
+	 * Whether maze has what acceleration needs.
+	 */
+	static bool canAccelerate(const Maze& maze, Acceleration acceleration) {
+		switch (acceleration) {
+		case Acceleration::DISTANCE_FIELD:
+			return maze.hasDistanceField();
+		case Acceleration::OCCUPANCY_PYRAMID:
+			return maze.getOccupancyPyramid() != nullptr;
+		case Acceleration::CHUNKS:
+			return maze.getLayout() == MazeLayout::CHUNKED;
+		default:
+			return true;
+		}
+	}
+
+	/**
+	 * Returns false, and changes nothing,
+	 * if the maze doesn't have what newAcceleration needs.
+	 */
+	bool setAcceleration(Acceleration newAcceleration) {
+		if (!canAccelerate(maze, newAcceleration)) {
+			return false;
+		}
+		acceleration = newAcceleration;
+		return true;
 	}
 
 private:
-	bool isInBounds(size_t numDims,
-			const std::int32_t* location,
-			const std::uint32_t* dimensions) const {
-		const std::int32_t* locationEnd = location + numDims;
-		for (; location < locationEnd; ++location, ++dimensions) {
-			if ((*location < 0) ||
-					(*location >= static_cast<std::int32_t>(*dimensions))) {
+	bool isInBounds(const DimArray<std::int32_t, N>& location) const {
+		size_t numDims = getNumDims();
+		for (size_t i = 0; i < numDims; i++) {
+			if ((location[i] < 0) ||
+					(location[i] >= static_cast<std::int32_t>(dimensions[i]))) {
 				return false;
 			}
 		}
 		return true;
 	}
 
-	double intersectMaze(const double* direction, bool* intersects) const {
+	/**
+	 * For the air block at ind (with coordinates block), sets either radius
+	 * to how far every block around it is air, or level to the level of the
+	 * biggest empty cell of the pyramid containing it. The other stays 0.
+	 * An empty brick of a CHUNKED maze is the same box as a cell of level 2.
+	 */
+	void getEmptyBox(size_t ind, const std::int32_t* block,
+			std::int32_t* radius, size_t* level) const {
+		*radius = 0;
+		*level = 0;
+		if (acceleration == Acceleration::DISTANCE_FIELD) {
+			*radius = maze.getEmptyRadius(ind);
+		} else if (acceleration == Acceleration::OCCUPANCY_PYRAMID) {
+			*level = maze.getOccupancyPyramid()->getEmptyLevel(block);
+		} else if ((acceleration == Acceleration::CHUNKS) &&
+				maze.isChunkEmpty(ind)) {
+			*level = 2;
+		}
+	}
+
+	/**
+	 * How far past the center of a block, along an axis heading in direction
+	 * sign, a ray can go before leaving the box getEmptyBox found.
+	 * Only one of radius and level may be nonzero: the two boxes
+	 * can't just be merged axis by axis.
+	 */
+	static double getReach(std::int32_t coord, double sign,
+			std::int32_t radius, size_t level) {
+		std::int32_t mask = (static_cast<std::int32_t>(1) << level) - 1;
+		std::int32_t cellReach = (sign > 0)? mask - (coord & mask): coord & mask;
+		return 0.5 + std::max(radius, cellReach);
+	}
+
+	/**
+	 * How far along a ray from the camera it enters the maze.
+	 * axis is set to the axis of the face through which the ray enters.
+	 */
+	double intersectMaze(const double* direction,
+			bool* intersects, size_t* axis) const {
+		size_t numDims = getNumDims();
 		// check if it intersects the maze at all
 		// using convex object method
 		double lastForwardT = -1000000;
@@ -88,7 +311,7 @@ private:
 		for (size_t i = 0; i < numDims; i++) {
 			// threshold = <normal, some_point_on_plane>
 			// t = (threshold - <camera, normal>) / <ray, normal>
-			double numerator1 = dimensions[i] - 0.5 - location[i];
+			double numerator1 = origin.toFar[i];
 			double diri = direction[i];
 			bool isDiriBelowThreshold = (-1e-6 < diri) && (diri < 1e-6);
 			double t1 = isDiriBelowThreshold?
@@ -98,6 +321,7 @@ private:
 			if (isForward1) {
 				if (t1 > lastForwardT) {
 					lastForwardT = t1;
+					*axis = i;
 				}
 			} else {
 				if (t1 < firstNonForwardT) {
@@ -106,7 +330,7 @@ private:
 			}
 
 
-			double numerator2 = 0.5 + location[i];
+			double numerator2 = origin.toNear[i];
 			double t2 = isDiriBelowThreshold?
 					-1000000: numerator2 / -diri;
 			bool isForward2 = (t2 > 0)?
@@ -114,6 +338,7 @@ private:
 			if (isForward2) {
 				if (t2 > lastForwardT) {
 					lastForwardT = t2;
+					*axis = i;
 				}
 			} else {
 				if (t2 < firstNonForwardT) {
@@ -134,86 +359,96 @@ private:
 	}
 
 public:
-	struct Result {
-
-		double t;
-		// if this is empty, then no intersect.
-		std::vector<std::int32_t> block;
-
-	};
+	typedef RayHit Result;
 
 	/**
-	 * Writes output into output.
+	 * Writes output into output, unless output is nullptr.
+	 * If blockCoords isn't nullptr and something is hit, the coordinates
+	 * of the block hit are written into it (numDims of them).
 	 */
 	Result operator()(std::uint8_t* output,
-			const double* direction, Color backgroundColor) const {
-		double *iter_camera, *iter_steps;
-		std::int8_t* iter_signs;
-		std::int32_t* iter_currBlock;
-		double *iter_location, *iter_offsets;
-		const double *iter_direction, *dir_end = direction + numDims;
-		for (iter_camera = camera, iter_steps = steps, iter_signs = signs,
-				iter_currBlock = currBlock, iter_location = location,
-				iter_offsets = offsets, iter_direction = direction;
-				iter_direction < dir_end;
-				++iter_camera, ++iter_steps, ++iter_signs, ++iter_currBlock,
-				++iter_location, ++iter_offsets, ++iter_direction) {
-			double diri = *iter_direction;
+			const double* direction, Color backgroundColor,
+			std::int32_t* blockCoords = nullptr) const {
+		size_t numDims = getNumDims();
+		// with N fixed, this doesn't allocate, and the compiler
+		// can keep all of it in registers.
+		Scratch local;
+		Scratch& s = N? local: scratch;
+		DimArray<double, N>& steps = s.steps;
+		DimArray<std::int8_t, N>& signs = s.signs;
+		DimArray<std::int32_t, N>& currBlock = s.currBlock;
+		DimArray<double, N>& location = s.location;
+		DimArray<double, N>& offsets = s.offsets;
+		for (size_t i = 0; i < numDims; i++) {
+			double diri = direction[i];
 			double step = ((-1e-6 < diri) && (diri < 1e-6))?
 					-1000000: 1/diri;
 			if (step < 0) {
-				*iter_signs = -1;
-				*iter_steps = -step;
+				signs[i] = -1;
+				steps[i] = -step;
 			} else {
-				*iter_signs = 1;
-				*iter_steps = step;
+				signs[i] = 1;
+				steps[i] = step;
 			}
 
-
-			double loc = *iter_location = *iter_camera;
-			// since blocks are [-0.5, 0.5]
-			double currB = *iter_currBlock = std::floor(loc + 0.5);
-			*iter_offsets = loc - currB;
+			location[i] = camera[i];
+			currBlock[i] = origin.block[i];
+			offsets[i] = origin.offsets[i];
 		}
 		double t = 0;
 		bool intersects = true;
-		if (!isInBounds(numDims, currBlock, dimensions)) {
+		// the axis crossed most recently
+		size_t minStepInd = numDims;
+		if (!origin.isInBounds) {
 			// just for the sake of floating-point imprecision.
-			t = intersectMaze(direction, &intersects) + 1e-6;
+			t = intersectMaze(direction, &intersects, &minStepInd) + 1e-6;
 			if (intersects) {
-				for (iter_currBlock = currBlock,
-						iter_location = location,
-						iter_offsets = offsets,
-						iter_direction = direction;
-						iter_direction < dir_end;
-						++iter_currBlock, ++iter_location,
-						++iter_offsets, ++iter_direction) {
-					double loc = (*iter_location += (*iter_direction) * t);
-					double currB = *iter_currBlock = std::floor(loc + 0.5);
-					*iter_offsets = loc - currB;
+				for (size_t i = 0; i < numDims; i++) {
+					double loc = (location[i] += direction[i] * t);
+					double currB = currBlock[i] = floorToInt(loc + 0.5);
+					offsets[i] = loc - currB;
 				}
 			}
 		}
 
 
 		bool intersectsBlock = false;
+		size_t ind = 0;
+		size_t numSteps = 0;
 		Color result = backgroundColor;
 		if (intersects) {
-			while (isInBounds(numDims, currBlock, dimensions)) {
-				std::uint8_t block = maze.getBlock(currBlock);
-				if (block != 0) {
-					result = Maze::getBlockColor(block, numDims, offsets);
+			while (isInBounds(currBlock)) {
+				ind = 0;
+				for (size_t i = 0; i < numDims; i++) {
+					ind += brickStrides[i] * (currBlock[i] >> 2) +
+							innerStrides[i] * (currBlock[i] & 3);
+				}
+				numSteps++;
+				if (maze.isOccupied(ind)) {
+					if (output) {
+						result = Maze::getBlockColor(maze.getBlock(ind),
+								numDims, offsets.data());
+					}
 					intersectsBlock = true;
 					break;
 				}
 
-				//size_t minStepInd = 0;
-				double minStep = steps[0] * (0.5 - signs[0] * offsets[0]);
+				// every block in a box around this one is air,
+				// so go straight to the edge of that.
+				std::int32_t radius;
+				size_t level;
+				getEmptyBox(ind, currBlock.data(), &radius, &level);
+				minStepInd = 0;
+				double minStep = steps[0] * (
+						getReach(currBlock[0], signs[0], radius, level) -
+						signs[0] * offsets[0]);
 				double currStep;
 				for (size_t i = 1; i < numDims; i++) {
-					currStep = steps[i] * (0.5 - signs[i] * offsets[i]);
+					currStep = steps[i] * (
+							getReach(currBlock[i], signs[i], radius, level) -
+							signs[i] * offsets[i]);
 					if (currStep < minStep) {
-						//minStepInd = i;
+						minStepInd = i;
 						minStep = currStep;
 					}
 				}
@@ -221,32 +456,236 @@ public:
 				minStep += 1e-6;
 				t += minStep;
 				// we can safely assume that we don't have a parallel plane selected
-				for (iter_currBlock = currBlock,
-						iter_location = location,
-						iter_offsets = offsets,
-						iter_direction = direction;
-						iter_direction < dir_end;
-						++iter_currBlock, ++iter_location,
-						++iter_offsets, ++iter_direction) {
-					double loc = (*iter_location += (*iter_direction) * minStep);
-					double currB = *iter_currBlock = std::floor(loc + 0.5);
-					*iter_offsets = loc - currB;
+				for (size_t i = 0; i < numDims; i++) {
+					double loc = (location[i] += direction[i] * minStep);
+					double currB = currBlock[i] = floorToInt(loc + 0.5);
+					offsets[i] = loc - currB;
 				}
 			}
 		}
 
-		*output = result.r; ++output;
-		*output = result.g; ++output;
-		*output = result.b; ++output;
-		*output = result.a;
+		if (output) {
+			*output = result.r; ++output;
+			*output = result.g; ++output;
+			*output = result.b; ++output;
+			*output = result.a;
+		}
 
 		if (intersectsBlock) {
+			if (blockCoords) {
+				std::copy(currBlock.data(), currBlock.data() + numDims,
+						blockCoords);
+			}
 			return Result{
-				t,
-				std::vector<std::int32_t>(currBlock, currBlock + numDims)
+				t, true, ind, minStepInd,
+				static_cast<std::int8_t>(
+						(minStepInd < numDims)? -signs[minStepInd]: 0),
+				numSteps
 			};
 		}
-		return Result{-1000000, std::vector<std::int32_t>()};
+		return Result{-1000000, false, 0, numDims, 0, numSteps};
+	}
+
+	/**
+	 * Traces W rays at once, a lane per ray. directions[i * W + lane] is
+	 * axis i of the direction of ray lane. Writes W pixels into output,
+	 * exactly the same ones W calls to operator() would have written.
+	 */
+	template<size_t W>
+	void trace(std::uint8_t* output, const double* directions,
+			Color backgroundColor) const {
+		static_assert((W > 0) && (W <= maxPacketSize), "bad packet size");
+		size_t numDims = getNumDims();
+		// on the stack, like in operator(), so that the compiler knows
+		// none of these overlap, and can vectorize the loops over them
+		PacketScratch local;
+		PacketScratch& p = N? local: packetScratch;
+		double* steps = p.steps.data();
+		double* signs = p.signs.data();
+		std::int32_t* currBlock = p.currBlock.data();
+		double* location = p.location.data();
+		double* offsets = p.offsets.data();
+		double* reaches = p.reaches.data();
+		DimArray<double, N>& lane = p.lane;
+		DimArray<std::int32_t, N>& laneBlock = p.laneBlock;
+		for (size_t i = 0; i < numDims; i++) {
+			for (size_t l = 0; l < W; l++) {
+				size_t k = i * W + l;
+				double diri = directions[k];
+				double step = ((-1e-6 < diri) && (diri < 1e-6))?
+						-1000000: 1/diri;
+				signs[k] = (step < 0)? -1: 1;
+				steps[k] = (step < 0)? -step: step;
+
+				location[k] = camera[i];
+				currBlock[k] = origin.block[i];
+				offsets[k] = origin.offsets[i];
+			}
+		}
+
+		// 1 if the ray is still going, 0 if it is done
+		double active[W];
+		for (size_t l = 0; l < W; l++) {
+			active[l] = 1;
+		}
+		if (!origin.isInBounds) {
+			for (size_t l = 0; l < W; l++) {
+				for (size_t i = 0; i < numDims; i++) {
+					lane[i] = directions[i * W + l];
+				}
+				bool intersects;
+				size_t axis;
+				double t = intersectMaze(lane.data(), &intersects, &axis) + 1e-6;
+				if (!intersects) {
+					active[l] = 0;
+					continue;
+				}
+				for (size_t i = 0; i < numDims; i++) {
+					size_t k = i * W + l;
+					double loc = (location[k] += directions[k] * t);
+					double currB = currBlock[k] = floorToInt(loc + 0.5);
+					offsets[k] = loc - currB;
+				}
+			}
+		}
+
+		Color results[W];
+		size_t numActive = 0;
+		for (size_t l = 0; l < W; l++) {
+			results[l] = backgroundColor;
+			if (active[l] != 0) {
+				numActive++;
+			}
+		}
+		double minSteps[W];
+		for (size_t k = 0; k < numDims * W; k++) {
+			reaches[k] = 0.5;
+		}
+		size_t inds[W];
+		// 1 if the ray is in the maze, 0 if not, as an integer so that
+		// working it out for every lane at once needs no branches
+		std::int32_t inMaze[W];
+		std::int32_t radii[W];
+		std::int32_t levels[W];
+		while (numActive > 0) {
+			// where every ray is, lane by lane along each axis. This works
+			// it out for the finished rays too, which is less than the
+			// branching it would take not to.
+			for (size_t l = 0; l < W; l++) {
+				inds[l] = 0;
+				inMaze[l] = 1;
+			}
+			for (size_t i = 0; i < numDims; i++) {
+				std::uint32_t dim = dimensions[i];
+				size_t brickStride = brickStrides[i];
+				size_t innerStride = innerStrides[i];
+				const std::int32_t* block = currBlock + i * W;
+				for (size_t l = 0; l < W; l++) {
+					std::int32_t coord = block[l];
+					// negative coordinates wrap around to past dim
+					inMaze[l] &= static_cast<std::uint32_t>(coord) < dim;
+					inds[l] += brickStride * static_cast<size_t>(coord >> 2) +
+							innerStride * static_cast<size_t>(coord & 3);
+				}
+			}
+			// retire the rays that left the maze or hit something.
+			// Looking the blocks up is the only part that goes lane by lane.
+			for (size_t l = 0; l < W; l++) {
+				if (active[l] == 0) {
+					continue;
+				}
+				if (!inMaze[l]) {
+					active[l] = 0;
+					numActive--;
+				} else if (maze.isOccupied(inds[l])) {
+					for (size_t i = 0; i < numDims; i++) {
+						lane[i] = offsets[i * W + l];
+					}
+					results[l] = Maze::getBlockColor(maze.getBlock(inds[l]),
+							numDims, lane.data());
+					active[l] = 0;
+					numActive--;
+				}
+			}
+
+			// how far the rays still going can go, see getEmptyBox and
+			// getReach. Without acceleration, it's always 0.5, as set above.
+			if (acceleration == Acceleration::DISTANCE_FIELD) {
+				for (size_t l = 0; l < W; l++) {
+					radii[l] = (active[l] != 0)? maze.getEmptyRadius(inds[l]): 0;
+				}
+				for (size_t i = 0; i < numDims; i++) {
+					for (size_t l = 0; l < W; l++) {
+						reaches[i * W + l] = 0.5 + radii[l];
+					}
+				}
+			} else if (acceleration != Acceleration::NONE) {
+				for (size_t l = 0; l < W; l++) {
+					levels[l] = 0;
+					if (active[l] == 0) {
+						continue;
+					}
+					if (acceleration == Acceleration::OCCUPANCY_PYRAMID) {
+						for (size_t i = 0; i < numDims; i++) {
+							laneBlock[i] = currBlock[i * W + l];
+						}
+						levels[l] = maze.getOccupancyPyramid()->getEmptyLevel(
+								laneBlock.data());
+					} else if (maze.isChunkEmpty(inds[l])) {
+						levels[l] = 2;
+					}
+				}
+				for (size_t i = 0; i < numDims; i++) {
+					for (size_t l = 0; l < W; l++) {
+						size_t k = i * W + l;
+						std::int32_t mask = (static_cast<std::int32_t>(1) <<
+								levels[l]) - 1;
+						std::int32_t coord = currBlock[k];
+						std::int32_t cellReach = (signs[k] > 0)?
+								mask - (coord & mask): coord & mask;
+						reaches[k] = 0.5 + cellReach;
+					}
+				}
+			}
+
+			for (size_t l = 0; l < W; l++) {
+				minSteps[l] = steps[l] * (reaches[l] - signs[l] * offsets[l]);
+			}
+			for (size_t i = 1; i < numDims; i++) {
+				for (size_t l = 0; l < W; l++) {
+					size_t k = i * W + l;
+					double currStep =
+							steps[k] * (reaches[k] - signs[k] * offsets[k]);
+					minSteps[l] = (currStep < minSteps[l])? currStep: minSteps[l];
+				}
+			}
+			// finished rays step by 0, which leaves them where they were
+			for (size_t l = 0; l < W; l++) {
+				minSteps[l] = (minSteps[l] + 1e-6) * active[l];
+			}
+			for (size_t i = 0; i < numDims; i++) {
+				double* loc = location + i * W;
+				const double* dir = directions + i * W;
+				std::int32_t* block = currBlock + i * W;
+				double* offset = offsets + i * W;
+				for (size_t l = 0; l < W; l++) {
+					loc[l] += dir[l] * minSteps[l];
+				}
+				for (size_t l = 0; l < W; l++) {
+					block[l] = floorToInt(loc[l] + 0.5);
+				}
+				for (size_t l = 0; l < W; l++) {
+					offset[l] = loc[l] - block[l];
+				}
+			}
+		}
+
+		for (size_t l = 0; l < W; l++) {
+			*output = results[l].r; ++output;
+			*output = results[l].g; ++output;
+			*output = results[l].b; ++output;
+			*output = results[l].a; ++output;
+		}
 	}
 
 };
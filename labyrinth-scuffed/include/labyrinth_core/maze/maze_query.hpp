@@ -0,0 +1,341 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_QUERY_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_QUERY_HPP_
+
+#include <labyrinth_core/maze/maze_kernel.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * Asks what is where in a maze, for moving around in it and pointing at
+ * things, rather than rendering it. It keeps one kernel for every ray it
+ * casts, so casting rays and moving don't allocate anything once this has
+ * been made. Not for more than one thread at a time: give each its own.
+ */
+class MazeQuery {
+
+	Maze maze;
+	size_t numDims;
+	std::vector<std::uint32_t> dimensions;
+	MazeKernel<>* kernel;
+	// for move, so that it doesn't allocate:
+	// the blocks the box covers, low[i] to high[i] along axis i
+	std::vector<std::int32_t> low;
+	std::vector<std::int32_t> high;
+	std::vector<std::int32_t> cell;
+	// and for moveSphere, the block it overlaps the most
+	std::vector<std::int32_t> nearest;
+
+	/**
+	 * Whether any block of the layer of the box at coordinate layer along
+	 * axis is occupied. The layer covers low to high along every other axis.
+	 * Blocks outside the maze are air, same as for the rays.
+	 */
+	bool isLayerOccupied(size_t axis, std::int32_t layer) {
+		if ((layer < 0) ||
+				(layer >= static_cast<std::int32_t>(dimensions[axis]))) {
+			return false;
+		}
+		for (size_t i = 0; i < numDims; i++) {
+			if (i == axis) {
+				continue;
+			}
+			std::int32_t lowi = std::max(low[i], static_cast<std::int32_t>(0));
+			std::int32_t highi = std::min(high[i],
+					static_cast<std::int32_t>(dimensions[i]) - 1);
+			if (lowi > highi) {
+				return false;
+			}
+			cell[i] = lowi;
+		}
+		cell[axis] = layer;
+		while (true) {
+			if (maze.isOccupied(maze.getInd(cell.begin()))) {
+				return true;
+			}
+			size_t i = 0;
+			for (; i < numDims; i++) {
+				if (i == axis) {
+					continue;
+				}
+				if (++cell[i] <= std::min(high[i],
+						static_cast<std::int32_t>(dimensions[i]) - 1)) {
+					break;
+				}
+				cell[i] = std::max(low[i], static_cast<std::int32_t>(0));
+			}
+			if (i == numDims) {
+				return false;
+			}
+		}
+	}
+
+	/**
+	 * Moves the box along axis by amount, stopping it just short of the
+	 * first layer of blocks in the way. Returns whether something did.
+	 */
+	bool moveAlong(double* position, size_t axis, double amount,
+			double radius) {
+		// since blocks are [-0.5, 0.5], and the box touching a face
+		// shouldn't count as it being in the block past that face.
+		// it never gets moved back though, if it's already closer.
+		const double gap = 1e-6;
+		if (amount > 0) {
+			double front = position[axis] + radius;
+			std::int32_t end = static_cast<std::int32_t>(
+					std::floor(front + amount + 0.5));
+			for (std::int32_t layer = high[axis] + 1; layer <= end; layer++) {
+				if (isLayerOccupied(axis, layer)) {
+					position[axis] = std::max(position[axis],
+							layer - 0.5 - radius - gap);
+					return true;
+				}
+			}
+		} else if (amount < 0) {
+			double back = position[axis] - radius;
+			std::int32_t end = static_cast<std::int32_t>(
+					std::ceil(back + amount - 0.5));
+			for (std::int32_t layer = low[axis] - 1; layer >= end; layer--) {
+				if (isLayerOccupied(axis, layer)) {
+					position[axis] = std::min(position[axis],
+							layer + 0.5 + radius + gap);
+					return true;
+				}
+			}
+		}
+		position[axis] += amount;
+		return false;
+	}
+
+	void setBox(const double* position, double radius, size_t axis) {
+		low[axis] = static_cast<std::int32_t>(
+				std::floor(position[axis] - radius + 0.5));
+		high[axis] = static_cast<std::int32_t>(
+				std::ceil(position[axis] + radius + 0.5)) - 1;
+	}
+
+	/**
+	 * How far, squared, the center of the sphere is from the nearest point
+	 * of the block at cell, or 0 if it is in the block.
+	 */
+	double getDistanceSquared(const double* position) const {
+		double toreturn = 0;
+		for (size_t i = 0; i < numDims; i++) {
+			double away = position[i] - std::max(cell[i] - 0.5,
+					std::min(cell[i] + 0.5, position[i]));
+			toreturn += away * away;
+		}
+		return toreturn;
+	}
+
+	/**
+	 * Finds the occupied block the sphere overlaps the most, not counting
+	 * any its center is in, and leaves it in nearest. Returns how far the
+	 * center is from it, squared, or radius squared if there is none.
+	 */
+	double findNearest(const double* position, double radius) {
+		double toreturn = radius * radius;
+		for (size_t i = 0; i < numDims; i++) {
+			setBox(position, radius, i);
+			low[i] = std::max(low[i], static_cast<std::int32_t>(0));
+			high[i] = std::min(high[i],
+					static_cast<std::int32_t>(dimensions[i]) - 1);
+			if (low[i] > high[i]) {
+				return toreturn;
+			}
+			cell[i] = low[i];
+		}
+		while (true) {
+			if (maze.isOccupied(maze.getInd(cell.begin()))) {
+				double distanceSquared = getDistanceSquared(position);
+				if ((distanceSquared > 0) && (distanceSquared < toreturn)) {
+					toreturn = distanceSquared;
+					nearest = cell;
+				}
+			}
+			size_t i = 0;
+			for (; i < numDims; i++) {
+				if (++cell[i] <= high[i]) {
+					break;
+				}
+				cell[i] = low[i];
+			}
+			if (i == numDims) {
+				return toreturn;
+			}
+		}
+	}
+
+	/**
+	 * Pushes the sphere out of the occupied blocks it overlaps, the one it
+	 * overlaps the most first, along the line from the nearest point of
+	 * that block to its center. Going by the most first means that in a
+	 * flat wall, it's the block straight ahead that pushes it out, and
+	 * not the ones next to it along their edges, which would push it
+	 * sideways. Returns whether anything pushed it.
+	 */
+	bool pushOut(double* position, double radius) {
+		const double gap = 1e-6;
+		// each push can only leave it touching blocks
+		// on the other sides, so this is plenty
+		for (size_t push = 0; push <= 2 * numDims; push++) {
+			double distanceSquared = findNearest(position, radius);
+			if (distanceSquared >= radius * radius) {
+				return push > 0;
+			}
+			double distance = std::sqrt(distanceSquared);
+			double scale = (radius + gap - distance) / distance;
+			for (size_t i = 0; i < numDims; i++) {
+				double away = position[i] - std::max(nearest[i] - 0.5,
+						std::min(nearest[i] + 0.5, position[i]));
+				position[i] += away * scale;
+			}
+		}
+		return true;
+	}
+
+public:
+	explicit MazeQuery(const Maze& maze): maze(maze),
+			numDims(maze.getNumDims()), dimensions(numDims),
+			low(numDims), high(numDims), cell(numDims), nearest(numDims) {
+		std::uint32_t* dims = maze.getDimensions();
+		std::copy(dims, dims + numDims, dimensions.begin());
+		delete[] dims;
+		std::vector<double> origin (numDims, 0);
+		kernel = new MazeKernel<>(maze, origin.data());
+	}
+
+	MazeQuery(MazeQuery& other) = delete;
+	MazeQuery(const MazeQuery& other) = delete;
+	MazeQuery(MazeQuery&& other) = delete;
+	MazeQuery& operator=(MazeQuery& other) = delete;
+	MazeQuery& operator=(const MazeQuery& other) = delete;
+	MazeQuery& operator=(MazeQuery&& other) = delete;
+
+	~MazeQuery() {
+		delete kernel;
+	}
+
+	size_t getNumDims() const {
+		return numDims;
+	}
+
+	/**
+	 * Asks about newMaze from now on. The kernel only gets made again if
+	 * it has different dimensions from the one before.
+	 */
+	void setMaze(const Maze& newMaze) {
+		maze = newMaze;
+		std::uint32_t* dims = maze.getDimensions();
+		bool isSameSize = (maze.getNumDims() == numDims) &&
+				std::equal(dims, dims + numDims, dimensions.begin());
+		if (isSameSize) {
+			delete[] dims;
+			kernel->setMaze(maze);
+			return;
+		}
+		numDims = maze.getNumDims();
+		dimensions.assign(dims, dims + numDims);
+		delete[] dims;
+		low.resize(numDims);
+		high.resize(numDims);
+		cell.resize(numDims);
+		nearest.resize(numDims);
+		std::vector<double> origin (numDims, 0);
+		delete kernel;
+		kernel = new MazeKernel<>(maze, origin.data());
+	}
+
+	/**
+	 * What a ray from origin heading in direction hits first, the same
+	 * as rendering would find. If blockCoords isn't nullptr and something
+	 * is hit, the coordinates of the block hit are written into it.
+	 */
+	RayHit cast(const double* origin, const double* direction,
+			std::int32_t* blockCoords = nullptr) {
+		kernel->setCamera(origin);
+		return (*kernel)(nullptr, direction, Color{0, 0, 0, 0xFF}, blockCoords);
+	}
+
+	/**
+	 * Casts numRays rays from origin at once. Ray k heads in direction
+	 * directions + k * numDims, and what it hits goes into hits[k], and
+	 * the block it hit (if blockCoords isn't nullptr) into
+	 * blockCoords + k * numDims.
+	 */
+	void cast(const double* origin, const double* directions, size_t numRays,
+			RayHit* hits, std::int32_t* blockCoords = nullptr) {
+		kernel->setCamera(origin);
+		for (size_t k = 0; k < numRays; k++) {
+			hits[k] = (*kernel)(nullptr, directions + k * numDims,
+					Color{0, 0, 0, 0xFF},
+					blockCoords? blockCoords + k * numDims: nullptr);
+		}
+	}
+
+	/**
+	 * Moves a box centered at position, going radius out along every axis,
+	 * by displacement. If a block is in the way along some axis, the box
+	 * stops just short of it along that axis but keeps going along the
+	 * others, so it slides along walls instead of sticking to them.
+	 * Blocks the box is already in don't stop it, so it can't get stuck.
+	 * radius has to be less than 0.5 for the box to fit through corridors.
+	 * Returns whether anything was in the way.
+	 */
+	bool move(double* position, const double* displacement, double radius) {
+		for (size_t i = 0; i < numDims; i++) {
+			setBox(position, radius, i);
+		}
+		bool isBlocked = false;
+		for (size_t i = 0; i < numDims; i++) {
+			isBlocked = moveAlong(position, i, displacement[i], radius) ||
+					isBlocked;
+			setBox(position, radius, i);
+		}
+		return isBlocked;
+	}
+
+	/**
+	 * Moves a sphere centered at position by displacement, sliding along
+	 * whatever is in the way like move does, but rounding corners and
+	 * edges instead of catching on them. It goes at most a quarter of
+	 * radius at a time, pushing itself back out of any block it moved
+	 * into, which leaves whatever of the step runs along the block.
+	 * Blocks its center is already in don't stop it, so it can't get
+	 * stuck. radius has to be more than 0, and less than 0.5 for the
+	 * sphere to fit through corridors.
+	 * Returns whether anything was in the way.
+	 */
+	bool moveSphere(double* position, const double* displacement,
+			double radius) {
+		double lengthSquared = 0;
+		for (size_t i = 0; i < numDims; i++) {
+			lengthSquared += displacement[i] * displacement[i];
+		}
+		size_t numSteps = static_cast<size_t>(
+				std::ceil(std::sqrt(lengthSquared) / (radius / 4)));
+		bool isBlocked = false;
+		for (size_t step = 0; step < numSteps; step++) {
+			for (size_t i = 0; i < numDims; i++) {
+				position[i] += displacement[i] / numSteps;
+			}
+			isBlocked = pushOut(position, radius) || isBlocked;
+		}
+		return isBlocked;
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_MAZE_QUERY_HPP_ */
@@ -0,0 +1,206 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_RANDOM_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_RANDOM_HPP_
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * Where generation gets its random numbers. MT19937 is what it always
+ * used, so seeds give the same mazes they always did. PHILOX works out
+ * the numbers at any position straight from the seed and the position,
+ * so the initial walls can be filled in on lots of threads at once, a
+ * few blocks at a time, but it gives different mazes for the same seed,
+ * and different ones for the ROW_MAJOR and BRICKED layouts, since the
+ * fill goes by where blocks are in memory.
+ */
+enum class RandomEngine {
+	MT19937, PHILOX
+};
+
+/**
+ * Philox4x32-10, by Salmon et al.: each 128-bit counter gets scrambled
+ * with a 64-bit key by 10 rounds of multiplies into 4 random 32-bit words.
+ * Used one number after the other, the counter just counts up. The
+ * numbers at counters with the third word 1 are for blocks, and are never
+ * used one after the other.
+ */
+class Philox {
+
+	static constexpr std::uint32_t mult0 = 0xD2511F53;
+	static constexpr std::uint32_t mult1 = 0xCD9E8D57;
+	static constexpr std::uint32_t weyl0 = 0x9E3779B9;
+	static constexpr std::uint32_t weyl1 = 0xBB67AE85;
+	// counters done at once by generate, so that the rounds vectorize
+	static constexpr size_t numLanes = 8;
+
+	std::uint32_t key[2];
+	std::uint64_t counter;
+	std::uint32_t buffer[4];
+	// how many of buffer are used up
+	size_t numUsed;
+
+public:
+	typedef std::uint32_t result_type;
+
+	/**
+	 * Scrambles ctr in place with key.
+	 */
+	static void scramble(std::uint32_t* ctr, const std::uint32_t* key) {
+		std::uint32_t k0 = key[0], k1 = key[1];
+		for (size_t round = 0; round < 10; round++) {
+			std::uint64_t prod0 = static_cast<std::uint64_t>(mult0) * ctr[0];
+			std::uint64_t prod1 = static_cast<std::uint64_t>(mult1) * ctr[2];
+			std::uint32_t next0 = (prod1 >> 32) ^ ctr[1] ^ k0;
+			std::uint32_t next2 = (prod0 >> 32) ^ ctr[3] ^ k1;
+			ctr[0] = next0;
+			ctr[1] = prod1;
+			ctr[2] = next2;
+			ctr[3] = prod0;
+			k0 += weyl0;
+			k1 += weyl1;
+		}
+	}
+
+	Philox(): key{0, 0}, counter(0), numUsed(4) {}
+
+	/**
+	 * Takes the key from seq, and starts counting from 0 again.
+	 */
+	void seed(std::seed_seq& seq) {
+		seq.generate(key, key + 2);
+		counter = 0;
+		numUsed = 4;
+	}
+
+	static constexpr result_type min() {
+		return 0;
+	}
+
+	static constexpr result_type max() {
+		return 0xFFFFFFFF;
+	}
+
+	result_type operator()() {
+		if (numUsed == 4) {
+			buffer[0] = counter;
+			buffer[1] = counter >> 32;
+			buffer[2] = 0;
+			buffer[3] = 0;
+			scramble(buffer, key);
+			counter++;
+			numUsed = 0;
+		}
+		return buffer[numUsed++];
+	}
+
+	/**
+	 * Writes the 4 words for each block counter from first to
+	 * first + numCounters - 1 into out, in order. Doesn't change what
+	 * operator() gives. The same counter always gives the same words.
+	 */
+	void generate(std::uint64_t first, size_t numCounters,
+			std::uint32_t* out) const {
+		// the words of numLanes counters at once, each word in its own array
+		std::uint32_t c0[numLanes], c1[numLanes], c2[numLanes], c3[numLanes];
+		for (size_t done = 0; done < numCounters; done += numLanes) {
+			for (size_t l = 0; l < numLanes; l++) {
+				c0[l] = first + done + l;
+				c1[l] = (first + done + l) >> 32;
+				c2[l] = 1;
+				c3[l] = 0;
+			}
+			std::uint32_t k0 = key[0], k1 = key[1];
+			for (size_t round = 0; round < 10; round++) {
+				for (size_t l = 0; l < numLanes; l++) {
+					std::uint64_t prod0 = static_cast<std::uint64_t>(mult0) * c0[l];
+					std::uint64_t prod1 = static_cast<std::uint64_t>(mult1) * c2[l];
+					c0[l] = (prod1 >> 32) ^ c1[l] ^ k0;
+					c2[l] = (prod0 >> 32) ^ c3[l] ^ k1;
+					c1[l] = prod1;
+					c3[l] = prod0;
+				}
+				k0 += weyl0;
+				k1 += weyl1;
+			}
+			size_t numLeft = std::min(numLanes, numCounters - done);
+			for (size_t l = 0; l < numLeft; l++) {
+				std::uint32_t* words = out + (done + l) * 4;
+				words[0] = c0[l];
+				words[1] = c1[l];
+				words[2] = c2[l];
+				words[3] = c3[l];
+			}
+		}
+	}
+
+};
+
+/**
+ * Random numbers from whichever RandomEngine, for the standard
+ * distributions. Seeded from the seed and then streams, so that each
+ * thread can get its own numbers by giving its own streams.
+ */
+class MazeRandom {
+
+	RandomEngine engine;
+	std::mt19937 mtrand;
+	Philox philox;
+
+public:
+	typedef std::uint32_t result_type;
+
+	MazeRandom(RandomEngine inEngine, const std::string& seed,
+			const std::vector<std::uint32_t>& streams =
+					std::vector<std::uint32_t>()): engine(inEngine) {
+		std::vector<std::uint32_t> words (seed.begin(), seed.end());
+		words.insert(words.end(), streams.begin(), streams.end());
+		std::seed_seq seq (words.begin(), words.end());
+		if (engine == RandomEngine::PHILOX) {
+			philox.seed(seq);
+		} else {
+			mtrand.seed(seq);
+		}
+	}
+
+	RandomEngine getEngine() const {
+		return engine;
+	}
+
+	static constexpr result_type min() {
+		return 0;
+	}
+
+	static constexpr result_type max() {
+		return 0xFFFFFFFF;
+	}
+
+	result_type operator()() {
+		if (engine == RandomEngine::PHILOX) {
+			return philox();
+		}
+		return mtrand();
+	}
+
+	/**
+	 * The Philox behind this, for blocks. Only random if PHILOX.
+	 */
+	const Philox& getPhilox() const {
+		return philox;
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_MAZE_RANDOM_HPP_ */
@@ -1,12 +1,16 @@
 #ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_RENDERER_HPP_
 #define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_RENDERER_HPP_
 
-#include <labyrinth_core/concurrent_queue.hpp>
+#include <labyrinth_core/dim_array.hpp>
 #include <labyrinth_core/maze/maze_kernel.hpp>
 #include <labyrinth_core/num_threads.hpp>
+#include <labyrinth_core/work_stealing_deque.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -19,103 +23,372 @@ namespace maze {
 
 class MazeRenderer {
 
-	Maze maze;
+public:
+	/**
+	 * What happened while rendering everything
+	 * between two calls of waitForFinished.
+	 */
+	struct FrameStats {
+
+		size_t numTiles;
+		// tiles rendered by a thread other than the one they were given to
+		size_t tilesStolen;
+		// from the first call to render until the last tile was done,
+		// however long after that waitForFinished was called
+		double frameSeconds;
+		// for each thread, how long during the frame it was not rendering
+		std::vector<double> idleSeconds;
+		// from the first change to the maze given to setMaze that this frame
+		// was the first to show until the frame was done, or 0 if it didn't
+		// show anything new
+		double changeSeconds;
+		// the same, but only until the frame started rendering that maze,
+		// which is how long the change waited to be picked up at all
+		double changeStartSeconds;
+		// for each call to render, in order, how long the threads
+		// spent on its tiles, all added up
+		std::vector<double> taskSeconds;
+
+	};
+
+	typedef std::chrono::high_resolution_clock::time_point TimePoint;
+
+	/**
+	 * The dot products of forward, right and up with each other, which is
+	 * all that is needed for the magnitude of forward + r * right + u * up.
+	 */
+	struct Gram {
+
+		double ff, rr, uu, fr, fu, ru;
+
+		Gram() {}
+
+		Gram(size_t numDims, const double* forward,
+				const double* right, const double* up):
+					ff(0), rr(0), uu(0), fr(0), fu(0), ru(0) {
+			for (size_t i = 0; i < numDims; i++) {
+				ff += forward[i] * forward[i];
+				rr += right[i] * right[i];
+				uu += up[i] * up[i];
+				fr += forward[i] * right[i];
+				fu += forward[i] * up[i];
+				ru += right[i] * up[i];
+			}
+		}
+
+	};
+
+	// how many calls to render a frame can have. Past that, render waits
+	// for the frame to finish, and starts another.
+	static constexpr size_t maxTasksPerFrame = 64;
+
+private:
+	size_t numDims;
+	// what frames get rendered from, only changed when a frame starts, and
+	// a copy, so that changing the maze it came from doesn't change frames
+	mutable std::shared_ptr<const Maze> maze;
+	// from setMaze, for the next frame, or nullptr
+	mutable std::shared_ptr<const Maze> nextMaze;
+	TimePoint nextChangedAt;
 	double* camera;
+	size_t packetSize;
+	size_t tileSize;
+	mutable Acceleration acceleration;
 
 	std::vector<std::thread> threads;
 
 	struct Task {
 
-		bool isDeath;
+		// different for every call to render, unlike where the task is
+		size_t id;
+		// kept alive by this until the frame is done
+		std::shared_ptr<const Maze> maze;
 		std::uint8_t* output;
-		const double* forward;
-		const double* right;
-		const double* up;
+		// copied here by render, so that whatever they were copied from can
+		// change while the frame renders. Each task has its own place in
+		// views for them, so these pointers themselves never change.
+		double* camera;
+		double* forward;
+		double* right;
+		double* up;
 		size_t width;
 		size_t height;
-		// this task is all rows for which row % numThreads = modulo
-		size_t modulo;
 		double xscale;
 		double yscale;
+		// r for each column and u for each row, as in getDirection. These
+		// are kept from frame to frame, as only the orientation changes
+		// usually, and only worked out again if the width, height or scales
+		// change, which is what they come from.
+		std::vector<double> rcomponents;
+		std::vector<double> ucomponents;
+		Gram gram;
 		Color backgroundColor;
+		// number of rays traced together; 1 is one at a time.
+		size_t packetSize;
+		size_t tileSize;
+		Acceleration acceleration;
+		// how long its tiles took, added to by whichever threads render them
+		mutable std::atomic<std::uint64_t> busyNanos;
 
 	};
 
+	struct Tile {
+
+		const Task* task;
+		// top left corner
+		size_t row;
+		size_t col;
+
+	};
+
+	struct Worker {
+
+		multithread::WorkStealingDeque<Tile> tiles;
+		// these are for the frame stats, and get reset every frame
+		std::atomic<std::uint64_t> busyNanos;
+		std::atomic<size_t> tilesStolen;
+
+	};
+
+	// the tasks of the frame going on, the first numTasks of them.
+	// made once, so that starting a frame doesn't allocate anything.
+	Task* tasks;
+	mutable size_t numTasks;
+	// the id of the last task
+	mutable size_t lastTaskId;
+	// the camera, forward, right and up of each task, one after the other
+	double* views;
+	Worker* workers;
+	// tiles not finished yet
 	mutable size_t taskCount;
 	mutable std::mutex taskMutex;
 	mutable std::condition_variable taskVar;
-	mutable multithread::ConcurrentQueue<Task> taskQueue;
+	// bumped every time tiles are added, so idle workers know to look again
+	mutable size_t workEpoch;
+	mutable bool isDying;
+	mutable std::condition_variable workVar;
+
+	mutable bool isFrameStarted;
+	mutable std::chrono::time_point<
+	std::chrono::high_resolution_clock> frameStart;
+	// when the last tile so far was done
+	mutable TimePoint frameEnd;
+	// whether the frame going on is the first with maze, and if so,
+	// when the first change it shows was made
+	mutable bool isFrameChanged;
+	mutable TimePoint frameChangedAt;
+	mutable FrameStats lastFrameStats;
+
+	/**
+	 * The direction of the ray through pixel (col, row) of task.
+	 */
+	static void getDirection(const Task& task, size_t numDims,
+			size_t col, size_t row, double* direction, size_t stride) {
+		getDirection(numDims, task.forward, task.right, task.up, task.gram,
+				task.rcomponents[col], task.ucomponents[row],
+				direction, stride);
+	}
+
+	/**
+	 * Works out the rcomponents and ucomponents of task again,
+	 * if they aren't for width, height, xscale and yscale already.
+	 */
+	static void setComponents(Task& task, size_t width, size_t height,
+			double xscale, double yscale) {
+		if ((task.rcomponents.size() == width) &&
+				(task.ucomponents.size() == height) &&
+				(task.xscale == xscale) && (task.yscale == yscale)) {
+			return;
+		}
+		task.rcomponents.resize(width);
+		for (size_t col = 0; col < width; col++) {
+			task.rcomponents[col] = (col - width/2.0) * xscale;
+		}
+		task.ucomponents.resize(height);
+		for (size_t row = 0; row < height; row++) {
+			task.ucomponents[row] = (height/2.0 - row) * yscale;
+		}
+	}
+
+	/**
+	 * Renders columns [col, colEnd) of a row, W pixels at a time.
+	 * The leftover at the end (and everything, if W is 1)
+	 * is done one ray at a time.
+	 */
+	template<size_t N, size_t W>
+	static void renderRow(const MazeKernel<N>& kernel, const Task& task,
+			size_t row, size_t col, size_t colEnd, double* directions) {
+		size_t numDims = kernel.getNumDims();
+		std::uint8_t* output = task.output + (row * task.width + col) * 4;
+		if (W > 1) {
+			for (; col + W <= colEnd; col += W) {
+				for (size_t l = 0; l < W; l++) {
+					getDirection(task, numDims, col + l, row, directions + l, W);
+				}
+				kernel.template trace<W>(output, directions,
+						task.backgroundColor);
+				output += 4 * W;
+			}
+		}
+		for (; col < colEnd; col++) {
+			getDirection(task, numDims, col, row, directions, 1);
+			kernel(output, directions, task.backgroundColor);
+			output += 4;
+		}
+	}
+
+	template<size_t N>
+	static void renderTile(const MazeKernel<N>& kernel, const Tile& tile,
+			double* directions) {
+		const Task& task = *tile.task;
+		size_t rowEnd = std::min(tile.row + task.tileSize, task.height);
+		size_t colEnd = std::min(tile.col + task.tileSize, task.width);
+		for (size_t row = tile.row; row < rowEnd; row++) {
+			switch (task.packetSize) {
+			case 4:
+				renderRow<N, 4>(kernel, task, row, tile.col, colEnd, directions);
+				break;
+			case 8:
+				renderRow<N, 8>(kernel, task, row, tile.col, colEnd, directions);
+				break;
+			case 16:
+				renderRow<N, 16>(kernel, task, row, tile.col, colEnd, directions);
+				break;
+			default:
+				renderRow<N, 1>(kernel, task, row, tile.col, colEnd, directions);
+				break;
+			}
+		}
+	}
+
+	/**
+	 * Takes from the worker's own deque,
+	 * or failing that, steals from the others.
+	 */
+	bool getTile(size_t index, Tile& tile) const {
+		if (workers[index].tiles.pop(tile)) {
+			return true;
+		}
+		size_t numThreads = threads.size();
+		for (size_t i = 1; i < numThreads; i++) {
+			if (workers[(index + i) % numThreads].tiles.steal(tile)) {
+				workers[index].tilesStolen++;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template<size_t N>
+	void work(size_t index) {
+		// made from the maze of the task being rendered, and kept from
+		// frame to frame until the maze changes. Holding on to kernelMaze
+		// keeps it alive for the kernel, and means no other maze can turn
+		// up at the same address while it's still being compared against.
+		MazeKernel<N>* kernel = nullptr;
+		std::shared_ptr<const Maze> kernelMaze;
+		// the id of the task the kernel was last set up for, as setting the
+		// camera works out everything about where the rays start, once
+		// for all of them. 0 is none.
+		size_t kernelTaskId = 0;
+		DimArray<double, N * MazeKernel<N>::maxPacketSize> directions (
+				numDims * MazeKernel<N>::maxPacketSize);
+		Worker& worker = workers[index];
+		while (true) {
+			std::unique_lock<std::mutex> lock (taskMutex);
+			if (isDying) {
+				break;
+			}
+			size_t epoch = workEpoch;
+			lock.unlock();
+
+			Tile tile;
+			while (getTile(index, tile)) {
+				auto start = std::chrono::high_resolution_clock::now();
+				if (kernelMaze != tile.task->maze) {
+					delete kernel;
+					kernelMaze = tile.task->maze;
+					kernel = new MazeKernel<N>(*kernelMaze, tile.task->camera);
+					kernelTaskId = 0;
+				}
+				if (kernelTaskId != tile.task->id) {
+					kernelTaskId = tile.task->id;
+					kernel->setCamera(tile.task->camera);
+					kernel->setAcceleration(tile.task->acceleration);
+				}
+				renderTile(*kernel, tile, directions.data());
+				TimePoint end = std::chrono::high_resolution_clock::now();
+				std::uint64_t nanos = std::chrono::duration_cast<
+						std::chrono::nanoseconds>(end - start).count();
+				worker.busyNanos += nanos;
+				tile.task->busyNanos += nanos;
+				lock.lock();
+				taskCount--;
+				bool isFinished = taskCount == 0;
+				if (isFinished) {
+					frameEnd = end;
+				}
+				lock.unlock();
+				if (isFinished) taskVar.notify_all();
+			}
+			lock.lock();
+			workVar.wait(lock, [this, epoch] () -> bool {
+				return isDying || (workEpoch != epoch);
+			});
+		}
+		delete kernel;
+	}
 
 public:
 	MazeRenderer(const Maze& inMaze, const double* inCamera,
-			size_t numThreads): maze(inMaze, 0) {
-		size_t numDims = maze.getNumDims();
+			size_t numThreads): numDims(inMaze.getNumDims()),
+					maze(std::make_shared<const Maze>(inMaze)) {
 		camera = new double[numDims];
 		setCamera(inCamera);
+		tasks = new Task[maxTasksPerFrame];
+		numTasks = 0;
+		lastTaskId = 0;
+		views = new double[maxTasksPerFrame * 4 * numDims];
+		for (size_t k = 0; k < maxTasksPerFrame; k++) {
+			double* view = views + k * 4 * numDims;
+			tasks[k].camera = view;
+			tasks[k].forward = view + numDims;
+			tasks[k].right = view + 2 * numDims;
+			tasks[k].up = view + 3 * numDims;
+			tasks[k].xscale = 0;
+			tasks[k].yscale = 0;
+		}
+		packetSize = 1;
+		tileSize = 32;
+		acceleration = MazeKernel<>::getDefaultAcceleration(inMaze);
+		if (numThreads < 1) {
+			numThreads = 1;
+		}
+		workers = new Worker[numThreads];
+		for (size_t i = 0; i < numThreads; i++) {
+			workers[i].busyNanos = 0;
+			workers[i].tilesStolen = 0;
+		}
 		taskCount = 0;
+		workEpoch = 0;
+		isDying = false;
+		isFrameStarted = false;
+		isFrameChanged = false;
+		lastFrameStats = FrameStats{0, 0, 0, std::vector<double>(numThreads), 0, 0,
+				std::vector<double>()};
 		for (size_t i = 0; i < numThreads; i++) {
 			threads.push_back(std::thread(
-					[this, numThreads, numDims, i] () -> void {
-				MazeKernel kernel (maze, camera);
-				double* tmpdirection = new double[numDims];
-				double* tmpdirection_end = tmpdirection + numDims;
-				double* iter_tmpdir;
-				while (true) {
-					Task task = taskQueue.pop();
-					if (task.isDeath) {
-						delete[] tmpdirection;
-						break;
-					}
-					kernel.setCamera(camera);
-					size_t width = task.width;
-					size_t height = task.height;
-					double xscale = task.xscale;
-					double yscale = task.yscale;
-					double magnitude;
-					double rcomponent, ucomponent;
-					const double* forward = task.forward;
-					const double* iter_forward;
-					const double* right = task.right;
-					const double* iter_right;
-					const double* up = task.up;
-					const double* iter_up;
-					std::uint8_t* output_iter =
-							task.output + task.modulo * width * 4;
-					for (size_t row = task.modulo;
-							row < task.height; row += numThreads) {
-						for (size_t col = 0; col < task.width; col++) {
-							magnitude = 0;
-							rcomponent = (col - width/2.0) * xscale;
-							ucomponent = (height/2.0 - row) * yscale;
-							iter_tmpdir = tmpdirection;
-							iter_forward = forward;
-							iter_right = right;
-							iter_up = up;
-							// just a loop
-							for (iter_tmpdir = tmpdirection;
-									iter_tmpdir < tmpdirection_end;
-									++iter_tmpdir, ++iter_forward,
-									++iter_right, ++iter_up) {
-								double value = *iter_tmpdir = (*iter_forward) +
-										rcomponent * (*iter_right) +
-										ucomponent * (*iter_up);
-								magnitude += value * value;
-							}
-							magnitude = std::sqrt(magnitude);
-							for (iter_tmpdir = tmpdirection;
-									iter_tmpdir < tmpdirection_end; ++iter_tmpdir) {
-								*iter_tmpdir /= magnitude;
-							}
-
-							kernel(output_iter, tmpdirection, task.backgroundColor);
-							output_iter += 4;
-						}
-						output_iter += width * (numThreads - 1) * 4;
-					}
-					std::unique_lock<std::mutex> lock (taskMutex);
-					taskCount--;
-					lock.unlock();
-					if (taskCount == 0) taskVar.notify_one();
+					[this, i] () -> void {
+				// the common cases get a kernel with the loops unrolled
+				switch (numDims) {
+				case 2: work<2>(i); break;
+				case 3: work<3>(i); break;
+				case 4: work<4>(i); break;
+				case 5: work<5>(i); break;
+				case 6: work<6>(i); break;
+				case 7: work<7>(i); break;
+				case 8: work<8>(i); break;
+				default: work<0>(i); break;
 				}
 			}));
 		}
@@ -129,54 +402,303 @@ public:
 	MazeRenderer& operator=(MazeRenderer&& other) = delete;
 
 	~MazeRenderer() {
-		maze.invalidate();
-		for (size_t i = 0; i < threads.size(); i++) {
-			taskQueue.push(Task{
-				true, nullptr, nullptr, nullptr, nullptr,
-				0, 0, 0, 0.0, 0.0, Color{0, 0, 0, 0}
-			});
-		}
+		std::unique_lock<std::mutex> lock (taskMutex);
+		isDying = true;
+		lock.unlock();
+		workVar.notify_all();
 		for (std::thread& thread: threads) {
 			thread.join();
 		}
+		delete[] workers;
+		delete[] tasks;
+		delete[] views;
 		delete[] camera;
 	}
 
+	/**
+	 * Takes effect on the next call to render. Frames
+	 * going on keep the camera they were given.
+	 */
 	void setCamera(const double* newCamera) {
-		std::copy(newCamera, newCamera + maze.getNumDims(), camera);
+		std::copy(newCamera, newCamera + numDims, camera);
+	}
+
+	/**
+	 * Renders newMaze from the next frame on, which starts with the first
+	 * call to render after waitForFinished, while frames already going on
+	 * keep the maze they started with. newMaze must be the same size as the
+	 * maze this was made with, and be copied on the thread changing it,
+	 * which this does, and is all that it locks for; rendering never waits
+	 * for it. changedAt is when the first change that newMaze has, and the
+	 * maze last given to this doesn't, was made, for the frame stats.
+	 * If newMaze doesn't have what the acceleration needs, the acceleration
+	 * goes back to MazeKernel::getDefaultAcceleration of it.
+	 */
+	void setMaze(const Maze& newMaze, TimePoint changedAt =
+			std::chrono::high_resolution_clock::now()) {
+		std::shared_ptr<const Maze> newShared =
+				std::make_shared<const Maze>(newMaze);
+		std::lock_guard<std::mutex> lock (taskMutex);
+		if (!nextMaze) {
+			nextChangedAt = changedAt;
+		}
+		nextMaze = newShared;
+	}
+
+	size_t getPacketSize() const {
+		return packetSize;
+	}
+
+	/**
+	 * Sets how many neighbouring rays of a row are traced together.
+	 * Must be 1 (one at a time), 4, 8 or 16, in any number of dimensions.
+	 * Only the stepping gets vectorized; looking up the blocks still goes
+	 * lane by lane, so packets come out about as fast as one at a time in
+	 * a small maze, and help more the longer the rays go through air.
+	 * Takes effect on the next call to render.
+	 */
+	bool setPacketSize(size_t newPacketSize) {
+		switch (newPacketSize) {
+		case 1:
+		case 4:
+		case 8:
+		case 16:
+			packetSize = newPacketSize;
+			return true;
+		}
+		return false;
+	}
+
+	size_t getTileSize() const {
+		return tileSize;
+	}
+
+	/**
+	 * Sets the width and height of the square tiles the slices are cut into.
+	 * Takes effect on the next call to render.
+	 */
+	bool setTileSize(size_t newTileSize) {
+		if ((newTileSize < 4) || (newTileSize > 1024)) {
+			return false;
+		}
+		tileSize = newTileSize;
+		return true;
 	}
 
+	Acceleration getAcceleration() const {
+		return acceleration;
+	}
+
+	/**
+	 * Sets what the kernels use to skip over air. The default is
+	 * MazeKernel::getDefaultAcceleration of the maze when this was made.
+	 * Returns false if the maze doesn't have what it needs.
+	 * Takes effect on the next call to render.
+	 */
+	bool setAcceleration(Acceleration newAcceleration) {
+		std::lock_guard<std::mutex> lock (taskMutex);
+		if (!MazeKernel<>::canAccelerate(nextMaze? *nextMaze: *maze,
+				newAcceleration)) {
+			return false;
+		}
+		acceleration = newAcceleration;
+		return true;
+	}
+
+private:
+	/**
+	 * Switches to the maze from setMaze, if there is one.
+	 * Only for render, with taskMutex locked.
+	 */
+	void startFrame() const {
+		if (!nextMaze) {
+			return;
+		}
+		maze = nextMaze;
+		nextMaze = nullptr;
+		isFrameChanged = true;
+		frameChangedAt = nextChangedAt;
+		if (!MazeKernel<>::canAccelerate(*maze, acceleration)) {
+			acceleration = MazeKernel<>::getDefaultAcceleration(*maze);
+		}
+	}
+
+public:
+	/**
+	 * Whether everything given to render so far is done, without waiting
+	 * for it. If so, waitForFinished won't wait either.
+	 */
+	bool isFinished() const {
+		std::lock_guard<std::mutex> lock (taskMutex);
+		return taskCount == 0;
+	}
+
+	/**
+	 * Also finishes off the frame stats.
+	 */
 	void waitForFinished() const {
 		std::unique_lock<std::mutex> lock (taskMutex);
 		taskVar.wait(lock, [this] () -> bool {
 			return taskCount == 0;
 		});
+		if (!isFrameStarted) {
+			return;
+		}
+		isFrameStarted = false;
+		lastFrameStats.taskSeconds.resize(numTasks);
+		for (size_t k = 0; k < numTasks; k++) {
+			tasks[k].maze = nullptr;
+			lastFrameStats.taskSeconds[k] = tasks[k].busyNanos / 1e+9;
+		}
+		numTasks = 0;
+		lastFrameStats.frameSeconds = std::chrono::duration_cast<
+				std::chrono::duration<double>>(frameEnd - frameStart).count();
+		lastFrameStats.changeSeconds = 0;
+		lastFrameStats.changeStartSeconds = 0;
+		if (isFrameChanged) {
+			isFrameChanged = false;
+			lastFrameStats.changeSeconds = std::chrono::duration_cast<
+					std::chrono::duration<double>>(frameEnd - frameChangedAt).count();
+			lastFrameStats.changeStartSeconds = std::chrono::duration_cast<
+					std::chrono::duration<double>>(frameStart - frameChangedAt).count();
+		}
+		lastFrameStats.tilesStolen = 0;
+		for (size_t i = 0; i < threads.size(); i++) {
+			lastFrameStats.tilesStolen += workers[i].tilesStolen.exchange(0);
+			double busySeconds = workers[i].busyNanos.exchange(0) / 1e+9;
+			lastFrameStats.idleSeconds[i] =
+					std::max(0.0, lastFrameStats.frameSeconds - busySeconds);
+		}
 	}
 
-	void render(std::uint8_t* output, const double* forward,
-			const double* right, const double* up,
-			size_t width, size_t height, double aspect, double fov) const {
+	/**
+	 * The stats of the frame most recently finished by waitForFinished.
+	 */
+	FrameStats getLastFrameStats() const {
+		std::lock_guard<std::mutex> lock (taskMutex);
+		return lastFrameStats;
+	}
+
+	/**
+	 * How far right and up, per pixel, render spreads the rays of
+	 * a width by height picture.
+	 */
+	static void getScales(size_t width, size_t height, double aspect,
+			double fov, double* xscale, double* yscale) {
 		// 0.00872664625997164788462 = 0.5 * PI / 180
 		double tanFov = std::tan(fov * 0.00872664625997164788462);
-		double xscale, yscale;
 		if (aspect > 1) {
-			xscale = 2 * tanFov / width;
-			yscale = 2 * tanFov / (height * aspect);
+			*xscale = 2 * tanFov / width;
+			*yscale = 2 * tanFov / (height * aspect);
 		} else {
-			xscale = 2 * tanFov * aspect / width;
-			yscale = 2 * tanFov / height;
+			*xscale = 2 * tanFov * aspect / width;
+			*yscale = 2 * tanFov / height;
 		}
+	}
+
+	/**
+	 * Writes the normalized direction of forward + rcomponent * right +
+	 * ucomponent * up into direction, putting axis i at direction[i * stride].
+	 * The magnitude comes from gram, so the only loop over the axes is the
+	 * one writing direction, a multiply-add or two and a multiply for each.
+	 */
+	static void getDirection(size_t numDims, const double* forward,
+			const double* right, const double* up, const Gram& gram,
+			double rcomponent, double ucomponent,
+			double* direction, size_t stride) {
+		double squared = gram.ff +
+				rcomponent * (2 * gram.fr + rcomponent * gram.rr) +
+				ucomponent * (2 * gram.fu + ucomponent * gram.uu +
+						2 * rcomponent * gram.ru);
+		double scale = 1 / std::sqrt(squared);
+		for (size_t i = 0; i < numDims; i++) {
+			direction[i * stride] = (forward[i] + rcomponent * right[i] +
+					ucomponent * up[i]) * scale;
+		}
+	}
+
+	/**
+	 * Writes the normalized direction of the ray render would cast
+	 * through pixel (col, row), given the same arguments, into direction.
+	 */
+	static void getPixelDirection(size_t numDims, const double* forward,
+			const double* right, const double* up,
+			size_t width, size_t height, double aspect, double fov,
+			size_t col, size_t row, double* direction) {
+		double xscale, yscale;
+		getScales(width, height, aspect, fov, &xscale, &yscale);
+		getDirection(numDims, forward, right, up,
+				Gram(numDims, forward, right, up),
+				(col - width/2.0) * xscale, (height/2.0 - row) * yscale,
+				direction, 1);
+	}
+
+	/**
+	 * Starts rendering a slice of the frame. The camera, forward, right and
+	 * up are copied, and can be changed as soon as this returns, but output
+	 * has to stay around until waitForFinished.
+	 */
+	void render(std::uint8_t* output, const double* forward,
+			const double* right, const double* up,
+			size_t width, size_t height, double aspect, double fov) const {
+		double xscale, yscale;
+		getScales(width, height, aspect, fov, &xscale, &yscale);
 
 		Color backgroundColor {0, 0, 0, 0xFF};
 
-		for (size_t i = 0; i < threads.size(); i++) {
-			std::lock_guard<std::mutex> lock (taskMutex);
-			taskCount++;
-			taskQueue.push(Task{
-				false, output, forward, right, up,
-				width, height, i, xscale, yscale, backgroundColor
+		std::unique_lock<std::mutex> lock (taskMutex);
+		if (numTasks == maxTasksPerFrame) {
+			lock.unlock();
+			waitForFinished();
+			lock.lock();
+		}
+		if (!isFrameStarted) {
+			isFrameStarted = true;
+			frameStart = std::chrono::high_resolution_clock::now();
+			frameEnd = frameStart;
+			lastFrameStats.numTiles = 0;
+			startFrame();
+		}
+		// nothing reads this one until its tiles are given out
+		Task& newTask = tasks[numTasks++];
+		newTask.id = ++lastTaskId;
+		newTask.maze = maze;
+		newTask.output = output;
+		std::copy(camera, camera + numDims, newTask.camera);
+		std::copy(forward, forward + numDims, newTask.forward);
+		std::copy(right, right + numDims, newTask.right);
+		std::copy(up, up + numDims, newTask.up);
+		setComponents(newTask, width, height, xscale, yscale);
+		newTask.gram = Gram(numDims, forward, right, up);
+		newTask.width = width;
+		newTask.height = height;
+		newTask.xscale = xscale;
+		newTask.yscale = yscale;
+		newTask.backgroundColor = backgroundColor;
+		newTask.packetSize = packetSize;
+		newTask.tileSize = tileSize;
+		newTask.acceleration = acceleration;
+		newTask.busyNanos = 0;
+		const Task* task = &newTask;
+		size_t tilesDown = (height + tileSize - 1) / tileSize;
+		size_t tilesAcross = (width + tileSize - 1) / tileSize;
+		size_t numTiles = tilesDown * tilesAcross;
+		taskCount += numTiles;
+		lastFrameStats.numTiles += numTiles;
+		lock.unlock();
+
+		// each thread starts off with a contiguous run of tiles
+		size_t numThreads = threads.size();
+		for (size_t i = 0; i < numTiles; i++) {
+			workers[i * numThreads / numTiles].tiles.push(Tile{
+				task, (i / tilesAcross) * tileSize, (i % tilesAcross) * tileSize
 			});
 		}
+
+		lock.lock();
+		workEpoch++;
+		lock.unlock();
+		workVar.notify_all();
 	}
 
 };
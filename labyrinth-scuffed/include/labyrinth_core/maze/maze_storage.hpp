@@ -0,0 +1,674 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_STORAGE_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_STORAGE_HPP_
+
+#include <algorithm>
+#include <atomic>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/mman.h>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * How many bits each block takes up. BYTE can hold any block. NIBBLE and
+ * TRIBIT hold an index into a palette of up to 16 or 8 different blocks,
+ * which is plenty for generated mazes, as those only use blocks 0 to 7.
+ */
+enum class StorageMode {
+	BYTE, NIBBLE, TRIBIT
+};
+
+/**
+ * The blocks of a maze, packed according to a StorageMode, along with a
+ * separate bit for each block saying whether it is anything but air,
+ * which is all that rays need until they hit something.
+ * The blocks can also be split up into chunks, each either allocated on
+ * its own, or, if every block in it is the same, stored as just that block.
+ * Blocks that share a word, or a chunk if there are chunks, can't be set
+ * from different threads at once.
+ * With chunks, share makes a copy that shares the chunks with this, and
+ * whichever of them changes a chunk first copies just that chunk then.
+ */
+class MazeStorage {
+
+	friend class MazeFile;
+
+	StorageMode mode;
+	size_t length;
+	std::uint64_t* words;
+	std::uint64_t* occupancy;
+	// palette[code] is the block a code stands for, and codes[block] is the
+	// code of a block, or noCode. Code 0 is always air.
+	// In BYTE mode, codes are just the blocks themselves.
+	std::uint8_t palette[256];
+	std::uint16_t codes[256];
+	size_t paletteSize;
+	// if this isn't nullptr, occupancy, and words unless setMode replaced
+	// it, point into this, which came from mmap.
+	void* mapping;
+	size_t mappingLength;
+	bool isWordsMapped;
+	// if chunkLength isn't 0, the blocks are split up into chunks of
+	// chunkLength blocks, and words and occupancy aren't used. chunkWords[c]
+	// and chunkOccupancy[c] are those of chunk c, with chunkCounts[c] blocks
+	// that aren't air, or nullptr if every block of it is chunkTags[c].
+	// Every block, even the ones that are only tags, has a code.
+	size_t chunkLength;
+	size_t chunkShift;
+	size_t numChunks;
+	std::uint64_t** chunkWords;
+	std::uint64_t** chunkOccupancy;
+	std::uint32_t* chunkCounts;
+	std::uint8_t* chunkTags;
+	// chunkShares[c] counts the storages that chunkWords[c] and
+	// chunkOccupancy[c] are shared by, since share, or is nullptr if they
+	// only ever belonged to this. Whichever storage takes it to 0 frees them.
+	std::atomic<std::uint32_t>** chunkShares;
+
+	static constexpr std::uint16_t noCode = 256;
+
+public:
+	/**
+	 * Ranges of blocks that start at multiples of this don't share any
+	 * words, whatever the mode: 64 occupancy bits, 8 bytes, 16 nibbles or
+	 * 21 tribits to a word.
+	 */
+	static constexpr size_t rangeAlignment = 64 * 21;
+
+private:
+
+	static size_t getPaletteCapacity(StorageMode mode) {
+		switch (mode) {
+		case StorageMode::NIBBLE:
+			return 16;
+		case StorageMode::TRIBIT:
+			return 8;
+		default:
+			return 256;
+		}
+	}
+
+	static size_t getNumWords(StorageMode mode, size_t length) {
+		switch (mode) {
+		case StorageMode::NIBBLE:
+			return (length + 15) / 16;
+		case StorageMode::TRIBIT:
+			// 21 blocks to a word, with a bit left over
+			return (length + 20) / 21;
+		default:
+			return (length + 7) / 8;
+		}
+	}
+
+	static std::uint8_t getCode(const std::uint64_t* words,
+			StorageMode mode, size_t ind) {
+		switch (mode) {
+		case StorageMode::NIBBLE:
+			return (words[ind >> 4] >> ((ind & 15) << 2)) & 15;
+		case StorageMode::TRIBIT:
+			return (words[ind / 21] >> ((ind % 21) * 3)) & 7;
+		default:
+			return reinterpret_cast<const std::uint8_t*>(words)[ind];
+		}
+	}
+
+	static void setCode(std::uint64_t* words,
+			StorageMode mode, size_t ind, std::uint8_t code) {
+		std::uint64_t* word;
+		size_t shift;
+		std::uint64_t mask;
+		switch (mode) {
+		case StorageMode::NIBBLE:
+			word = words + (ind >> 4);
+			shift = (ind & 15) << 2;
+			mask = 15;
+			break;
+		case StorageMode::TRIBIT:
+			word = words + ind / 21;
+			shift = (ind % 21) * 3;
+			mask = 7;
+			break;
+		default:
+			reinterpret_cast<std::uint8_t*>(words)[ind] = code;
+			return;
+		}
+		*word = (*word & ~(mask << shift)) |
+				(static_cast<std::uint64_t>(code) << shift);
+	}
+
+	static bool getBit(const std::uint64_t* bits, size_t ind) {
+		return (bits[ind >> 6] >> (ind & 63)) & 1;
+	}
+
+	static void setBit(std::uint64_t* bits, size_t ind, bool value) {
+		if (value) {
+			bits[ind >> 6] |= static_cast<std::uint64_t>(1) << (ind & 63);
+		} else {
+			bits[ind >> 6] &= ~(static_cast<std::uint64_t>(1) << (ind & 63));
+		}
+	}
+
+	/**
+	 * Returns the first numBlocks blocks of oldWords, which are packed
+	 * according to oldMode, packed according to mode.
+	 */
+	std::uint64_t* repack(const std::uint64_t* oldWords, size_t numBlocks,
+			StorageMode oldMode) const {
+		std::uint64_t* toreturn =
+				new std::uint64_t[getNumWords(mode, numBlocks)]();
+		for (size_t ind = 0; ind < numBlocks; ind++) {
+			std::uint8_t code = getCode(oldWords, oldMode, ind);
+			if (oldMode == StorageMode::BYTE) {
+				code = codes[code];
+			} else if (mode == StorageMode::BYTE) {
+				code = palette[code];
+			}
+			setCode(toreturn, mode, ind, code);
+		}
+		return toreturn;
+	}
+
+	/**
+	 * Sets isUsed[block] for every block there is. Only for BYTE mode.
+	 */
+	void markUsed(bool* isUsed) const {
+		if (!chunkLength) {
+			for (size_t ind = 0; ind < length; ind++) {
+				isUsed[getCode(words, mode, ind)] = true;
+			}
+			return;
+		}
+		for (size_t chunk = 0; chunk < numChunks; chunk++) {
+			if (!chunkWords[chunk]) {
+				isUsed[chunkTags[chunk]] = true;
+				continue;
+			}
+			for (size_t ind = 0; ind < chunkLength; ind++) {
+				isUsed[getCode(chunkWords[chunk], mode, ind)] = true;
+			}
+		}
+	}
+
+	/**
+	 * Sets up chunks of inChunkLength blocks, a power of 2, all air.
+	 * No chunks if inChunkLength is 0.
+	 */
+	void initChunks(size_t inChunkLength) {
+		chunkLength = inChunkLength;
+		chunkShift = 0;
+		numChunks = 0;
+		chunkWords = nullptr;
+		chunkOccupancy = nullptr;
+		chunkCounts = nullptr;
+		chunkTags = nullptr;
+		chunkShares = nullptr;
+		if (!chunkLength) {
+			return;
+		}
+		while ((static_cast<size_t>(1) << chunkShift) < chunkLength) {
+			chunkShift++;
+		}
+		numChunks = (length + chunkLength - 1) >> chunkShift;
+		chunkWords = new std::uint64_t*[numChunks]();
+		chunkOccupancy = new std::uint64_t*[numChunks]();
+		chunkCounts = new std::uint32_t[numChunks]();
+		chunkTags = new std::uint8_t[numChunks]();
+		chunkShares = new std::atomic<std::uint32_t>*[numChunks]();
+	}
+
+	/**
+	 * Lets go of the words and occupancy bits of chunk, freeing them unless
+	 * another storage still shares them, and leaves it without any.
+	 */
+	void releaseChunk(size_t chunk) {
+		if (!chunkShares[chunk] || (chunkShares[chunk]->fetch_sub(1) == 1)) {
+			delete[] chunkWords[chunk];
+			delete[] chunkOccupancy[chunk];
+			delete chunkShares[chunk];
+		}
+		chunkWords[chunk] = nullptr;
+		chunkOccupancy[chunk] = nullptr;
+		chunkShares[chunk] = nullptr;
+	}
+
+	/**
+	 * Makes sure chunk, which has its own words, doesn't share them with
+	 * another storage, copying them if it does, so that they can be changed.
+	 */
+	void ownChunk(size_t chunk) {
+		if (!chunkShares[chunk]) {
+			return;
+		}
+		if (chunkShares[chunk]->load() == 1) {
+			// everything else that shared it is gone
+			delete chunkShares[chunk];
+			chunkShares[chunk] = nullptr;
+			return;
+		}
+		size_t numWords = getNumWords(mode, chunkLength);
+		size_t numOccupancyWords = (chunkLength + 63) / 64;
+		std::uint64_t* newWords = new std::uint64_t[numWords];
+		std::uint64_t* newOccupancy = new std::uint64_t[numOccupancyWords];
+		std::copy(chunkWords[chunk], chunkWords[chunk] + numWords, newWords);
+		std::copy(chunkOccupancy[chunk],
+				chunkOccupancy[chunk] + numOccupancyWords, newOccupancy);
+		releaseChunk(chunk);
+		chunkWords[chunk] = newWords;
+		chunkOccupancy[chunk] = newOccupancy;
+	}
+
+	/**
+	 * Gives chunk, which is all one block, its own words and occupancy bits.
+	 */
+	void splitChunk(size_t chunk) {
+		std::uint8_t block = chunkTags[chunk];
+		std::uint8_t code = (mode == StorageMode::BYTE)? block: codes[block];
+		std::uint64_t* newWords =
+				new std::uint64_t[getNumWords(mode, chunkLength)];
+		for (size_t ind = 0; ind < chunkLength; ind++) {
+			setCode(newWords, mode, ind, code);
+		}
+		size_t numOccupancyWords = (chunkLength + 63) / 64;
+		std::uint64_t* newOccupancy = new std::uint64_t[numOccupancyWords];
+		std::fill(newOccupancy, newOccupancy + numOccupancyWords,
+				(block == 0)? 0: ~static_cast<std::uint64_t>(0));
+		chunkWords[chunk] = newWords;
+		chunkOccupancy[chunk] = newOccupancy;
+		chunkCounts[chunk] = (block == 0)? 0: chunkLength;
+	}
+
+	/**
+	 * Makes sure block has a code, switching to the next bigger mode
+	 * if there is no room left in the palette.
+	 */
+	void makeCode(std::uint8_t block) {
+		if ((mode == StorageMode::BYTE) || (codes[block] != noCode)) {
+			return;
+		}
+		if (!addToPalette(block)) {
+			setMode((mode == StorageMode::TRIBIT)?
+					StorageMode::NIBBLE: StorageMode::BYTE);
+			makeCode(block);
+		}
+	}
+
+	void clearPalette() {
+		for (size_t i = 0; i < 256; i++) {
+			palette[i] = 0;
+			codes[i] = noCode;
+		}
+		codes[0] = 0;
+		paletteSize = 1;
+	}
+
+	/**
+	 * Returns false if the palette is full.
+	 */
+	bool addToPalette(std::uint8_t block) {
+		if (paletteSize == getPaletteCapacity(mode)) {
+			return false;
+		}
+		palette[paletteSize] = block;
+		codes[block] = paletteSize;
+		paletteSize++;
+		return true;
+	}
+
+	/**
+	 * For MazeFile. Takes ownership of inWords and inOccupancy, which were
+	 * either made by new[], or are in inMapping, which came from mmap.
+	 * The palette is left for MazeFile to fill in.
+	 */
+	MazeStorage(size_t inLength, StorageMode inMode,
+			std::uint64_t* inWords, std::uint64_t* inOccupancy,
+			void* inMapping, size_t inMappingLength):
+				mode(inMode), length(inLength),
+				words(inWords), occupancy(inOccupancy),
+				mapping(inMapping), mappingLength(inMappingLength),
+				isWordsMapped(inMapping != nullptr) {
+		clearPalette();
+		initChunks(0);
+	}
+
+public:
+	/**
+	 * All air to start with. If inChunkLength isn't 0, it must be a power
+	 * of 2, and blocks get split up into chunks that long, which only take
+	 * up memory once they have different blocks in them.
+	 */
+	MazeStorage(size_t inLength, StorageMode inMode, size_t inChunkLength = 0):
+			mode(inMode), length(inLength), mapping(nullptr),
+			mappingLength(0), isWordsMapped(false) {
+		if (inChunkLength) {
+			words = nullptr;
+			occupancy = nullptr;
+		} else {
+			words = new std::uint64_t[getNumWords(mode, length)]();
+			occupancy = new std::uint64_t[(length + 63) / 64]();
+		}
+		clearPalette();
+		initChunks(inChunkLength);
+	}
+
+	MazeStorage(MazeStorage& other) = delete;
+	MazeStorage(const MazeStorage& other) = delete;
+	MazeStorage(MazeStorage&& other) = delete;
+	MazeStorage& operator=(MazeStorage& other) = delete;
+	MazeStorage& operator=(const MazeStorage& other) = delete;
+	MazeStorage& operator=(MazeStorage&& other) = delete;
+
+	~MazeStorage() {
+		if (!isWordsMapped) {
+			delete[] words;
+		}
+		if (mapping) {
+			munmap(mapping, mappingLength);
+		} else {
+			delete[] occupancy;
+		}
+		for (size_t chunk = 0; chunk < numChunks; chunk++) {
+			releaseChunk(chunk);
+		}
+		delete[] chunkWords;
+		delete[] chunkOccupancy;
+		delete[] chunkCounts;
+		delete[] chunkTags;
+		delete[] chunkShares;
+	}
+
+	/**
+	 * A copy of this. If there are chunks, it shares their words with this
+	 * instead of copying them, until either of them changes a chunk, so
+	 * this is only as slow as going over the chunks. Otherwise, everything
+	 * gets copied. This can't be changed while share runs. You delete this.
+	 */
+	MazeStorage* share() {
+		MazeStorage* toreturn = new MazeStorage(length, mode, chunkLength);
+		std::copy(palette, palette + 256, toreturn->palette);
+		std::copy(codes, codes + 256, toreturn->codes);
+		toreturn->paletteSize = paletteSize;
+		if (!chunkLength) {
+			std::copy(words, words + getNumWords(mode, length), toreturn->words);
+			std::copy(occupancy, occupancy + (length + 63) / 64,
+					toreturn->occupancy);
+			return toreturn;
+		}
+		std::copy(chunkCounts, chunkCounts + numChunks, toreturn->chunkCounts);
+		std::copy(chunkTags, chunkTags + numChunks, toreturn->chunkTags);
+		for (size_t chunk = 0; chunk < numChunks; chunk++) {
+			if (!chunkWords[chunk]) {
+				continue;
+			}
+			if (!chunkShares[chunk]) {
+				chunkShares[chunk] = new std::atomic<std::uint32_t>(1);
+			}
+			chunkShares[chunk]->fetch_add(1);
+			toreturn->chunkWords[chunk] = chunkWords[chunk];
+			toreturn->chunkOccupancy[chunk] = chunkOccupancy[chunk];
+			toreturn->chunkShares[chunk] = chunkShares[chunk];
+		}
+		return toreturn;
+	}
+
+	/**
+	 * Copies the words of every chunk this still shares with another
+	 * storage, so that changing them later doesn't have to.
+	 */
+	void ownChunks() {
+		for (size_t chunk = 0; chunk < numChunks; chunk++) {
+			if (chunkWords[chunk]) {
+				ownChunk(chunk);
+			}
+		}
+	}
+
+	StorageMode getMode() const {
+		return mode;
+	}
+
+	size_t getLength() const {
+		return length;
+	}
+
+	/**
+	 * 0 if there are no chunks.
+	 */
+	size_t getChunkLength() const {
+		return chunkLength;
+	}
+
+	size_t getNumChunks() const {
+		return numChunks;
+	}
+
+	/**
+	 * How many chunks have their own words, rather than being a tag.
+	 */
+	size_t getNumSplitChunks() const {
+		size_t toreturn = 0;
+		for (size_t chunk = 0; chunk < numChunks; chunk++) {
+			if (chunkWords[chunk]) {
+				toreturn++;
+			}
+		}
+		return toreturn;
+	}
+
+	/**
+	 * How much memory the blocks and the occupancy bits take up.
+	 */
+	size_t getNumBytes() const {
+		if (!chunkLength) {
+			return (getNumWords(mode, length) + (length + 63) / 64) *
+					sizeof(std::uint64_t);
+		}
+		return numChunks * (2 * sizeof(std::uint64_t*) +
+				sizeof(std::uint32_t) + sizeof(std::uint8_t)) +
+				getNumSplitChunks() * (getNumWords(mode, chunkLength) +
+						(chunkLength + 63) / 64) * sizeof(std::uint64_t);
+	}
+
+	bool isOccupied(size_t ind) const {
+		if (chunkLength) {
+			size_t chunk = ind >> chunkShift;
+			if (!chunkOccupancy[chunk]) {
+				return chunkTags[chunk] != 0;
+			}
+			return getBit(chunkOccupancy[chunk], ind & (chunkLength - 1));
+		}
+		return getBit(occupancy, ind);
+	}
+
+	/**
+	 * Whether the chunk that the block at ind is in is all air.
+	 * Always false if there are no chunks.
+	 */
+	bool isChunkEmpty(size_t ind) const {
+		if (!chunkLength) {
+			return false;
+		}
+		size_t chunk = ind >> chunkShift;
+		return !chunkWords[chunk] && (chunkTags[chunk] == 0);
+	}
+
+	std::uint8_t get(size_t ind) const {
+		const std::uint64_t* blockWords = words;
+		if (chunkLength) {
+			size_t chunk = ind >> chunkShift;
+			blockWords = chunkWords[chunk];
+			if (!blockWords) {
+				return chunkTags[chunk];
+			}
+			ind &= chunkLength - 1;
+		}
+		std::uint8_t code = getCode(blockWords, mode, ind);
+		return (mode == StorageMode::BYTE)? code: palette[code];
+	}
+
+	/**
+	 * If there is no room left in the palette for block,
+	 * this switches to the next bigger mode first.
+	 * If a chunk ends up all air, it goes back to being just a tag.
+	 */
+	void set(size_t ind, std::uint8_t block) {
+		makeCode(block);
+		std::uint8_t code = (mode == StorageMode::BYTE)? block: codes[block];
+		if (!chunkLength) {
+			setBit(occupancy, ind, block != 0);
+			setCode(words, mode, ind, code);
+			return;
+		}
+		size_t chunk = ind >> chunkShift;
+		if (!chunkWords[chunk]) {
+			if (chunkTags[chunk] == block) {
+				return;
+			}
+			splitChunk(chunk);
+		} else {
+			ownChunk(chunk);
+		}
+		ind &= chunkLength - 1;
+		if (getBit(chunkOccupancy[chunk], ind)) {
+			chunkCounts[chunk]--;
+		}
+		if (block != 0) {
+			chunkCounts[chunk]++;
+		}
+		setBit(chunkOccupancy[chunk], ind, block != 0);
+		setCode(chunkWords[chunk], mode, ind, code);
+		if (chunkCounts[chunk] == 0) {
+			setChunk(chunk, 0);
+		}
+	}
+
+	/**
+	 * Makes sure each block from first to last has a code, switching to the
+	 * next bigger mode if it has to, so that setRange can be used with them.
+	 */
+	void reserveBlocks(std::uint8_t first, std::uint8_t last) {
+		for (size_t block = first; block <= last; block++) {
+			makeCode(block);
+		}
+	}
+
+	/**
+	 * Same as set for each block from begin to end - 1, to newBlocks, but
+	 * a word at a time, instead of a block at a time. Every block in
+	 * newBlocks must already have a code, from reserveBlocks. Not for
+	 * chunks. Different threads can do this at once, as long as their
+	 * ranges start and end at multiples of rangeAlignment, or at length.
+	 */
+	void setRange(size_t begin, size_t end, const std::uint8_t* newBlocks) {
+		size_t perWord = (mode == StorageMode::NIBBLE)? 16: 21;
+		size_t bits = (mode == StorageMode::NIBBLE)? 4: 3;
+		if (mode == StorageMode::BYTE) {
+			std::copy(newBlocks, newBlocks + (end - begin),
+					reinterpret_cast<std::uint8_t*>(words) + begin);
+		}
+		for (size_t ind = begin; (mode != StorageMode::BYTE) && (ind < end);) {
+			if ((ind % perWord == 0) && (ind + perWord <= end)) {
+				std::uint64_t word = 0;
+				for (size_t j = 0; j < perWord; j++) {
+					std::uint64_t code = codes[newBlocks[ind - begin + j]];
+					word |= code << (j * bits);
+				}
+				words[ind / perWord] = word;
+				ind += perWord;
+			} else {
+				setCode(words, mode, ind, codes[newBlocks[ind - begin]]);
+				ind++;
+			}
+		}
+		for (size_t ind = begin; ind < end;) {
+			if (((ind & 63) == 0) && (ind + 64 <= end)) {
+				std::uint64_t word = 0;
+				for (size_t j = 0; j < 64; j++) {
+					word |= static_cast<std::uint64_t>(
+							newBlocks[ind - begin + j] != 0) << j;
+				}
+				occupancy[ind >> 6] = word;
+				ind += 64;
+			} else {
+				setBit(occupancy, ind, newBlocks[ind - begin] != 0);
+				ind++;
+			}
+		}
+	}
+
+	/**
+	 * Makes every block of chunk block, and frees whatever it took up.
+	 */
+	void setChunk(size_t chunk, std::uint8_t block) {
+		makeCode(block);
+		releaseChunk(chunk);
+		chunkCounts[chunk] = 0;
+		chunkTags[chunk] = block;
+	}
+
+	/**
+	 * Repacks everything. Returns false, and changes nothing, if newMode
+	 * can't hold as many different blocks as there are.
+	 */
+	bool setMode(StorageMode newMode) {
+		if (newMode == mode) {
+			return true;
+		}
+		StorageMode oldMode = mode;
+		if (oldMode == StorageMode::BYTE) {
+			// BYTE doesn't keep a palette, so make one
+			bool isUsed[256] = {};
+			markUsed(isUsed);
+			mode = newMode;
+			clearPalette();
+			for (size_t block = 1; block < 256; block++) {
+				if (isUsed[block] && !addToPalette(block)) {
+					mode = oldMode;
+					return false;
+				}
+			}
+		} else if (paletteSize > getPaletteCapacity(newMode)) {
+			return false;
+		}
+		mode = newMode;
+		if (chunkLength) {
+			for (size_t chunk = 0; chunk < numChunks; chunk++) {
+				if (chunkWords[chunk]) {
+					std::uint64_t* newWords =
+							repack(chunkWords[chunk], chunkLength, oldMode);
+					std::uint64_t* newOccupancy = chunkOccupancy[chunk];
+					if (chunkShares[chunk]) {
+						size_t numOccupancyWords = (chunkLength + 63) / 64;
+						newOccupancy = new std::uint64_t[numOccupancyWords];
+						std::copy(chunkOccupancy[chunk],
+								chunkOccupancy[chunk] + numOccupancyWords,
+								newOccupancy);
+						releaseChunk(chunk);
+					} else {
+						delete[] chunkWords[chunk];
+					}
+					chunkWords[chunk] = newWords;
+					chunkOccupancy[chunk] = newOccupancy;
+				}
+			}
+			return true;
+		}
+		std::uint64_t* newWords = repack(words, length, oldMode);
+		if (!isWordsMapped) {
+			delete[] words;
+		}
+		words = newWords;
+		isWordsMapped = false;
+		return true;
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_MAZE_STORAGE_HPP_ */
@@ -1,6 +1,7 @@
 #ifndef INCLUDE_LABYRINTH_CORE_MAZE_MAZE_VIEWER_HPP_
 #define INCLUDE_LABYRINTH_CORE_MAZE_MAZE_VIEWER_HPP_
 
+#include <labyrinth_core/maze/maze_query.hpp>
 #include <labyrinth_core/maze/maze_renderer.hpp>
 
 #include <algorithm>
@@ -17,7 +18,10 @@ class MazeViewer {
 
 	Maze maze;
 	MazeRenderer renderer;
+	MazeQuery query;
 	double* camera;
+	// for moving and rotating, so that they don't allocate every frame
+	std::vector<double> scratch;
 
 	/**
 	 * Outputs (into output) the projection of vec onto the space spanned by
@@ -231,12 +235,21 @@ public:
 		std::vector<std::vector<RotationalBinding>> rotatBindings;
 		size_t numThreads;
 		double fov;
+		// how far the camera keeps from walls
+		double collisionRadius;
+		// how long rendering a frame should take. The slices get rendered
+		// smaller than their width and height to keep to it, if need be.
+		// 0 is no target, always rendering them at their full size.
+		double targetFrameSeconds;
+		// the least the width and height of a slice can be scaled by for that
+		double minResolutionScale;
 
 		friend MazeViewer;
 
 	public:
 		explicit ViewerOptions(size_t numDims): numDims(numDims),
-				numThreads(8), fov(100) {}
+				numThreads(8), fov(100), collisionRadius(0.2),
+				targetFrameSeconds(0), minResolutionScale(0.25) {}
 
 		bool addSlice(const Slice& slice) {
 			if (slice.numDims != numDims) {
@@ -338,30 +351,155 @@ public:
 			return true;
 		}
 
+		double getCollisionRadius() const {
+			return collisionRadius;
+		}
+
+		bool setCollisionRadius(double newCollisionRadius) {
+			if ((newCollisionRadius < 0) || (newCollisionRadius >= 0.5)) {
+				return false;
+			}
+			collisionRadius = newCollisionRadius;
+			return true;
+		}
+
+		double getTargetFrameSeconds() const {
+			return targetFrameSeconds;
+		}
+
+		bool setTargetFrameSeconds(double newTargetFrameSeconds) {
+			if ((newTargetFrameSeconds < 0) || (newTargetFrameSeconds > 10)) {
+				return false;
+			}
+			targetFrameSeconds = newTargetFrameSeconds;
+			return true;
+		}
+
+		double getMinResolutionScale() const {
+			return minResolutionScale;
+		}
+
+		bool setMinResolutionScale(double newMinResolutionScale) {
+			if ((newMinResolutionScale < 0.01) || (newMinResolutionScale > 1)) {
+				return false;
+			}
+			minResolutionScale = newMinResolutionScale;
+			return true;
+		}
+
+	};
+
+	/**
+	 * A frame, as render or submitFrame made it: the slices and camera it
+	 * was rendered from, as they were when it started, and what each
+	 * slice came out as, width * height * 4 bytes of RGBA.
+	 * With a target frame time, the width and height here can be less than
+	 * those of the slice, and it's up to whatever shows the frame to
+	 * stretch it over the whole slice.
+	 */
+	class Frame {
+
+		std::vector<Slice> slices;
+		std::vector<double> camera;
+		std::vector<std::uint8_t*> outputs;
+		// how big each of outputs is
+		std::vector<size_t> outputSizes;
+		// the slicesVersion of the viewer when this started
+		size_t slicesVersion;
+
+		friend MazeViewer;
+
+	public:
+		Frame(): slicesVersion(0) {}
+
+		Frame(Frame& other) = delete;
+		Frame(const Frame& other) = delete;
+		Frame(Frame&& other) = delete;
+		Frame& operator=(Frame& other) = delete;
+		Frame& operator=(const Frame& other) = delete;
+		Frame& operator=(Frame&& other) = delete;
+
+		~Frame() {
+			for (std::uint8_t* output: outputs) {
+				delete[] output;
+			}
+		}
+
+		size_t getNumSlices() const {
+			return slices.size();
+		}
+
+		size_t getWidth(size_t index) const {
+			return slices[index].width;
+		}
+
+		size_t getHeight(size_t index) const {
+			return slices[index].height;
+		}
+
+		/**
+		 * Don't free these pointers either.
+		 */
+		const std::vector<std::uint8_t*>& getOutputs() const {
+			return outputs;
+		}
+
+		const double* getCamera() const {
+			return camera.data();
+		}
+
 	};
 
 private:
 	ViewerOptions options;
-	std::vector<std::uint8_t*> outputs;
+	// rendered turn about, so that one can be shown
+	// while the next one is being rendered into the other
+	Frame frames[2];
+	// the one last acquired
+	size_t shownFrame;
+	// whether the other one is being rendered
+	bool isFrameRendering;
+	// whether any frame has been acquired yet
+	bool isFrameShown;
 	size_t currSlice;
+	// what the width and height of each slice get scaled by, to keep to
+	// the target frame time. All 1 if there isn't one.
+	std::vector<double> resolutionScales;
+	// how many frames in a row each slice has been fast enough to go up
+	std::vector<size_t> numFramesUnder;
+	// bumped every time a slice is added or deleted,
+	// so that frames from before can be told apart
+	size_t slicesVersion;
+
+	// a slice gets scaled down if it takes this much longer than its part
+	// of the target, and up if it takes this much of it or less. The gap
+	// between them is so that it doesn't go up and down over and over.
+	static constexpr double lowerAbove = 1.1;
+	static constexpr double raiseBelow = 0.8;
+	// and going up, it has to have been fast enough for this many frames
+	// in a row, and only goes up by this much at a time, which from
+	// raiseBelow can't get it past lowerAbove
+	static constexpr size_t framesBeforeRaising = 8;
+	static constexpr double maxRaise = 1.1;
 
 public:
 	MazeViewer(const Maze& maze, const ViewerOptions& inOptions,
-			const double* inCamera): maze(maze, 0),
+			const double* inCamera): maze(maze),
 					renderer(maze, inCamera, inOptions.getFov()),
-					options(inOptions) {
+					query(maze), options(inOptions) {
 		if (maze.getNumDims() != options.numDims) {
 			options = ViewerOptions(maze.getNumDims());
 		}
 		camera = new double[options.numDims];
+		scratch.resize(2 * options.numDims);
 		setCamera(inCamera);
-		for (size_t i = 0; i < options.slices.size(); i++) {
-			outputs.push_back(
-					new std::uint8_t
-					[options.slices[i].width *
-					 options.slices[i].height * 4]);
-		}
+		shownFrame = 0;
+		isFrameRendering = false;
+		isFrameShown = false;
 		currSlice = 0;
+		resolutionScales.assign(options.slices.size(), 1);
+		numFramesUnder.assign(options.slices.size(), 0);
+		slicesVersion = 0;
 	}
 
 	MazeViewer(MazeViewer& other) = delete;
@@ -372,11 +510,9 @@ public:
 	MazeViewer& operator=(MazeViewer&& other) = delete;
 
 	~MazeViewer() {
-		maze.invalidate();
+		// the frame being rendered has to be done before it goes
+		renderer.waitForFinished();
 		delete[] camera;
-		for (std::uint8_t* output: outputs) {
-			delete[] output;
-		}
 	}
 
 	size_t getNumDims() const {
@@ -395,28 +531,73 @@ public:
 		return toreturn;
 	}
 
+	const double* getCamera() const {
+		return camera;
+	}
+
+	/**
+	 * Takes effect from the next frame started on.
+	 */
 	void setCamera(const double* inCamera) {
 		std::copy(inCamera, inCamera + maze.getNumDims(), camera);
-		renderer.setCamera(inCamera);
+	}
+
+	/**
+	 * Moves through newMaze from now on, and renders it from the next
+	 * frame on, see MazeRenderer::setMaze.
+	 */
+	void setMaze(const Maze& newMaze, MazeRenderer::TimePoint changedAt =
+			std::chrono::high_resolution_clock::now()) {
+		maze = newMaze;
+		query.setMaze(newMaze);
+		renderer.setMaze(newMaze, changedAt);
 	}
 
 	void setFov(double newFov) {
 		options.setFov(newFov);
 	}
 
+	void setCollisionRadius(double newCollisionRadius) {
+		options.setCollisionRadius(newCollisionRadius);
+	}
+
+	/**
+	 * See ViewerOptions::setTargetFrameSeconds. 0 goes back to
+	 * full size straight away, from the next frame started on.
+	 */
+	void setTargetFrameSeconds(double newTargetFrameSeconds) {
+		options.setTargetFrameSeconds(newTargetFrameSeconds);
+		if (options.targetFrameSeconds == 0) {
+			resolutionScales.assign(options.slices.size(), 1);
+			numFramesUnder.assign(options.slices.size(), 0);
+		}
+	}
+
+	void setMinResolutionScale(double newMinResolutionScale) {
+		options.setMinResolutionScale(newMinResolutionScale);
+	}
+
+	/**
+	 * What the width and height of slice index are being scaled by,
+	 * to keep to the target frame time.
+	 */
+	double getResolutionScale(size_t index) const {
+		return resolutionScales[index];
+	}
+
+	// changes to the slices, like those to the camera,
+	// take effect from the next frame started on
+
 	void addSlice(const Slice& slice) {
-		if (!options.addSlice(slice)) {
-			return;
+		if (options.addSlice(slice)) {
+			resolutionScales.push_back(1);
+			numFramesUnder.push_back(0);
+			slicesVersion++;
 		}
-		outputs.push_back(new std::uint8_t[slice.width * slice.height * 4]);
 	}
 
 	void resizeSlice(size_t index, size_t width, size_t height) {
-		if (!options.resizeSlice(index, width, height)) {
-			return;
-		}
-		delete[] outputs[index];
-		outputs[index] = new std::uint8_t[width * height * 4];
+		options.resizeSlice(index, width, height);
 	}
 
 	void setSliceAspect(size_t index, double aspect) {
@@ -424,11 +605,11 @@ public:
 	}
 
 	void deleteSlice(size_t index) {
-		if (!options.deleteSlice(index)) {
-			return;
+		if (options.deleteSlice(index)) {
+			resolutionScales.erase(resolutionScales.begin() + index);
+			numFramesUnder.erase(numFramesUnder.begin() + index);
+			slicesVersion++;
 		}
-		delete[] outputs[index];
-		outputs.erase(outputs.begin() + index);
 	}
 
 	void setRotatBinding(size_t from, size_t to, RotationalBinding binding) {
@@ -450,27 +631,39 @@ public:
 		currSlice = index;
 	}
 
+	/**
+	 * For asking where things are in the maze being moved through,
+	 * say with more rays than pick casts at once.
+	 */
+	MazeQuery& getQuery() {
+		return query;
+	}
+
+	/**
+	 * What is under pixel (col, row) of slice, the same
+	 * as render shows there. See MazeQuery::cast.
+	 */
+	RayHit pick(size_t slice, size_t col, size_t row,
+			std::int32_t* blockCoords = nullptr) {
+		if (slice >= options.slices.size()) {
+			return RayHit{-1000000, false, 0, options.numDims, 0, 0};
+		}
+		const Slice& s = options.slices[slice];
+		MazeRenderer::getPixelDirection(options.numDims,
+				s.forward, s.right, s.up, s.width, s.height, s.aspect,
+				options.fov, col, row, scratch.data());
+		return query.cast(camera, scratch.data(), blockCoords);
+	}
+
 private:
+	/**
+	 * Slides along walls, rather than stopping at them.
+	 */
 	void move(const double* direction, double amount) {
-		MazeKernel kernel (maze, camera);
-		std::uint8_t output[4];
-		MazeKernel::Result result =
-				kernel(output, direction, Color{0, 0, 0, 0xFF});
-		double t = result.t - 1e-3;
-		if ((t >= amount) || result.block.empty()) {
-			const double* direction_end = direction + options.numDims;
-			double* iter_camera = camera;
-			for (; direction < direction_end; ++direction, ++iter_camera) {
-				*iter_camera += amount * (*direction);
-			}
-		} else {
-			const double* direction_end = direction + options.numDims;
-			double* iter_camera = camera;
-			for (; direction < direction_end; ++direction, ++iter_camera) {
-				*iter_camera += t * (*direction);
-			}
+		for (size_t i = 0; i < options.numDims; i++) {
+			scratch[i] = amount * direction[i];
 		}
-		renderer.setCamera(camera);
+		query.move(camera, scratch.data(), options.collisionRadius);
 	}
 
 public:
@@ -499,36 +692,21 @@ public:
 		if (currSlice >= options.slices.size()) {
 			return;
 		}
-		double* direction = new double[options.numDims];
-		for (size_t i = 0; i < options.numDims; i++) {
-			direction[i] = -options.slices[currSlice].up[i];
-		}
-		move(direction, amount);
-		delete[] direction;
+		move(options.slices[currSlice].up, -amount);
 	}
 
 	void moveLeft(double amount) {
 		if (currSlice >= options.slices.size()) {
 			return;
 		}
-		double* direction = new double[options.numDims];
-		for (size_t i = 0; i < options.numDims; i++) {
-			direction[i] = -options.slices[currSlice].right[i];
-		}
-		move(direction, amount);
-		delete[] direction;
+		move(options.slices[currSlice].right, -amount);
 	}
 
 	void moveBackwards(double amount) {
 		if (currSlice >= options.slices.size()) {
 			return;
 		}
-		double* direction = new double[options.numDims];
-		for (size_t i = 0; i < options.numDims; i++) {
-			direction[i] = -options.slices[currSlice].forward[i];
-		}
-		move(direction, amount);
-		delete[] direction;
+		move(options.slices[currSlice].forward, -amount);
 	}
 
 private:
@@ -564,8 +742,8 @@ private:
 
 	void rotateVecByMatrix(double* vec, Dir from, Dir to,
 			double sinTheta, double cosTheta) {
-		double* tmp = new double[options.numDims];
-		double* remain = new double[options.numDims];
+		double* tmp = scratch.data();
+		double* remain = tmp + options.numDims;
 		const double* fromDir = getDir(currSlice, from);
 		const double* toDir = getDir(currSlice, to);
 		projection(options.numDims, tmp, vec, fromDir, toDir);
@@ -583,8 +761,6 @@ private:
 			vec[i] = remain[i] + newFromComponent * fromDir[i] +
 					newToComponent * toDir[i];
 		}
-		delete[] remain;
-		delete[] tmp;
 	}
 
 	void rotateSliceMatrix(size_t slice, Dir from, Dir to,
@@ -690,22 +866,176 @@ public:
 
 
 	/**
-	 * Don't free these pointers. Okay?
-	 * They will be all freed in the destructor.
+	 * Of the last frame render did, including how long
+	 * changes from setMaze took to show up.
 	 */
-	std::vector<std::uint8_t*> render() const {
-		for (size_t i = 0; i < options.slices.size(); i++) {
-			renderer.render(outputs[i],
-					options.slices[i].forward,
-					options.slices[i].right,
-					options.slices[i].up,
-					options.slices[i].width,
-					options.slices[i].height,
-					options.slices[i].aspect,
+	MazeRenderer::FrameStats getLastFrameStats() const {
+		return renderer.getLastFrameStats();
+	}
+
+private:
+	/**
+	 * Starts rendering frame from the slices and camera as they are now.
+	 * The renderer copies what it needs; frame keeps them for its getters.
+	 */
+	void startFrame(Frame& frame) {
+		frame.slices = options.slices;
+		frame.camera.assign(camera, camera + options.numDims);
+		frame.slicesVersion = slicesVersion;
+		size_t numSlices = frame.slices.size();
+		// the aspect stays that of the whole slice,
+		// so it sees just as much, only in fewer pixels
+		for (size_t i = 0; i < numSlices; i++) {
+			if (resolutionScales[i] < 1) {
+				frame.slices[i].width = std::max(static_cast<size_t>(10),
+						static_cast<size_t>(std::lround(
+						frame.slices[i].width * resolutionScales[i])));
+				frame.slices[i].height = std::max(static_cast<size_t>(10),
+						static_cast<size_t>(std::lround(
+						frame.slices[i].height * resolutionScales[i])));
+			}
+		}
+		for (size_t i = numSlices; i < frame.outputs.size(); i++) {
+			delete[] frame.outputs[i];
+		}
+		frame.outputs.resize(numSlices, nullptr);
+		frame.outputSizes.resize(numSlices, 0);
+		for (size_t i = 0; i < numSlices; i++) {
+			size_t size = frame.slices[i].width * frame.slices[i].height * 4;
+			if (frame.outputSizes[i] != size) {
+				delete[] frame.outputs[i];
+				frame.outputs[i] = new std::uint8_t[size];
+				frame.outputSizes[i] = size;
+			}
+		}
+		renderer.setCamera(frame.camera.data());
+		for (size_t i = 0; i < numSlices; i++) {
+			renderer.render(frame.outputs[i],
+					frame.slices[i].forward,
+					frame.slices[i].right,
+					frame.slices[i].up,
+					frame.slices[i].width,
+					frame.slices[i].height,
+					frame.slices[i].aspect,
 					options.fov);
 		}
+	}
+
+	/**
+	 * Scales the slices up or down for the frames after frame, which was
+	 * just finished, so that each takes its part of the target frame time.
+	 * Its part is how many of all the pixels it has at full size. How long
+	 * it took is how long the frame took, split up between the slices by
+	 * how long the threads spent on each, as they render all at once.
+	 * How long a slice takes goes with its pixels, so the square of
+	 * the scale, which is what the new scale comes from.
+	 */
+	void scaleResolution(const Frame& frame) {
+		if ((options.targetFrameSeconds == 0) ||
+				(frame.slicesVersion != slicesVersion)) {
+			return;
+		}
+		MazeRenderer::FrameStats stats = renderer.getLastFrameStats();
+		size_t numSlices = options.slices.size();
+		if ((stats.taskSeconds.size() != numSlices) ||
+				(stats.frameSeconds <= 0)) {
+			return;
+		}
+		double totalSeconds = 0, totalPixels = 0;
+		for (size_t i = 0; i < numSlices; i++) {
+			totalSeconds += stats.taskSeconds[i];
+			totalPixels += options.slices[i].width * options.slices[i].height;
+		}
+		if (totalSeconds <= 0) {
+			return;
+		}
+		for (size_t i = 0; i < numSlices; i++) {
+			double seconds = stats.frameSeconds * stats.taskSeconds[i] /
+					totalSeconds;
+			double target = options.targetFrameSeconds *
+					options.slices[i].width * options.slices[i].height /
+					totalPixels;
+			if (seconds <= 0) {
+				continue;
+			}
+			double scale = resolutionScales[i] * std::sqrt(target / seconds);
+			if (seconds > target * lowerAbove) {
+				resolutionScales[i] = std::max(options.minResolutionScale, scale);
+				numFramesUnder[i] = 0;
+			} else if ((seconds < target * raiseBelow) &&
+					(resolutionScales[i] < 1)) {
+				if (++numFramesUnder[i] >= framesBeforeRaising) {
+					resolutionScales[i] = std::min(std::min(1.0, scale),
+							resolutionScales[i] * maxRaise);
+					numFramesUnder[i] = 0;
+				}
+			} else {
+				numFramesUnder[i] = 0;
+			}
+		}
+	}
+
+	/**
+	 * For once the frame being rendered is done.
+	 */
+	const Frame* acquireFrame() {
 		renderer.waitForFinished();
-		return outputs;
+		isFrameRendering = false;
+		shownFrame = 1 - shownFrame;
+		isFrameShown = true;
+		scaleResolution(frames[shownFrame]);
+		return &frames[shownFrame];
+	}
+
+public:
+	/**
+	 * Starts rendering a frame, into the other buffers than the frame last
+	 * acquired, and returns without waiting for it. Moving, rotating and
+	 * changing the slices after this don't change that frame.
+	 * Returns false, and does nothing, if the frame started before
+	 * hasn't been acquired yet.
+	 */
+	bool submitFrame() {
+		if (isFrameRendering) {
+			return false;
+		}
+		startFrame(frames[1 - shownFrame]);
+		isFrameRendering = true;
+		return true;
+	}
+
+	/**
+	 * If the frame submitFrame started is done, returns it, and it stays
+	 * as it is until the next frame is acquired. Otherwise returns nullptr,
+	 * without waiting. So, to show one frame while the next one renders:
+	 * acquire, submit, and then show what was acquired.
+	 */
+	const Frame* tryAcquireFrame() {
+		if (!isFrameRendering || !renderer.isFinished()) {
+			return nullptr;
+		}
+		return acquireFrame();
+	}
+
+	/**
+	 * The frame last acquired, or nullptr if there hasn't been one.
+	 */
+	const Frame* getFrame() const {
+		return isFrameShown? &frames[shownFrame]: nullptr;
+	}
+
+	/**
+	 * Renders a frame and waits for it, throwing away
+	 * any frame submitFrame started that wasn't acquired.
+	 * Don't free these pointers. Okay?
+	 * They will be all freed in the destructor.
+	 */
+	std::vector<std::uint8_t*> render() {
+		if (isFrameRendering) {
+			acquireFrame();
+		}
+		submitFrame();
+		return acquireFrame()->outputs;
 	}
 
 };
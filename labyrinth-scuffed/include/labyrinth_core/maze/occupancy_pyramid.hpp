@@ -0,0 +1,254 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_OCCUPANCY_PYRAMID_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_OCCUPANCY_PYRAMID_HPP_
+
+#include <labyrinth_core/maze/paged_array.hpp>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <cstdint>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * A bit for every block saying whether it is anything but air, and above
+ * that, levels where each bit covers 2 by 2 by ... of the bits of the level
+ * below, saying whether any of those are set. So a cell of level L covers
+ * 2^L blocks along each axis, and if its bit is clear, all of them are air.
+ * The top level is a single cell covering everything.
+ * Each level is a PagedArray, so a copy only copies the words it changes.
+ */
+class OccupancyPyramid {
+
+	size_t numDims;
+	size_t numLevels;
+	// dimensions of level L are levelDims[L * numDims], ...
+	std::uint32_t* levelDims;
+	// same thing as Maze::tempProds, for each level
+	size_t* levelProds;
+	size_t* levelSizes;
+	// 2^12 words, or 32KB, to a page
+	std::vector<PagedArray<std::uint64_t>> levels;
+
+	bool getBit(size_t level, size_t ind) const {
+		return (levels[level][ind >> 6] >> (ind & 63)) & 1;
+	}
+
+	void setBit(size_t level, size_t ind, bool value) {
+		std::uint64_t word = levels[level][ind >> 6];
+		if (value) {
+			word |= static_cast<std::uint64_t>(1) << (ind & 63);
+		} else {
+			word &= ~(static_cast<std::uint64_t>(1) << (ind & 63));
+		}
+		levels[level].set(ind >> 6, word);
+	}
+
+	/**
+	 * Index, in level, of the cell containing the block at coords.
+	 */
+	size_t getInd(size_t level, const std::int32_t* coords) const {
+		const size_t* prods = levelProds + level * numDims;
+		size_t toreturn = 0;
+		for (size_t i = 0; i < numDims; i++) {
+			toreturn += (coords[i] >> level) * prods[i];
+		}
+		return toreturn;
+	}
+
+	/**
+	 * Whether any of the cells of level - 1 under the cell at ind of level
+	 * are set. coords is filled with the coordinates of that cell.
+	 */
+	bool isAnyChildSet(size_t level, size_t ind, std::int32_t* coords) const {
+		const size_t* prods = levelProds + level * numDims;
+		const size_t* childProds = levelProds + (level - 1) * numDims;
+		const std::uint32_t* childDims = levelDims + (level - 1) * numDims;
+		for (size_t i = 0; i < numDims; i++) {
+			coords[i] = ind / prods[i];
+			ind -= coords[i] * prods[i];
+		}
+		// go through the 2^numDims children like a binary counter
+		size_t numChildren = static_cast<size_t>(1) << numDims;
+		for (size_t which = 0; which < numChildren; which++) {
+			bool isInBounds = true;
+			size_t childInd = 0;
+			for (size_t i = 0; i < numDims; i++) {
+				std::int32_t child = 2 * coords[i] + ((which >> i) & 1);
+				if (child >= static_cast<std::int32_t>(childDims[i])) {
+					isInBounds = false;
+					break;
+				}
+				childInd += child * childProds[i];
+			}
+			if (isInBounds && getBit(level - 1, childInd)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * Fills the words [begin, end) of level. Level 0 comes from isOccupied,
+	 * and the rest from the level below.
+	 */
+	template<class IsOccupied>
+	void fillWords(size_t level, size_t begin, size_t end,
+			const IsOccupied& isOccupied) {
+		std::vector<std::int32_t> coords (numDims);
+		for (size_t word = begin; word < end; word++) {
+			std::uint64_t value = 0;
+			size_t indEnd = std::min((word + 1) * 64, levelSizes[level]);
+			for (size_t ind = word * 64; ind < indEnd; ind++) {
+				bool bit = (level == 0)? isOccupied(ind):
+						isAnyChildSet(level, ind, coords.data());
+				if (bit) {
+					value |= static_cast<std::uint64_t>(1) << (ind & 63);
+				}
+			}
+			levels[level].set(word, value);
+		}
+	}
+
+public:
+	/**
+	 * isOccupied(ind) says whether the block with row-major index ind
+	 * is anything but air. Each level is split up between numThreads
+	 * threads, so isOccupied has to be fine with that.
+	 */
+	template<class IsOccupied>
+	OccupancyPyramid(size_t inNumDims, const std::uint32_t* dimensions,
+			const IsOccupied& isOccupied, size_t numThreads):
+				numDims(inNumDims) {
+		std::uint32_t maxDim = *std::max_element(dimensions,
+				dimensions + numDims);
+		numLevels = 1;
+		while ((static_cast<std::uint64_t>(1) << (numLevels - 1)) < maxDim) {
+			numLevels++;
+		}
+		levelDims = new std::uint32_t[numLevels * numDims];
+		levelProds = new size_t[numLevels * numDims];
+		levelSizes = new size_t[numLevels];
+		for (size_t level = 0; level < numLevels; level++) {
+			size_t currProd = 1;
+			for (size_t i = numDims; i-- > 0;) {
+				std::uint32_t dim = levelDims[level * numDims + i] =
+						((dimensions[i] - 1) >> level) + 1;
+				levelProds[level * numDims + i] = currProd;
+				currProd *= dim;
+			}
+			levelSizes[level] = currProd;
+			levels.push_back(PagedArray<std::uint64_t>((currProd + 63) / 64, 12));
+		}
+
+		if (numThreads < 1) {
+			numThreads = 1;
+		}
+		std::vector<std::thread> threads;
+		for (size_t level = 0; level < numLevels; level++) {
+			size_t numWords = (levelSizes[level] + 63) / 64;
+			for (size_t t = 0; t < numThreads; t++) {
+				size_t begin = t * numWords / numThreads;
+				size_t end = (t + 1) * numWords / numThreads;
+				threads.push_back(std::thread(
+						[this, level, begin, end, &isOccupied] () -> void {
+					fillWords(level, begin, end, isOccupied);
+				}));
+			}
+			// each level needs all of the one below it
+			for (std::thread& thread: threads) {
+				thread.join();
+			}
+			threads.clear();
+		}
+	}
+
+	/**
+	 * Shares the words of every level with other, until one of them
+	 * changes some.
+	 */
+	OccupancyPyramid(const OccupancyPyramid& other): numDims(other.numDims),
+			numLevels(other.numLevels), levels(other.levels) {
+		levelDims = new std::uint32_t[numLevels * numDims];
+		levelProds = new size_t[numLevels * numDims];
+		levelSizes = new size_t[numLevels];
+		std::copy(other.levelDims, other.levelDims + numLevels * numDims,
+				levelDims);
+		std::copy(other.levelProds, other.levelProds + numLevels * numDims,
+				levelProds);
+		std::copy(other.levelSizes, other.levelSizes + numLevels, levelSizes);
+	}
+
+	OccupancyPyramid(OccupancyPyramid&& other) = delete;
+	OccupancyPyramid& operator=(OccupancyPyramid& other) = delete;
+	OccupancyPyramid& operator=(const OccupancyPyramid& other) = delete;
+	OccupancyPyramid& operator=(OccupancyPyramid&& other) = delete;
+
+	~OccupancyPyramid() {
+		delete[] levelSizes;
+		delete[] levelProds;
+		delete[] levelDims;
+	}
+
+	/**
+	 * Copies the words of every level that anything else shares, so that
+	 * update doesn't have to.
+	 */
+	void ownWords() {
+		for (PagedArray<std::uint64_t>& level: levels) {
+			level.ownPages();
+		}
+	}
+
+	size_t getNumLevels() const {
+		return numLevels;
+	}
+
+	/**
+	 * Whether anything in the cell of level containing the block at coords
+	 * is not air.
+	 */
+	bool isOccupied(size_t level, const std::int32_t* coords) const {
+		return getBit(level, getInd(level, coords));
+	}
+
+	/**
+	 * The highest level whose cell containing the block at coords is all air.
+	 * The block at coords has to be air.
+	 */
+	size_t getEmptyLevel(const std::int32_t* coords) const {
+		size_t level = 0;
+		while ((level + 1 < numLevels) && !isOccupied(level + 1, coords)) {
+			level++;
+		}
+		return level;
+	}
+
+	/**
+	 * Call this when the block at coords changes between air and not air.
+	 */
+	void update(const std::int32_t* coords, bool isNowOccupied) {
+		setBit(0, getInd(0, coords), isNowOccupied);
+		std::vector<std::int32_t> cellCoords (numDims);
+		for (size_t level = 1; level < numLevels; level++) {
+			size_t ind = getInd(level, coords);
+			bool bit = isNowOccupied ||
+					isAnyChildSet(level, ind, cellCoords.data());
+			if (bit == getBit(level, ind)) {
+				// so nothing above changes either
+				break;
+			}
+			setBit(level, ind, bit);
+		}
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_OCCUPANCY_PYRAMID_HPP_ */
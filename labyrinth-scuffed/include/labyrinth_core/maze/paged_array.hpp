@@ -0,0 +1,92 @@
+#ifndef INCLUDE_LABYRINTH_CORE_MAZE_PAGED_ARRAY_HPP_
+#define INCLUDE_LABYRINTH_CORE_MAZE_PAGED_ARRAY_HPP_
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+
+namespace labyrinth_core {
+
+namespace maze {
+
+/**
+ * An array split into pages of 2^pageShift elements. A copy of it shares
+ * the pages with it, and whichever of them changes something in a page
+ * first copies just that page then, the same as MazeStorage does with
+ * chunks. Copies can be read from on other threads while it is changed,
+ * but have to be made on the thread changing it.
+ */
+template<class T>
+class PagedArray {
+
+	size_t length;
+	size_t pageShift;
+	size_t pageMask;
+	std::vector<std::shared_ptr<T[]>> pages;
+
+	void ownPage(std::shared_ptr<T[]>& page) {
+		if (page.use_count() > 1) {
+			T* newPage = new T[pageMask + 1];
+			std::copy(page.get(), page.get() + pageMask + 1, newPage);
+			page.reset(newPage);
+		}
+	}
+
+public:
+	/**
+	 * Every element starts off as T().
+	 */
+	PagedArray(size_t inLength, size_t inPageShift): length(inLength),
+			pageShift(inPageShift),
+			pageMask((static_cast<size_t>(1) << inPageShift) - 1) {
+		size_t numPages = (length + pageMask) >> pageShift;
+		for (size_t page = 0; page < numPages; page++) {
+			pages.push_back(std::shared_ptr<T[]>(new T[pageMask + 1]()));
+		}
+	}
+
+	/**
+	 * Shares every page with other, until one of them is changed.
+	 */
+	PagedArray(const PagedArray& other) = default;
+	PagedArray(PagedArray&& other) = default;
+	PagedArray& operator=(const PagedArray& other) = default;
+	PagedArray& operator=(PagedArray&& other) = default;
+
+	size_t getLength() const {
+		return length;
+	}
+
+	const T& operator[](size_t ind) const {
+		return pages[ind >> pageShift][ind & pageMask];
+	}
+
+	/**
+	 * Copies the page with the element at ind first, if anything else
+	 * shares it. Different threads can set elements at once, so long as
+	 * nothing else shares their pages.
+	 */
+	void set(size_t ind, const T& value) {
+		std::shared_ptr<T[]>& page = pages[ind >> pageShift];
+		ownPage(page);
+		page[ind & pageMask] = value;
+	}
+
+	/**
+	 * Copies every page anything else shares, so that set doesn't have to.
+	 */
+	void ownPages() {
+		for (std::shared_ptr<T[]>& page: pages) {
+			ownPage(page);
+		}
+	}
+
+};
+
+} // maze
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_MAZE_PAGED_ARRAY_HPP_ */
@@ -0,0 +1,65 @@
+#ifndef INCLUDE_LABYRINTH_CORE_WORK_STEALING_DEQUE_HPP_
+#define INCLUDE_LABYRINTH_CORE_WORK_STEALING_DEQUE_HPP_
+
+#include <deque>
+#include <mutex>
+
+namespace labyrinth_core {
+
+namespace multithread {
+
+/**
+ * A deque owned by one thread, which takes from the back,
+ * that other threads can steal from the front of.
+ * Unlike ConcurrentQueue, nothing here blocks waiting for items.
+ */
+template<class T>
+class WorkStealingDeque {
+
+	std::deque<T> deque;
+	mutable std::mutex mutex;
+
+public:
+	void push(const T& item) {
+		std::lock_guard<std::mutex> lock (mutex);
+		deque.push_back(item);
+	}
+
+	/**
+	 * For the owner. Returns false if there was nothing.
+	 */
+	bool pop(T& item) {
+		std::lock_guard<std::mutex> lock (mutex);
+		if (deque.empty()) {
+			return false;
+		}
+		item = deque.back();
+		deque.pop_back();
+		return true;
+	}
+
+	/**
+	 * For everyone else. Returns false if there was nothing.
+	 */
+	bool steal(T& item) {
+		std::lock_guard<std::mutex> lock (mutex);
+		if (deque.empty()) {
+			return false;
+		}
+		item = deque.front();
+		deque.pop_front();
+		return true;
+	}
+
+	bool empty() const {
+		std::lock_guard<std::mutex> lock (mutex);
+		return deque.empty();
+	}
+
+};
+
+} // multithread
+
+} // labyrinth_core
+
+#endif /* INCLUDE_LABYRINTH_CORE_WORK_STEALING_DEQUE_HPP_ */
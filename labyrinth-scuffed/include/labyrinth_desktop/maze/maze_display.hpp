@@ -3,6 +3,7 @@
 
 #include <GL/gl.h>
 
+#include <labyrinth_core/maze/maze_editor.hpp>
 #include <labyrinth_core/maze/maze_viewer.hpp>
 #include <labyrinth_desktop/controls_handler.hpp>
 #include <labyrinth_desktop/displayable.hpp>
@@ -110,6 +111,10 @@ public:
 		// format {l, u, r, b}
 		std::vector<std::tuple<double, double, double, double>> sliceLocs;
 		Squareness squareness;
+		// whether a frame gets shown while the next one renders,
+		// a frame late, rather than waited for. off unless asked for,
+		// since it shows everything a frame later than it used to
+		bool pipelined = false;
 
 	public:
 		void operate(MazeDisplay* display,
@@ -157,10 +162,18 @@ public:
 			squareness = newSquareness;
 		}
 
+		bool isPipelined() const {
+			return pipelined;
+		}
+
+		void setPipelined(bool newPipelined) {
+			pipelined = newPipelined;
+		}
+
 	};
 
 private:
-	labyrinth_core::maze::Maze maze;
+	labyrinth_core::maze::MazeEditor editor;
 	labyrinth_core::maze::MazeViewer viewer;
 	DisplayOptions options;
 	GLuint texture;
@@ -209,6 +222,13 @@ public:
 		return errMsg;
 	}
 
+	/**
+	 * Changes queued here show up from the next call to display on.
+	 */
+	labyrinth_core::maze::MazeEditor& getEditor() {
+		return editor;
+	}
+
 	void display() override;
 
 	void onWindowResize(size_t width, size_t height) override;
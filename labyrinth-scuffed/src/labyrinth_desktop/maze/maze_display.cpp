@@ -247,11 +247,10 @@ labyrinth_desktop::maze::MazeDisplay::MazeDisplay(
 		const DisplayOptions& displayOptions,
 		const labyrinth_core::maze::MazeViewer::ViewerOptions& viewerOptions,
 		size_t width, size_t height):
-			maze(inMaze, 0), viewer(inMaze, viewerOptions, inCamera),
+			editor(inMaze), viewer(editor.getMaze(), viewerOptions, inCamera),
 			options(displayOptions),
 			buf(0), program(0), posLoc(0), texcLoc(0),
 			mouseX(0.0), mouseY(0.0) {
-	inMaze.invalidate();
 	if (options.getNumSlices() != viewer.getNumSlices()) {
 		std::vector<std::tuple<double, double, double, double>> sliceLocs;
 		for (size_t i = 0; i < viewer.getNumSlices(); i++) {
@@ -264,8 +263,8 @@ labyrinth_desktop::maze::MazeDisplay::MazeDisplay(
 		options.setSliceLocs(sliceLocs);
 	}
 	setAspect(width, height);
-	camera = new double[maze.getNumDims()];
-	std::copy(inCamera, inCamera + maze.getNumDims(), camera);
+	camera = new double[viewer.getNumDims()];
+	std::copy(inCamera, inCamera + viewer.getNumDims(), camera);
 
 
 	glGenTextures(1, &texture);
@@ -357,11 +356,31 @@ void labyrinth_desktop::maze::MazeDisplay::display() {
 			static_cast<float*>(nullptr) + 2);
 	std::vector<std::tuple<double, double, double, double>> locs =
 			options.getSliceLocs();
-	std::vector<std::pair<size_t, size_t>> sizes = viewer.getSliceSizes();
-	std::vector<std::uint8_t*> result = viewer.render();
+	if (editor.apply() > 0) {
+		viewer.setMaze(editor.getMaze(), editor.getChangedAt());
+	}
+	const labyrinth_core::maze::MazeViewer::Frame* frame;
+	if (options.isPipelined()) {
+		// the next frame renders while this one gets uploaded,
+		// and until it's done, the last one gets shown again
+		viewer.tryAcquireFrame();
+		viewer.submitFrame();
+		frame = viewer.getFrame();
+		if (!frame) {
+			return;
+		}
+	} else {
+		viewer.render();
+		frame = viewer.getFrame();
+	}
+	const std::vector<std::uint8_t*>& result = frame->getOutputs();
 	float l, u, r, b;
-	for (size_t i = 0; i < result.size(); i++) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, sizes[i].first, sizes[i].second,
+	for (size_t i = 0; (i < result.size()) && (i < locs.size()); i++) {
+		// the frame can be smaller than the slice, to keep to the target
+		// frame time, but it gets stretched over all of it all the same,
+		// and filtered linearly on the way
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+				frame->getWidth(i), frame->getHeight(i),
 				0, GL_RGBA, GL_UNSIGNED_BYTE, result[i]);
 		l = std::get<0>(locs[i]);
 		u = std::get<1>(locs[i]);
@@ -51,6 +51,7 @@ int initDisplay3D(size_t width, size_t height) {
 	displayOpts.setRotatSensitivity(60);
 	displayOpts.setSquareness(labyrinth_desktop::maze::
 			MazeDisplay::DisplayOptions::Squareness::SMOOTH);
+	displayOpts.setPipelined(true);
 	displayOpts.setSliceLocs({
 		{-1.0, 1.0, 1.0, -1.0}
 	});
@@ -83,6 +84,7 @@ int initDisplay3D(size_t width, size_t height) {
 	labyrinth_core::maze::MazeViewer::ViewerOptions viewerOpts (3);
 	viewerOpts.setNumThreads(16);
 	viewerOpts.setFov(110);
+	viewerOpts.setTargetFrameSeconds(1 / 60.0);
 	const size_t w = 1080, h = 720;
 	labyrinth_core::maze::MazeViewer::Slice slice1 (3, w, h);
 	viewerOpts.addSlice(slice1);
@@ -114,6 +116,7 @@ int initDisplay4D(size_t width, size_t height) {
 	displayOpts.setRotatSensitivity(60);
 	displayOpts.setSquareness(labyrinth_desktop::maze::
 			MazeDisplay::DisplayOptions::Squareness::SMOOTH);
+	displayOpts.setPipelined(true);
 	displayOpts.setSliceLocs({
 		{-1.0,  1.0, -0.1,  0.1},
 		{ 0.1,  1.0,  1.0,  0.1},
@@ -149,6 +152,7 @@ int initDisplay4D(size_t width, size_t height) {
 	labyrinth_core::maze::MazeViewer::ViewerOptions viewerOpts (4);
 	viewerOpts.setNumThreads(16);
 	viewerOpts.setFov(110);
+	viewerOpts.setTargetFrameSeconds(1 / 60.0);
 	const size_t w = 486, h = 324;
 	labyrinth_core::maze::MazeViewer::Slice slice1 (4, w, h);
 	viewerOpts.addSlice(slice1);
@@ -192,6 +196,7 @@ int initDisplay5D(size_t width, size_t height) {
 	displayOpts.setRotatSensitivity(60);
 	displayOpts.setSquareness(labyrinth_desktop::maze::
 			MazeDisplay::DisplayOptions::Squareness::SMOOTH);
+	displayOpts.setPipelined(true);
 	displayOpts.setSliceLocs({
 		{-1.0,  1.0, -0.4,  0.1},
 		{-0.3,  1.0,  0.3,  0.1},
@@ -231,6 +236,7 @@ int initDisplay5D(size_t width, size_t height) {
 	labyrinth_core::maze::MazeViewer::ViewerOptions viewerOpts (5);
 	viewerOpts.setNumThreads(16);
 	viewerOpts.setFov(110);
+	viewerOpts.setTargetFrameSeconds(1 / 60.0);
 	const size_t w = 324, h = 324;
 	labyrinth_core::maze::MazeViewer::Slice slice1 (5, w, h);
 	viewerOpts.addSlice(slice1);
@@ -282,6 +288,7 @@ int initDisplay12D(size_t width, size_t height) {
 	displayOpts.setRotatSensitivity(250);
 	displayOpts.setSquareness(labyrinth_desktop::maze::
 			MazeDisplay::DisplayOptions::Squareness::SMOOTH);
+	displayOpts.setPipelined(true);
 	displayOpts.setSliceLocs({
 		{-1.0,  1.0, -0.1,  0.1},
 		{ 0.1,  1.0,  1.0,  0.1},
@@ -317,6 +324,7 @@ int initDisplay12D(size_t width, size_t height) {
 	labyrinth_core::maze::MazeViewer::ViewerOptions viewerOpts (12);
 	viewerOpts.setNumThreads(8);
 	viewerOpts.setFov(140);
+	viewerOpts.setTargetFrameSeconds(1 / 60.0);
 	const size_t w = 200, h = 200;
 	double dim[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 	labyrinth_core::maze::MazeViewer::Slice slice1 (12, w, h);
@@ -0,0 +1,149 @@
+#include <labyrinth_core/maze/maze_renderer.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+const size_t width = 1920, height = 1080;
+
+// returns the total number of steps over all the rays of a frame
+size_t countSteps(const labyrinth_core::maze::Maze& maze,
+		labyrinth_core::maze::Acceleration acceleration,
+		const double* camera, const double* forward,
+		const double* right, const double* up) {
+	size_t numDims = maze.getNumDims();
+	labyrinth_core::maze::MazeKernel<> kernel (maze, camera);
+	kernel.setAcceleration(acceleration);
+	std::vector<double> direction (numDims);
+	// same as what MazeRenderer does for a 100 degree fov
+	double scale = 2 * std::tan(100 * 0.00872664625997164788462) / width;
+	size_t toreturn = 0;
+	for (size_t row = 0; row < height; row++) {
+		for (size_t col = 0; col < width; col++) {
+			double magnitude = 0;
+			for (size_t i = 0; i < numDims; i++) {
+				direction[i] = forward[i] + (col - width/2.0) * scale * right[i] +
+						(height/2.0 - row) * scale * up[i];
+				magnitude += direction[i] * direction[i];
+			}
+			magnitude = std::sqrt(magnitude);
+			for (size_t i = 0; i < numDims; i++) {
+				direction[i] /= magnitude;
+			}
+			toreturn += kernel(nullptr, direction.data(),
+					labyrinth_core::Color{0, 0, 0, 0xFF}).numSteps;
+		}
+	}
+	return toreturn;
+}
+
+// returns seconds per frame
+double timeFrames(const labyrinth_core::maze::Maze& maze,
+		labyrinth_core::maze::Acceleration acceleration,
+		const double* camera, const double* forward,
+		const double* right, const double* up, std::uint8_t* output) {
+	const size_t numFrames = 10;
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera, 8);
+	renderer.setAcceleration(acceleration);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t frame = 0; frame < numFrames; frame++) {
+		renderer.render(output, forward, right, up, width, height,
+				static_cast<double>(width) / height, 100);
+		renderer.waitForFinished();
+	}
+	double timeSpent = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now() - start).count();
+	return timeSpent / 1000000000 / numFrames;
+}
+
+double timeBuild(labyrinth_core::maze::Maze& maze,
+		labyrinth_core::maze::Acceleration acceleration) {
+	auto start = std::chrono::high_resolution_clock::now();
+	if (acceleration == labyrinth_core::maze::Acceleration::DISTANCE_FIELD) {
+		maze.buildDistanceField();
+	} else if (acceleration ==
+			labyrinth_core::maze::Acceleration::OCCUPANCY_PYRAMID) {
+		maze.buildOccupancyPyramid();
+	}
+	return std::chrono::duration_cast<std::chrono::duration<double>>(
+			std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void compare(size_t numDims, std::uint32_t mazeWidth) {
+	std::vector<std::uint32_t> dims (numDims, mazeWidth);
+	labyrinth_core::maze::Maze maze (numDims, dims.data());
+	// thin out the walls, so that there is open space to skip
+	size_t numBlocks = 1;
+	for (std::uint32_t dim: dims) {
+		numBlocks *= dim;
+	}
+	for (size_t i = 0; i < numBlocks; i++) {
+		if (i % 8 != 0) {
+			maze.setBlock(i, 0);
+		}
+	}
+	std::vector<double> camera (numDims, mazeWidth / 2.0);
+	camera[0] = 1;
+	std::vector<double> forward (numDims, 0.1), right (numDims, 0),
+			up (numDims, 0);
+	forward[0] = 1;
+	right[1] = 1;
+	up[2] = 1;
+
+	std::cout << numDims << "D, width " << mazeWidth << ":" << std::endl;
+	const labyrinth_core::maze::Acceleration accelerations[] = {
+		labyrinth_core::maze::Acceleration::NONE,
+		labyrinth_core::maze::Acceleration::DISTANCE_FIELD,
+		labyrinth_core::maze::Acceleration::OCCUPANCY_PYRAMID
+	};
+	const char* names[] = {"plain DDA", "distance field", "occupancy pyramid"};
+	std::vector<std::uint8_t> plainOutput (width * height * 4);
+	std::vector<std::uint8_t> output (width * height * 4);
+	for (size_t a = 0; a < 3; a++) {
+		double buildSeconds = timeBuild(maze, accelerations[a]);
+		size_t steps = countSteps(maze, accelerations[a], camera.data(),
+				forward.data(), right.data(), up.data());
+		double seconds = timeFrames(maze, accelerations[a], camera.data(),
+				forward.data(), right.data(), up.data(),
+				(a == 0)? plainOutput.data(): output.data());
+		std::cout << names[a] << ": " << steps << " steps, " <<
+				seconds << "s per frame, " << buildSeconds << "s to build";
+		if (a > 0) {
+			size_t numDifferent = 0;
+			for (size_t i = 0; i < width * height * 4; i += 4) {
+				if ((plainOutput[i] != output[i]) ||
+						(plainOutput[i + 1] != output[i + 1]) ||
+						(plainOutput[i + 2] != output[i + 2])) {
+					numDifferent++;
+				}
+			}
+			std::cout << ", " << numDifferent << " pixels different";
+		}
+		std::cout << std::endl;
+	}
+}
+
+// with just a pyramid, it should be the default up to 3D, and not past it
+bool checkDefaults() {
+	bool toreturn = true;
+	for (size_t numDims: {3, 4}) {
+		std::vector<std::uint32_t> dims (numDims, 9);
+		labyrinth_core::maze::Maze maze (numDims, dims.data());
+		maze.buildOccupancyPyramid();
+		bool isPyramid =
+				labyrinth_core::maze::MazeKernel<>::getDefaultAcceleration(maze) ==
+				labyrinth_core::maze::Acceleration::OCCUPANCY_PYRAMID;
+		toreturn = toreturn && (isPyramid == (numDims <= 3));
+	}
+	std::cout << "defaults: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = checkDefaults();
+	compare(3, 100);
+	compare(4, 30);
+	compare(3, 400);
+	return isFine? 0: 1;
+}
@@ -0,0 +1,168 @@
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		size_t numDims, std::uint32_t width, double density) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(numDims, width, "chunks");
+	options.setDensity(density);
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setLayout(labyrinth_core::maze::MazeLayout::CHUNKED);
+	return options;
+}
+
+std::vector<std::uint8_t> renderFrame(const labyrinth_core::maze::Maze& maze,
+		labyrinth_core::maze::Acceleration acceleration, double* seconds) {
+	const size_t width = 640, height = 480;
+	size_t numDims = maze.getNumDims();
+	std::vector<double> camera (numDims, 1);
+	std::vector<double> forward (numDims, 0.1), right (numDims, 0),
+			up (numDims, 0);
+	forward[0] = 1;
+	right[1] = 1;
+	up[2] = 1;
+	std::vector<std::uint8_t> toreturn (width * height * 4);
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera.data(), 8);
+	renderer.setAcceleration(acceleration);
+	auto start = std::chrono::high_resolution_clock::now();
+	renderer.render(toreturn.data(), forward.data(), right.data(), up.data(),
+			width, height, static_cast<double>(width) / height, 200);
+	renderer.waitForFinished();
+	*seconds = getSeconds(start);
+	return toreturn;
+}
+
+// visits every block of the box [lo, hi)
+template<class F>
+void forEachInBox(const std::vector<std::int32_t>& lo,
+		const std::vector<std::int32_t>& hi, const F& f) {
+	std::vector<std::int32_t> loc (lo);
+	while (true) {
+		f(loc);
+		size_t i = loc.size();
+		while (i-- > 0) {
+			if (++loc[i] < hi[i]) {
+				break;
+			}
+			loc[i] = lo[i];
+		}
+		if (i >= loc.size()) {
+			return;
+		}
+	}
+}
+
+bool testChunks(size_t numDims, std::uint32_t width) {
+	labyrinth_core::maze::Maze maze (makeOptions(numDims, width, 1));
+	// the same blocks, but bricked, so nothing is a tag
+	std::vector<std::uint32_t> dims (numDims, width);
+	labyrinth_core::maze::Maze bricked (numDims, dims.data(),
+			labyrinth_core::maze::StorageMode::BYTE,
+			labyrinth_core::maze::MazeLayout::BRICKED);
+	std::vector<std::int32_t> lo (numDims, 0), hi (numDims, width);
+	forEachInBox(lo, hi, [&maze, &bricked] (
+			const std::vector<std::int32_t>& loc) -> void {
+		bricked.setBlock(loc.begin(), maze.getBlock(loc.begin()));
+	});
+	// carve out a big room, so that there are empty bricks to skip
+	size_t bytesBefore = maze.getNumBytes();
+	std::vector<std::int32_t> roomLo (numDims, 1), roomHi (numDims, width / 2);
+	forEachInBox(roomLo, roomHi, [&maze, &bricked] (
+			const std::vector<std::int32_t>& loc) -> void {
+		maze.setBlock(loc.begin(), 0);
+		bricked.setBlock(loc.begin(), 0);
+	});
+	std::cout << numDims << "D, width " << width << ": " << bytesBefore <<
+			" bytes, " << maze.getNumBytes() << " after carving a room, " <<
+			bricked.getNumBytes() << " bricked" << std::endl;
+
+	bool toreturn = true;
+	size_t numWrong = 0;
+	forEachInBox(lo, hi, [&maze, &bricked, &numWrong] (
+			const std::vector<std::int32_t>& loc) -> void {
+		if (maze.getBlock(loc.begin()) != bricked.getBlock(loc.begin())) {
+			numWrong++;
+		}
+	});
+	if (numWrong > 0) {
+		std::cout << "    " << numWrong << " blocks wrong" << std::endl;
+		toreturn = false;
+	}
+
+	double seconds;
+	std::vector<std::uint8_t> expected = renderFrame(bricked,
+			labyrinth_core::maze::Acceleration::NONE, &seconds);
+	std::cout << "    bricked, no acceleration: " << seconds << "s" << std::endl;
+	const labyrinth_core::maze::Acceleration accelerations[] = {
+		labyrinth_core::maze::Acceleration::NONE,
+		labyrinth_core::maze::Acceleration::CHUNKS
+	};
+	const char* names[] = {"no acceleration", "chunks"};
+	for (size_t a = 0; a < 2; a++) {
+		std::vector<std::uint8_t> output = renderFrame(maze,
+				accelerations[a], &seconds);
+		std::cout << "    chunked, " << names[a] << ": " << seconds << "s, " <<
+				((output == expected)? "same": "different") <<
+				" pixels" << std::endl;
+		if (output != expected) {
+			toreturn = false;
+		}
+	}
+	return toreturn;
+}
+
+bool testModes() {
+	std::uint32_t dims[] = {12, 12, 12};
+	labyrinth_core::maze::Maze maze (3, dims,
+			labyrinth_core::maze::StorageMode::TRIBIT,
+			labyrinth_core::maze::MazeLayout::CHUNKED);
+	// more different blocks than 3 bits can hold
+	for (size_t i = 0; i < 1000; i++) {
+		maze.setBlock(i, i % 12);
+	}
+	bool toreturn = maze.getStorageMode() ==
+			labyrinth_core::maze::StorageMode::NIBBLE;
+	toreturn = toreturn &&
+			!maze.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT) &&
+			maze.setStorageMode(labyrinth_core::maze::StorageMode::BYTE) &&
+			maze.setStorageMode(labyrinth_core::maze::StorageMode::NIBBLE);
+	for (size_t i = 0; i < 1000; i++) {
+		if (maze.getBlock(i) != i % 12) {
+			toreturn = false;
+		}
+	}
+	// emptying a chunk out makes it a tag again
+	size_t numBytes = maze.getNumBytes();
+	for (size_t i = 0; i < 64; i++) {
+		maze.setBlock(i, 0);
+	}
+	toreturn = toreturn && maze.isChunkEmpty(0) && !maze.isChunkEmpty(64) &&
+			(maze.getNumBytes() < numBytes);
+	std::cout << "modes: " << (toreturn? "ok": "broken") << std::endl;
+	return toreturn;
+}
+
+void benchmarkBig(size_t numDims, std::uint32_t width, double density) {
+	auto start = std::chrono::high_resolution_clock::now();
+	labyrinth_core::maze::Maze maze (makeOptions(numDims, width, density));
+	double seconds = getSeconds(start);
+	double numBlocks = 1;
+	for (size_t i = 0; i < numDims; i++) {
+		numBlocks *= width;
+	}
+	std::cout << numDims << "D, width " << width << ", density " << density <<
+			": generated in " << seconds << "s, " << maze.getNumBytes() <<
+			" bytes, instead of " << numBlocks << " as bytes" << std::endl;
+}
+
+int main() {
+	bool isFine = testModes();
+	isFine = testChunks(3, 64) && isFine;
+	isFine = testChunks(4, 24) && isFine;
+	benchmarkBig(6, 40, 0.00001);
+	return isFine? 0: 1;
+}
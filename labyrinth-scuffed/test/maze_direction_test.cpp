@@ -0,0 +1,158 @@
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <cmath>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		size_t numDims, std::uint32_t width) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(numDims, width, "directions");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::BACKTRACKER);
+	return options;
+}
+
+// the directions should be forward + r * right + u * up, normalized,
+// even when those aren't orthonormal
+bool testDirections() {
+	const size_t numDims = 5, width = 97, height = 61;
+	double forward[] = {1, 0.3, 0.2, -0.1, 0.05};
+	double right[] = {0.1, 1, 0, 0.2, 0};
+	double up[] = {0, 0.1, 0.9, 0, 0.3};
+	bool toreturn = true;
+	for (double aspect: {0.5, 1.0, 2.0}) {
+		double xscale, yscale;
+		labyrinth_core::maze::MazeRenderer::getScales(width, height, aspect, 100,
+				&xscale, &yscale);
+		for (size_t row = 0; row < height; row++) {
+			for (size_t col = 0; col < width; col++) {
+				double direction[numDims];
+				labyrinth_core::maze::MazeRenderer::getPixelDirection(numDims,
+						forward, right, up, width, height, aspect, 100,
+						col, row, direction);
+				double r = (col - width / 2.0) * xscale;
+				double u = (height / 2.0 - row) * yscale;
+				double expected[numDims];
+				double magnitude = 0;
+				for (size_t i = 0; i < numDims; i++) {
+					expected[i] = forward[i] + r * right[i] + u * up[i];
+					magnitude += expected[i] * expected[i];
+				}
+				for (size_t i = 0; i < numDims; i++) {
+					toreturn = toreturn && (std::abs(direction[i] -
+							expected[i] / std::sqrt(magnitude)) < 1e-12);
+				}
+			}
+		}
+	}
+	std::cout << "directions: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+// the directions for every pixel of a 4K slice, worked out as they were
+// before, over every axis, and as the renderer does now. This is the part
+// that changed, with none of the tracing that comes after it.
+void timeDirections(size_t numDims) {
+	const size_t width = 3840, height = 2160;
+	std::vector<double> forward (numDims, 0.1), right (numDims, 0),
+			up (numDims, 0), direction (numDims);
+	forward[0] = 1;
+	right[1] = 1;
+	up[2] = 1;
+	double xscale, yscale;
+	labyrinth_core::maze::MazeRenderer::getScales(width, height,
+			static_cast<double>(width) / height, 100, &xscale, &yscale);
+	double sum = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t row = 0; row < height; row++) {
+		for (size_t col = 0; col < width; col++) {
+			double magnitude = 0;
+			double r = (col - width / 2.0) * xscale;
+			double u = (height / 2.0 - row) * yscale;
+			for (size_t i = 0; i < numDims; i++) {
+				double value = direction[i] = forward[i] + r * right[i] + u * up[i];
+				magnitude += value * value;
+			}
+			magnitude = std::sqrt(magnitude);
+			for (size_t i = 0; i < numDims; i++) {
+				direction[i] /= magnitude;
+			}
+			sum += direction[0];
+		}
+	}
+	double beforeSeconds = getSeconds(start);
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<double> rcomponents (width), ucomponents (height);
+	for (size_t col = 0; col < width; col++) {
+		rcomponents[col] = (col - width / 2.0) * xscale;
+	}
+	for (size_t row = 0; row < height; row++) {
+		ucomponents[row] = (height / 2.0 - row) * yscale;
+	}
+	labyrinth_core::maze::MazeRenderer::Gram gram (numDims,
+			forward.data(), right.data(), up.data());
+	for (size_t row = 0; row < height; row++) {
+		for (size_t col = 0; col < width; col++) {
+			labyrinth_core::maze::MazeRenderer::getDirection(numDims,
+					forward.data(), right.data(), up.data(), gram,
+					rcomponents[col], ucomponents[row], direction.data(), 1);
+			sum -= direction[0];
+		}
+	}
+	double afterSeconds = getSeconds(start);
+	std::cout << numDims << " dimensions, 3840x2160 directions: " <<
+			beforeSeconds * 1000 << "ms over every axis, " <<
+			afterSeconds * 1000 << "ms now" <<
+			((std::abs(sum) < 1e-3)? "": ", and not the same") << std::endl;
+}
+
+double timeSlice(labyrinth_core::maze::MazeRenderer& renderer,
+		size_t numDims, double forwardSign) {
+	const size_t width = 3840, height = 2160, numFrames = 5;
+	std::vector<double> forward (numDims, 0.1 * forwardSign),
+			right (numDims, 0), up (numDims, 0);
+	forward[0] = forwardSign;
+	right[1] = 1;
+	up[2] = 1;
+	std::vector<std::uint8_t> output (width * height * 4);
+	// the best of a few, as other things going on can only slow it down
+	double seconds = 1e+9;
+	for (size_t frame = 0; frame < numFrames; frame++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		renderer.render(output.data(), forward.data(), right.data(), up.data(),
+				width, height, static_cast<double>(width) / height, 100);
+		renderer.waitForFinished();
+		seconds = std::min(seconds, getSeconds(start));
+	}
+	return seconds;
+}
+
+// how long 4K slices take, looking into a maze, and looking away from it,
+// where every ray misses, so that all there is is setting up the rays
+void timeSlices(size_t numDims) {
+	labyrinth_core::maze::Maze maze (makeOptions(numDims, 9));
+	std::vector<double> camera (numDims, 1);
+	labyrinth_core::maze::MazeRenderer inside (maze, camera.data(),
+			labyrinth_core::multithread::getNumThreads());
+	camera[0] = -5;
+	labyrinth_core::maze::MazeRenderer outside (maze, camera.data(),
+			labyrinth_core::multithread::getNumThreads());
+	std::cout << numDims << " dimensions, 3840x2160: " <<
+			timeSlice(inside, numDims, 1) * 1000 << "ms a frame inside, " <<
+			timeSlice(outside, numDims, -1) * 1000 <<
+			"ms looking away" << std::endl;
+}
+
+int main() {
+	bool isFine = testDirections();
+	timeDirections(3);
+	timeDirections(5);
+	timeSlices(3);
+	timeSlices(5);
+	return isFine? 0: 1;
+}
@@ -0,0 +1,151 @@
+#include <labyrinth_core/maze/maze_editor.hpp>
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		std::uint32_t width, labyrinth_core::maze::MazeLayout layout) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(3, width, "editor");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setLayout(layout);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::KRUSKAL);
+	return options;
+}
+
+std::vector<std::uint8_t> renderFrame(
+		const labyrinth_core::maze::MazeRenderer& renderer) {
+	const size_t width = 160, height = 120;
+	double forward[] = {1, 0.2, 0.1}, right[] = {0, 1, 0}, up[] = {0, 0, 1};
+	std::vector<std::uint8_t> toreturn (width * height * 4);
+	renderer.render(toreturn.data(), forward, right, up,
+			width, height, static_cast<double>(width) / height, 90);
+	renderer.waitForFinished();
+	return toreturn;
+}
+
+// opens or closes a random wall block, away from the outside
+void queueRandomEdit(labyrinth_core::maze::MazeEditor& editor,
+		std::uint32_t width, std::mt19937& mtrand) {
+	std::uniform_int_distribution<std::int32_t> distro (1, width - 2);
+	std::int32_t loc[] = {distro(mtrand), distro(mtrand), distro(mtrand)};
+	editor.setBlock(loc, mtrand() % 2);
+}
+
+// every frame should show the maze exactly as some apply left it, even
+// with changes being queued on other threads all the while
+bool testLive(labyrinth_core::maze::MazeLayout layout, const char* name) {
+	const std::uint32_t width = 81;
+	labyrinth_core::maze::Maze maze (makeOptions(width, layout));
+	maze.buildDistanceField(4);
+	maze.buildOccupancyPyramid();
+	labyrinth_core::maze::MazeEditor editor (maze);
+	double camera[] = {1.5, 1.5, 1.5};
+	labyrinth_core::maze::MazeRenderer renderer (editor.getMaze(), camera, 4);
+	std::atomic<bool> isEditing (true);
+	std::vector<std::thread> editors;
+	for (size_t t = 0; t < 2; t++) {
+		editors.push_back(std::thread([&editor, &isEditing, t] () -> void {
+			std::mt19937 mtrand (t);
+			while (isEditing) {
+				// not so many that applying them can't keep up
+				if (editor.getNumQueued() < 50) {
+					queueRandomEdit(editor, width, mtrand);
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}));
+	}
+	bool toreturn = true;
+	size_t numApplied = 0;
+	double applySeconds = 0, changeSeconds = 0, changeStartSeconds = 0;
+	for (size_t frame = 0; frame < 30; frame++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t numChanges = editor.apply();
+		applySeconds += getSeconds(start);
+		numApplied += numChanges;
+		if (numChanges > 0) {
+			renderer.setMaze(editor.getMaze(), editor.getChangedAt());
+		}
+		std::vector<std::uint8_t> output = renderFrame(renderer);
+		labyrinth_core::maze::MazeRenderer::FrameStats stats =
+				renderer.getLastFrameStats();
+		changeSeconds = std::max(changeSeconds, stats.changeSeconds);
+		changeStartSeconds = std::max(changeStartSeconds,
+				stats.changeStartSeconds);
+		toreturn = toreturn && ((numChanges > 0) == (stats.changeSeconds > 0)) &&
+				((numChanges > 0) == (stats.changeStartSeconds > 0)) &&
+				(stats.changeStartSeconds <= stats.changeSeconds);
+		// the same maze, rendered from scratch
+		labyrinth_core::maze::Maze copy (editor.getMaze());
+		labyrinth_core::maze::MazeRenderer fresh (copy, camera, 1);
+		fresh.setAcceleration(renderer.getAcceleration());
+		toreturn = toreturn && (renderFrame(fresh) == output);
+	}
+	isEditing = false;
+	for (std::thread& thread: editors) {
+		thread.join();
+	}
+	std::cout << name << ": " << numApplied << " changes, " <<
+			applySeconds / 30 << "s to apply each frame, at most " <<
+			changeStartSeconds << "s until a frame started on them and " <<
+			changeSeconds << "s until they showed, " <<
+			(toreturn? "fine": "not fine") << std::endl;
+	return toreturn && (numApplied > 0);
+}
+
+// changes should come out in the order they were queued, and the distance
+// field should come out the same as building it all over again would
+bool testOrder() {
+	const std::uint32_t width = 41;
+	labyrinth_core::maze::Maze maze (makeOptions(width,
+			labyrinth_core::maze::MazeLayout::BRICKED));
+	maze.buildDistanceField(4);
+	labyrinth_core::maze::MazeEditor editor (maze);
+	std::mt19937 mtrand (5);
+	for (size_t round = 0; round < 5; round++) {
+		for (size_t k = 0; k < 200; k++) {
+			queueRandomEdit(editor, width, mtrand);
+		}
+		editor.apply();
+	}
+	// the same changes, straight onto a maze
+	labyrinth_core::maze::Maze direct (makeOptions(width,
+			labyrinth_core::maze::MazeLayout::BRICKED));
+	std::mt19937 again (5);
+	std::uniform_int_distribution<std::int32_t> distro (1, width - 2);
+	for (size_t k = 0; k < 1000; k++) {
+		std::int32_t loc[] = {distro(again), distro(again), distro(again)};
+		direct.setBlock(loc, again() % 2);
+	}
+	direct.buildDistanceField(4);
+	bool toreturn = true;
+	for (std::int32_t x = 0; x < static_cast<std::int32_t>(width); x++) {
+		for (std::int32_t y = 0; y < static_cast<std::int32_t>(width); y++) {
+			for (std::int32_t z = 0; z < static_cast<std::int32_t>(width); z++) {
+				std::int32_t loc[] = {x, y, z};
+				size_t ind = direct.getInd(loc);
+				toreturn = toreturn &&
+						(editor.getMaze().getBlock(ind) == direct.getBlock(ind)) &&
+						(editor.getMaze().getEmptyRadius(ind) ==
+								direct.getEmptyRadius(ind));
+			}
+		}
+	}
+	std::cout << "order: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testOrder();
+	isFine = testLive(labyrinth_core::maze::MazeLayout::ROW_MAJOR,
+			"row major") && isFine;
+	isFine = testLive(labyrinth_core::maze::MazeLayout::CHUNKED,
+			"chunked") && isFine;
+	return isFine? 0: 1;
+}
@@ -0,0 +1,171 @@
+#include <labyrinth_core/maze/maze_file.hpp>
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <cstdio>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		size_t numDims, std::uint32_t width,
+		labyrinth_core::maze::StorageMode storageMode,
+		labyrinth_core::maze::MazeLayout layout) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(numDims, width, "file test");
+	options.setStorageMode(storageMode);
+	options.setLayout(layout);
+	return options;
+}
+
+std::vector<std::uint8_t> renderFrame(const labyrinth_core::maze::Maze& maze) {
+	const size_t width = 320, height = 240;
+	size_t numDims = maze.getNumDims();
+	std::vector<double> camera (numDims, 1);
+	std::vector<double> forward (numDims, 0.1), right (numDims, 0),
+			up (numDims, 0);
+	forward[0] = 1;
+	right[1] = 1;
+	up[2] = 1;
+	std::vector<std::uint8_t> toreturn (width * height * 4);
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera.data(), 4);
+	renderer.render(toreturn.data(), forward.data(), right.data(), up.data(),
+			width, height, static_cast<double>(width) / height, 100);
+	renderer.waitForFinished();
+	return toreturn;
+}
+
+size_t countWrong(const labyrinth_core::maze::Maze& a,
+		const labyrinth_core::maze::Maze& b, size_t numBlocks) {
+	size_t toreturn = 0;
+	for (size_t i = 0; i < numBlocks; i++) {
+		if ((a.getBlock(i) != b.getBlock(i)) ||
+				(a.isOccupied(i) != b.isOccupied(i))) {
+			toreturn++;
+		}
+	}
+	return toreturn;
+}
+
+bool testFile(size_t numDims, std::uint32_t width,
+		labyrinth_core::maze::StorageMode storageMode,
+		labyrinth_core::maze::MazeLayout layout) {
+	const std::string path = "maze_file_test.maze";
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeOptions(numDims, width, storageMode, layout);
+	auto start = std::chrono::high_resolution_clock::now();
+	labyrinth_core::maze::Maze maze (options);
+	double generateSeconds = getSeconds(start);
+	size_t numBlocks = 1;
+	for (size_t i = 0; i < numDims; i++) {
+		numBlocks *= width;
+	}
+	std::vector<std::uint8_t> pixels = renderFrame(maze);
+
+	start = std::chrono::high_resolution_clock::now();
+	bool toreturn = labyrinth_core::maze::MazeFile::save(maze, path, &options);
+	double saveSeconds = getSeconds(start);
+	std::cout << numDims << "D, width " << width << ": " <<
+			maze.getNumBytes() << " bytes, generated in " << generateSeconds <<
+			"s, saved in " << saveSeconds << "s" << std::endl;
+
+	for (bool shouldMap: {true, false}) {
+		labyrinth_core::maze::Maze::MazeGenerationOptions loadedOptions;
+		start = std::chrono::high_resolution_clock::now();
+		labyrinth_core::maze::Maze* loaded =
+				labyrinth_core::maze::MazeFile::load(path,
+						&loadedOptions, shouldMap);
+		double loadSeconds = getSeconds(start);
+		if (!loaded) {
+			std::cout << "    " << (shouldMap? "mapped": "read") <<
+					": failed to load" << std::endl;
+			toreturn = false;
+			continue;
+		}
+		size_t numWrong = countWrong(maze, *loaded, numBlocks);
+		bool isSamePixels = renderFrame(*loaded) == pixels;
+		bool isSameOptions = (loadedOptions.getSeed() == options.getSeed()) &&
+				(loadedOptions.getDimensions() == options.getDimensions()) &&
+				(loadedOptions.getTwistProbability() ==
+						options.getTwistProbability()) &&
+				(loadedOptions.getMaxUseless() == options.getMaxUseless()) &&
+				(loadedOptions.getStorageMode() == storageMode) &&
+				(loadedOptions.getLayout() == layout);
+		std::cout << "    " << (shouldMap? "mapped": "read") << " in " <<
+				loadSeconds << "s, " << numWrong << " blocks wrong, " <<
+				(isSamePixels? "same": "different") << " pixels, " <<
+				(isSameOptions? "same": "different") << " options" << std::endl;
+		if ((numWrong > 0) || !isSamePixels || !isSameOptions) {
+			toreturn = false;
+		}
+		// changing the loaded maze shouldn't change the file
+		for (size_t i = 0; i < numBlocks; i += 7) {
+			loaded->setBlock(i, 0);
+		}
+		delete loaded;
+	}
+	labyrinth_core::maze::Maze* reloaded =
+			labyrinth_core::maze::MazeFile::load(path);
+	if (!reloaded || (countWrong(maze, *reloaded, numBlocks) > 0)) {
+		std::cout << "    the file changed" << std::endl;
+		toreturn = false;
+	}
+	delete reloaded;
+	std::remove(path.c_str());
+	return toreturn;
+}
+
+// saving a maze over the file it was mapped from should
+// leave the file just as it was, not lose the maze
+bool testSaveOver() {
+	const std::string path = "maze_file_test.maze";
+	const std::uint32_t width = 200;
+	const size_t numBlocks = width * width * width;
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeOptions(3, width, labyrinth_core::maze::StorageMode::TRIBIT,
+					labyrinth_core::maze::MazeLayout::BRICKED);
+	options.setNumThreads(4);
+	labyrinth_core::maze::Maze maze (options);
+	bool toreturn = labyrinth_core::maze::MazeFile::save(maze, path);
+	labyrinth_core::maze::Maze* loaded =
+			labyrinth_core::maze::MazeFile::load(path);
+	toreturn = toreturn && loaded &&
+			labyrinth_core::maze::MazeFile::save(*loaded, path) &&
+			(countWrong(maze, *loaded, numBlocks) == 0);
+	delete loaded;
+	labyrinth_core::maze::Maze* reloaded =
+			labyrinth_core::maze::MazeFile::load(path);
+	toreturn = toreturn && reloaded &&
+			(countWrong(maze, *reloaded, numBlocks) == 0);
+	delete reloaded;
+	std::remove(path.c_str());
+	std::cout << "saving over its own file: " <<
+			(toreturn? "ok": "broken") << std::endl;
+	return toreturn;
+}
+
+bool testBadFile() {
+	const std::string path = "maze_file_test.maze";
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	std::fputs("LABYMAZE but not really", file);
+	std::fclose(file);
+	bool toreturn = !labyrinth_core::maze::MazeFile::load(path) &&
+			!labyrinth_core::maze::MazeFile::load(path, nullptr, false) &&
+			!labyrinth_core::maze::MazeFile::load("no such file");
+	std::remove(path.c_str());
+	std::cout << "bad files: " << (toreturn? "ok": "broken") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testBadFile();
+	isFine = testSaveOver() && isFine;
+	isFine = testFile(3, 30, labyrinth_core::maze::StorageMode::BYTE,
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR) && isFine;
+	isFine = testFile(3, 30, labyrinth_core::maze::StorageMode::TRIBIT,
+			labyrinth_core::maze::MazeLayout::BRICKED) && isFine;
+	isFine = testFile(4, 13, labyrinth_core::maze::StorageMode::NIBBLE,
+			labyrinth_core::maze::MazeLayout::BRICKED) && isFine;
+	return isFine? 0: 1;
+}
@@ -0,0 +1,170 @@
+#include <labyrinth_core/maze/maze_viewer.hpp>
+#include "maze_test_common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <cstring>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		std::uint32_t width) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(3, width, "frames");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::BACKTRACKER);
+	return options;
+}
+
+labyrinth_core::maze::MazeViewer::ViewerOptions makeViewerOptions() {
+	labyrinth_core::maze::MazeViewer::ViewerOptions options (3);
+	options.addSlice(labyrinth_core::maze::MazeViewer::Slice(3, 640, 480));
+	options.addSlice(labyrinth_core::maze::MazeViewer::Slice(3, 320, 480));
+	options.setNumThreads(4);
+	return options;
+}
+
+std::vector<std::vector<std::uint8_t>> copyFrame(
+		const labyrinth_core::maze::MazeViewer::Frame& frame) {
+	std::vector<std::vector<std::uint8_t>> toreturn;
+	for (size_t i = 0; i < frame.getNumSlices(); i++) {
+		const std::uint8_t* output = frame.getOutputs()[i];
+		toreturn.push_back(std::vector<std::uint8_t>(output,
+				output + frame.getWidth(i) * frame.getHeight(i) * 4));
+	}
+	return toreturn;
+}
+
+// moving, rotating and resizing while a frame renders
+// shouldn't change that frame at all
+bool testCapture() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	double camera[] = {1, 1, 1};
+	labyrinth_core::maze::MazeViewer viewer (maze, makeViewerOptions(), camera);
+	labyrinth_core::maze::MazeViewer still (maze, makeViewerOptions(), camera);
+	bool toreturn = viewer.submitFrame() && !viewer.submitFrame() &&
+			!viewer.getFrame();
+	viewer.moveForward(0.4);
+	viewer.rotateRight(30);
+	viewer.rotateUp(20);
+	viewer.resizeSlice(0, 100, 100);
+	viewer.deleteSlice(1);
+	size_t numTries = 0;
+	const labyrinth_core::maze::MazeViewer::Frame* frame = nullptr;
+	while (!(frame = viewer.tryAcquireFrame())) {
+		numTries++;
+		std::this_thread::yield();
+	}
+	still.render();
+	toreturn = toreturn && (frame == viewer.getFrame()) &&
+			(frame->getNumSlices() == 2) && (frame->getWidth(0) == 640) &&
+			(frame->getCamera()[0] == 1) &&
+			(copyFrame(*frame) == copyFrame(*still.getFrame())) &&
+			!viewer.tryAcquireFrame();
+	// the next one has all of that
+	labyrinth_core::maze::MazeViewer moved (maze, makeViewerOptions(), camera);
+	moved.moveForward(0.4);
+	moved.rotateRight(30);
+	moved.rotateUp(20);
+	moved.resizeSlice(0, 100, 100);
+	moved.deleteSlice(1);
+	viewer.render();
+	moved.render();
+	toreturn = toreturn && (viewer.getFrame()->getNumSlices() == 1) &&
+			(viewer.getFrame()->getWidth(0) == 100) &&
+			(copyFrame(*viewer.getFrame()) == copyFrame(*moved.getFrame()));
+	std::cout << "capture: polled " << numTries << " times, " <<
+			(toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+// stands in for uploading a frame to the GPU
+void upload(const labyrinth_core::maze::MazeViewer::Frame& frame,
+		std::vector<std::uint8_t>& texture) {
+	for (size_t i = 0; i < frame.getNumSlices(); i++) {
+		size_t size = frame.getWidth(i) * frame.getHeight(i) * 4;
+		texture.resize(size);
+		std::memcpy(texture.data(), frame.getOutputs()[i], size);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+// showing one frame while the next renders should get more frames done
+bool testOverlap() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	double camera[] = {1, 1, 1};
+	labyrinth_core::maze::MazeViewer viewer (maze, makeViewerOptions(), camera);
+	std::vector<std::uint8_t> texture;
+	const size_t numFrames = 60;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t frame = 0; frame < numFrames; frame++) {
+		viewer.rotateRight(1);
+		viewer.render();
+		upload(*viewer.getFrame(), texture);
+	}
+	double serialSeconds = getSeconds(start);
+	start = std::chrono::high_resolution_clock::now();
+	size_t numShown = 0, numNew = 0;
+	while (numNew < numFrames) {
+		viewer.rotateRight(1);
+		if (viewer.tryAcquireFrame()) {
+			numNew++;
+		}
+		viewer.submitFrame();
+		if (viewer.getFrame()) {
+			upload(*viewer.getFrame(), texture);
+			numShown++;
+		}
+	}
+	double pipelinedSeconds = getSeconds(start);
+	std::cout << "overlap: " << numFrames / serialSeconds <<
+			" frames/s waiting for each, " << numNew / pipelinedSeconds <<
+			" new frames/s (" << numShown / pipelinedSeconds <<
+			" shown) pipelined" << std::endl;
+	return numShown >= numNew;
+}
+
+// the renderer should copy the camera and directions when given a slice,
+// so scribbling over them straight after shouldn't change anything
+bool testScribble() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	double camera[] = {1, 1, 1};
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera, 4);
+	const size_t width = 320, height = 240, numSlices = 100;
+	double forward[] = {1, 0.3, 0.2}, right[] = {0, 1, 0}, up[] = {0, 0, 1};
+	std::vector<std::uint8_t> expected (width * height * 4);
+	renderer.render(expected.data(), forward, right, up,
+			width, height, static_cast<double>(width) / height, 90);
+	renderer.waitForFinished();
+	// more slices than a frame has room for, too
+	std::vector<std::vector<std::uint8_t>> outputs (numSlices,
+			std::vector<std::uint8_t>(width * height * 4));
+	double scribbled[3];
+	double scribbledCamera[3];
+	for (size_t k = 0; k < numSlices; k++) {
+		std::copy(forward, forward + 3, scribbled);
+		std::copy(camera, camera + 3, scribbledCamera);
+		renderer.setCamera(scribbledCamera);
+		renderer.render(outputs[k].data(), scribbled, right, up,
+				width, height, static_cast<double>(width) / height, 90);
+		scribbled[0] = -1;
+		scribbled[1] = k;
+		scribbledCamera[1] = 2;
+	}
+	renderer.waitForFinished();
+	bool toreturn = true;
+	for (size_t k = 0; k < numSlices; k++) {
+		toreturn = toreturn && (outputs[k] == expected);
+	}
+	std::cout << "scribble: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testCapture();
+	isFine = testScribble() && isFine;
+	isFine = testOverlap() && isFine;
+	return isFine? 0: 1;
+}
@@ -0,0 +1,390 @@
+#include <labyrinth_core/maze/maze.hpp>
+#include <labyrinth_core/maze/maze_generator.hpp>
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::StorageMode storageMode,
+		labyrinth_core::maze::MazeLayout layout, size_t numThreads,
+		labyrinth_core::maze::MazeAlgorithm algorithm =
+				labyrinth_core::maze::MazeAlgorithm::HEADS) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(dims, "1");
+	options.setStorageMode(storageMode);
+	options.setLayout(layout);
+	options.setNumThreads(numThreads);
+	options.setAlgorithm(algorithm);
+	return options;
+}
+
+size_t hashBlocks(const labyrinth_core::maze::Maze& maze, size_t numBlocks) {
+	std::vector<std::int32_t> loc (maze.getNumDims(), 0);
+	std::uint32_t* dims = maze.getDimensions();
+	size_t toreturn = 0;
+	for (size_t k = 0; k < numBlocks; k++) {
+		toreturn = toreturn * 131 + maze.getBlock(loc.begin());
+		for (size_t i = loc.size(); i-- > 0;) {
+			if (++loc[i] < static_cast<std::int32_t>(dims[i])) {
+				break;
+			}
+			loc[i] = 0;
+		}
+	}
+	delete[] dims;
+	return toreturn;
+}
+
+size_t countAir(const labyrinth_core::maze::Maze& maze, size_t numBlocks) {
+	std::vector<std::int32_t> loc (maze.getNumDims(), 0);
+	std::uint32_t* dims = maze.getDimensions();
+	size_t toreturn = 0;
+	for (size_t k = 0; k < numBlocks; k++) {
+		if (!maze.isOccupied(maze.getInd(loc.begin()))) {
+			toreturn++;
+		}
+		for (size_t i = loc.size(); i-- > 0;) {
+			if (++loc[i] < static_cast<std::int32_t>(dims[i])) {
+				break;
+			}
+			loc[i] = 0;
+		}
+	}
+	delete[] dims;
+	return toreturn;
+}
+
+// whether there is a path of air from (1, 1, ...) to (dims - 2, ...)
+bool isSolvable(const labyrinth_core::maze::Maze& maze, size_t numBlocks) {
+	size_t numDims = maze.getNumDims();
+	std::uint32_t* dims = maze.getDimensions();
+	std::vector<std::int32_t> loc (numDims, 1);
+	size_t start = maze.getInd(loc.begin());
+	for (size_t i = 0; i < numDims; i++) {
+		loc[i] = dims[i] - 2;
+	}
+	size_t last = maze.getInd(loc.begin());
+	// bricked layouts have more indices than blocks
+	std::vector<bool> isSeen (numBlocks * 2);
+	std::vector<size_t> toVisit {start};
+	isSeen[start] = true;
+	bool toreturn = false;
+	while (!toVisit.empty()) {
+		size_t ind = toVisit.back();
+		toVisit.pop_back();
+		if (ind == last) {
+			toreturn = true;
+			break;
+		}
+		maze.fromInd(ind, loc.begin());
+		for (size_t i = 0; i < numDims; i++) {
+			for (std::int32_t delta: {-1, 1}) {
+				loc[i] += delta;
+				if ((loc[i] >= 0) && (loc[i] < static_cast<std::int32_t>(dims[i]))) {
+					size_t next = maze.getInd(loc.begin());
+					if (!isSeen[next] && !maze.isOccupied(next)) {
+						isSeen[next] = true;
+						toVisit.push_back(next);
+					}
+				}
+				loc[i] -= delta;
+			}
+		}
+	}
+	delete[] dims;
+	return toreturn;
+}
+
+// whether the air is all connected with no loops, and has every block
+// with all odd coordinates in it
+bool isPerfect(const labyrinth_core::maze::Maze& maze, size_t numBlocks) {
+	size_t numDims = maze.getNumDims();
+	std::uint32_t* dims = maze.getDimensions();
+	std::vector<std::int32_t> loc (numDims, 0);
+	size_t numAir = 0, numCells = 0, numCellsAir = 0;
+	for (size_t k = 0; k < numBlocks; k++) {
+		bool isCell = true;
+		for (size_t i = 0; i < numDims; i++) {
+			isCell = isCell && (loc[i] % 2 == 1) &&
+					(loc[i] < static_cast<std::int32_t>(dims[i]) - 1);
+		}
+		bool isAir = !maze.isOccupied(maze.getInd(loc.begin()));
+		numAir += isAir;
+		numCells += isCell;
+		numCellsAir += isCell && isAir;
+		for (size_t i = loc.size(); i-- > 0;) {
+			if (++loc[i] < static_cast<std::int32_t>(dims[i])) {
+				break;
+			}
+			loc[i] = 0;
+		}
+	}
+	std::fill(loc.begin(), loc.end(), 1);
+	size_t start = maze.getInd(loc.begin());
+	std::vector<bool> isSeen (numBlocks * 2);
+	std::vector<size_t> toVisit {start};
+	isSeen[start] = true;
+	size_t numReached = 0, numPairs = 0;
+	while (!toVisit.empty()) {
+		size_t ind = toVisit.back();
+		toVisit.pop_back();
+		numReached++;
+		maze.fromInd(ind, loc.begin());
+		for (size_t i = 0; i < numDims; i++) {
+			for (std::int32_t delta: {-1, 1}) {
+				loc[i] += delta;
+				if ((loc[i] >= 0) && (loc[i] < static_cast<std::int32_t>(dims[i]))) {
+					size_t next = maze.getInd(loc.begin());
+					if (!maze.isOccupied(next)) {
+						// each pair once
+						numPairs += delta > 0;
+						if (!isSeen[next]) {
+							isSeen[next] = true;
+							toVisit.push_back(next);
+						}
+					}
+				}
+				loc[i] -= delta;
+			}
+		}
+	}
+	delete[] dims;
+	return (numCellsAir == numCells) && (numReached == numAir) &&
+			(numPairs + 1 == numAir);
+}
+
+bool testAlgorithms(const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::StorageMode storageMode,
+		labyrinth_core::maze::MazeLayout layout) {
+	size_t numBlocks = 1;
+	for (std::uint32_t dim: dims) {
+		numBlocks *= dim;
+		std::cout << dim << " ";
+	}
+	std::cout << "maze:" << std::endl;
+	const labyrinth_core::maze::MazeAlgorithm algorithms[] = {
+		labyrinth_core::maze::MazeAlgorithm::HEADS,
+		labyrinth_core::maze::MazeAlgorithm::KRUSKAL,
+		labyrinth_core::maze::MazeAlgorithm::BACKTRACKER,
+		labyrinth_core::maze::MazeAlgorithm::WILSON
+	};
+	const char* names[] = {"heads", "kruskal", "backtracker", "wilson"};
+	bool toreturn = true;
+	for (size_t a = 0; a < 4; a++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		labyrinth_core::maze::Maze maze (
+				makeOptions(dims, storageMode, layout, 1, algorithms[a]));
+		double seconds = std::chrono::duration_cast<
+				std::chrono::duration<double>>(
+				std::chrono::high_resolution_clock::now() - start).count();
+		labyrinth_core::maze::Maze again (
+				makeOptions(dims, storageMode, layout, 1, algorithms[a]));
+		bool isSame = hashBlocks(maze, numBlocks) == hashBlocks(again, numBlocks);
+		size_t numCarved = countAir(maze, numBlocks);
+		std::cout << "    " << names[a] << ": " << seconds << "s, " <<
+				numCarved << " cells carved, " << numCarved / seconds <<
+				" cells/s, " << (isSame? "deterministic": "not deterministic");
+		toreturn = toreturn && isSame;
+		if (a > 0) {
+			bool isFine = isPerfect(maze, numBlocks);
+			std::cout << ", " << (isFine? "perfect": "not perfect");
+			toreturn = toreturn && isFine;
+		}
+		std::cout << std::endl;
+	}
+	return toreturn;
+}
+
+void renderFrame(const labyrinth_core::maze::Maze& maze) {
+	const size_t width = 320, height = 240;
+	size_t numDims = maze.getNumDims();
+	std::vector<double> camera (numDims, 1);
+	std::vector<double> forward (numDims, 0.1), right (numDims, 0),
+			up (numDims, 0);
+	forward[0] = 1;
+	right[1] = 1;
+	up[2] = 1;
+	std::vector<std::uint8_t> pixels (width * height * 4);
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera.data(), 4);
+	renderer.render(pixels.data(), forward.data(), right.data(), up.data(),
+			width, height, static_cast<double>(width) / height, 100);
+	renderer.waitForFinished();
+}
+
+// generating a step at a time should give the same maze, telling it
+// about every block carved, and showing a frame long before it is done
+bool testProgress(const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::StorageMode storageMode,
+		labyrinth_core::maze::MazeLayout layout, size_t stepBlocks) {
+	size_t numBlocks = 1;
+	for (std::uint32_t dim: dims) {
+		numBlocks *= dim;
+		std::cout << dim << " ";
+	}
+	std::cout << "maze, every " << stepBlocks << " blocks:" << std::endl;
+	bool toreturn = true;
+	for (size_t numThreads: {1, 4}) {
+		labyrinth_core::maze::Maze::MazeGenerationOptions options =
+				makeOptions(dims, storageMode, layout, numThreads);
+		labyrinth_core::maze::Maze expected (options);
+		size_t numSteps = 0, numBroken = 0;
+		double firstFrameSeconds = 0;
+		bool isFine = true, isDone = false;
+		auto start = std::chrono::high_resolution_clock::now();
+		labyrinth_core::maze::MazeGenerator generator (options);
+		// a copy of what was shown, kept through the step
+		labyrinth_core::maze::Maze before (generator.getMaze());
+		while (!isDone) {
+			isDone = generator.step(stepBlocks);
+			const labyrinth_core::maze::Maze::MazeGenerationProgress& progress =
+					generator.getProgress();
+			isFine = isFine && (progress.isDone == isDone) &&
+					(progress.numBlocksBroken >= numBroken) &&
+					(progress.dirtyLo.size() == dims.size()) &&
+					(progress.dirtyHi.size() == dims.size());
+			for (size_t i = 0; isFine && (i < dims.size()); i++) {
+				isFine = (progress.dirtyLo[i] >= 0) &&
+						(progress.dirtyHi[i] <= static_cast<std::int32_t>(dims[i]));
+			}
+			// nothing outside the dirty box should have changed
+			const labyrinth_core::maze::Maze& shown = generator.getMaze();
+			// and holding on to before only costs the chunks changed
+			isFine = isFine && (shown.getLayout() == (isDone? layout:
+					labyrinth_core::maze::MazeLayout::CHUNKED));
+			std::vector<std::int32_t> loc (dims.size());
+			for (size_t ind = 0; isFine && !isDone && (ind < numBlocks); ind += 7) {
+				bool isInBox = true;
+				for (size_t i = dims.size(), rest = ind; i-- > 0; rest /= dims[i]) {
+					loc[i] = rest % dims[i];
+				}
+				for (size_t i = 0; i < dims.size(); i++) {
+					isInBox = isInBox && (loc[i] >= progress.dirtyLo[i]) &&
+							(loc[i] < progress.dirtyHi[i]);
+				}
+				isFine = isInBox || (shown.getBlock(loc.begin()) ==
+						before.getBlock(loc.begin()));
+			}
+			before = shown;
+			if (numSteps++ == 0) {
+				renderFrame(generator.getMaze());
+				firstFrameSeconds = getSeconds(start);
+			}
+			numBroken = progress.numBlocksBroken;
+		}
+		double seconds = getSeconds(start);
+		bool isSame = (hashBlocks(generator.getMaze(), numBlocks) ==
+				hashBlocks(expected, numBlocks)) && generator.step(stepBlocks);
+		std::cout << "    " << numThreads << " threads: " << numSteps <<
+				" steps, first frame after " << firstFrameSeconds <<
+				"s, done after " << seconds << "s, " <<
+				(isSame? "same": "different") << " maze" << std::endl;
+		toreturn = toreturn && isFine && isSame && (numSteps > 1);
+	}
+	return toreturn;
+}
+
+bool testGeneration(const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::StorageMode storageMode,
+		labyrinth_core::maze::MazeLayout layout) {
+	size_t numBlocks = 1;
+	for (std::uint32_t dim: dims) {
+		numBlocks *= dim;
+		std::cout << dim << " ";
+	}
+	std::cout << "maze:" << std::endl;
+	bool toreturn = true;
+	for (size_t numThreads: {1, 2, 8}) {
+		auto start = std::chrono::high_resolution_clock::now();
+		labyrinth_core::maze::Maze maze (
+				makeOptions(dims, storageMode, layout, numThreads));
+		double seconds = std::chrono::duration_cast<
+				std::chrono::duration<double>>(
+				std::chrono::high_resolution_clock::now() - start).count();
+		labyrinth_core::maze::Maze again (
+				makeOptions(dims, storageMode, layout, numThreads));
+		bool isSame = hashBlocks(maze, numBlocks) == hashBlocks(again, numBlocks);
+		bool isFine = isSolvable(maze, numBlocks);
+		size_t numCarved = countAir(maze, numBlocks);
+		std::cout << "    " << numThreads << " threads: " << seconds << "s, " <<
+				numCarved << " cells carved, " << numCarved / seconds <<
+				" cells/s, " <<
+				(isSame? "deterministic": "not deterministic") << ", " <<
+				(isFine? "solvable": "not solvable") << std::endl;
+		// one thread is the same as it always was,
+		// which doesn't always make it to the end
+		toreturn = toreturn && isSame && (isFine || (numThreads == 1));
+	}
+	return toreturn;
+}
+
+/**
+ * Layers of at least 64 blocks need only 1 layer between slabs, which is
+ * where slabs sharing words would show up, as mazes that come out different
+ * each time, depending on how the threads go.
+ */
+bool testThinBands(const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::StorageMode storageMode, size_t numThreads,
+		size_t numTimes) {
+	size_t numBlocks = 1;
+	for (std::uint32_t dim: dims) {
+		numBlocks *= dim;
+		std::cout << dim << " ";
+	}
+	std::cout << "maze, " << numThreads << " threads, " << numTimes <<
+			" times: ";
+	labyrinth_core::maze::Maze first (makeOptions(dims, storageMode,
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR, numThreads));
+	size_t firstHash = hashBlocks(first, numBlocks);
+	bool toreturn = isSolvable(first, numBlocks);
+	for (size_t k = 1; toreturn && (k < numTimes); k++) {
+		labyrinth_core::maze::Maze maze (makeOptions(dims, storageMode,
+				labyrinth_core::maze::MazeLayout::ROW_MAJOR, numThreads));
+		toreturn = hashBlocks(maze, numBlocks) == firstHash;
+	}
+	std::cout << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testGeneration({1000, 1000},
+			labyrinth_core::maze::StorageMode::BYTE,
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR);
+	isFine = testGeneration({100, 100, 100},
+			labyrinth_core::maze::StorageMode::TRIBIT,
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR) && isFine;
+	isFine = testGeneration({40, 40, 40, 40},
+			labyrinth_core::maze::StorageMode::NIBBLE,
+			labyrinth_core::maze::MazeLayout::BRICKED) && isFine;
+	isFine = testGeneration({64, 64, 64},
+			labyrinth_core::maze::StorageMode::TRIBIT,
+			labyrinth_core::maze::MazeLayout::CHUNKED) && isFine;
+	// too thin to split up much
+	isFine = testGeneration({6, 50, 50},
+			labyrinth_core::maze::StorageMode::BYTE,
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR) && isFine;
+	isFine = testThinBands({400, 64},
+			labyrinth_core::maze::StorageMode::TRIBIT, 32, 50) && isFine;
+	isFine = testThinBands({300, 100},
+			labyrinth_core::maze::StorageMode::BYTE, 16, 50) && isFine;
+	isFine = testAlgorithms({501, 501},
+			labyrinth_core::maze::StorageMode::BYTE,
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR) && isFine;
+	isFine = testAlgorithms({60, 60, 60},
+			labyrinth_core::maze::StorageMode::TRIBIT,
+			labyrinth_core::maze::MazeLayout::BRICKED) && isFine;
+	isFine = testAlgorithms({20, 20, 20, 20},
+			labyrinth_core::maze::StorageMode::NIBBLE,
+			labyrinth_core::maze::MazeLayout::CHUNKED) && isFine;
+	isFine = testProgress({100, 100, 100},
+			labyrinth_core::maze::StorageMode::BYTE,
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR, 10000) && isFine;
+	isFine = testProgress({64, 64, 64},
+			labyrinth_core::maze::StorageMode::TRIBIT,
+			labyrinth_core::maze::MazeLayout::CHUNKED, 5000) && isFine;
+	return isFine? 0: 1;
+}
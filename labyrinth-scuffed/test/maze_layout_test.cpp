@@ -0,0 +1,142 @@
+#include <labyrinth_core/maze/maze_kernel.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// returns -1 if the counter isn't available, like in a lot of containers
+int openCounter(std::uint64_t type, std::uint64_t config) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+std::uint64_t readCounter(int fd) {
+	std::uint64_t toreturn = 0;
+	if ((fd < 0) || (read(fd, &toreturn, sizeof(toreturn)) != sizeof(toreturn))) {
+		return 0;
+	}
+	return toreturn;
+}
+
+// casts a ray along axis from every block of the face where it is 0
+template<size_t N>
+void castAlongAxis(const labyrinth_core::maze::Maze& maze,
+		std::uint32_t width, size_t axis, size_t* numSteps) {
+	std::vector<double> camera (N, 0), direction (N, 0);
+	direction[axis] = 1;
+	labyrinth_core::maze::MazeKernel<N> kernel (maze, camera.data());
+	kernel.setAcceleration(labyrinth_core::maze::Acceleration::NONE);
+	size_t numRays = 1;
+	for (size_t i = 1; i < N; i++) {
+		numRays *= width;
+	}
+	for (size_t ray = 0; ray < numRays; ray++) {
+		size_t rest = ray;
+		for (size_t i = 0; i < N; i++) {
+			if (i == axis) {
+				camera[i] = 0.1;
+			} else {
+				camera[i] = rest % width + 0.1;
+				rest /= width;
+			}
+		}
+		kernel.setCamera(camera.data());
+		*numSteps += kernel(nullptr, direction.data(),
+				labyrinth_core::Color{0, 0, 0, 0xFF}).numSteps;
+	}
+}
+
+template<size_t N>
+void compare(std::uint32_t width) {
+	const labyrinth_core::maze::MazeLayout layouts[] = {
+		labyrinth_core::maze::MazeLayout::ROW_MAJOR,
+		labyrinth_core::maze::MazeLayout::BRICKED
+	};
+	const char* names[] = {"row-major", "bricked"};
+	std::vector<std::uint32_t> dims (N, width);
+	for (size_t l = 0; l < 2; l++) {
+		labyrinth_core::maze::Maze maze (N, dims.data(),
+				labyrinth_core::maze::StorageMode::BYTE, layouts[l]);
+		// thin it out so that rays go a long way,
+		// the same way whatever the layout
+		std::vector<std::int32_t> loc (N, 0);
+		size_t numBlocks = 1;
+		for (size_t i = 0; i < N; i++) {
+			numBlocks *= width;
+		}
+		for (size_t k = 0; k < numBlocks; k++) {
+			if (k % 97 != 0) {
+				maze.setBlock(loc.begin(), 0);
+			}
+			for (size_t i = N; i-- > 0;) {
+				if (++loc[i] < static_cast<std::int32_t>(width)) {
+					break;
+				}
+				loc[i] = 0;
+			}
+		}
+
+		for (size_t axis = 0; axis < N; axis++) {
+			int l1Fd = openCounter(PERF_TYPE_HW_CACHE,
+					PERF_COUNT_HW_CACHE_L1D |
+					(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+					(PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+			int llcFd = openCounter(PERF_TYPE_HARDWARE,
+					PERF_COUNT_HW_CACHE_MISSES);
+			for (int fd: {l1Fd, llcFd}) {
+				if (fd >= 0) {
+					ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+					ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+			size_t numSteps = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			castAlongAxis<N>(maze, width, axis, &numSteps);
+			double seconds = std::chrono::duration_cast<
+					std::chrono::duration<double>>(
+					std::chrono::high_resolution_clock::now() - start).count();
+			for (int fd: {l1Fd, llcFd}) {
+				if (fd >= 0) {
+					ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+				}
+			}
+			std::cout << N << "D, width " << width << ", " << names[l] <<
+					", axis " << axis << ": " << numSteps << " steps, " <<
+					seconds * 1000000000 / numSteps << "ns per step";
+			if ((l1Fd >= 0) && (llcFd >= 0)) {
+				std::cout << ", " <<
+						static_cast<double>(readCounter(l1Fd)) / numSteps <<
+						" L1d misses per step, " <<
+						static_cast<double>(readCounter(llcFd)) / numSteps <<
+						" cache misses per step";
+			} else {
+				std::cout << ", perf counters not available";
+			}
+			std::cout << std::endl;
+			for (int fd: {l1Fd, llcFd}) {
+				if (fd >= 0) {
+					close(fd);
+				}
+			}
+		}
+	}
+}
+
+int main() {
+	compare<3>(320);
+	compare<4>(64);
+}
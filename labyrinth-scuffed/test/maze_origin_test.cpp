@@ -0,0 +1,84 @@
+#include <labyrinth_core/maze/maze_kernel.hpp>
+#include "maze_test_common.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <cmath>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		size_t numDims, std::uint32_t width) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(numDims, width, "origins");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::BACKTRACKER);
+	return options;
+}
+
+// one kernel moved from camera to camera, in and out of the maze, should
+// cast every ray the same as a kernel made at each camera, one ray at a
+// time or in packets
+template<size_t N>
+bool testOrigins(std::uint32_t mazeWidth) {
+	const size_t numRays = 2000, numRepeats = 50, W = 8;
+	labyrinth_core::maze::Maze maze (makeOptions(N, mazeWidth));
+	std::vector<double> camera (N, 1);
+	labyrinth_core::maze::MazeKernel<N> moved (maze, camera.data());
+	std::mt19937 mtrand (N);
+	std::normal_distribution<double> normal;
+	std::uniform_real_distribution<double> uniform (-5, mazeWidth + 5.0);
+	std::vector<double> directions (numRays * N);
+	for (double& value: directions) {
+		value = normal(mtrand);
+	}
+	bool toreturn = true;
+	size_t numHits = 0;
+	double seconds = 0;
+	for (size_t k = 0; k < 20; k++) {
+		for (double& value: camera) {
+			value = uniform(mtrand);
+		}
+		moved.setCamera(camera.data());
+		labyrinth_core::maze::MazeKernel<N> fresh (maze, camera.data());
+		std::vector<std::uint8_t> expected (numRays * 4), output (numRays * 4);
+		std::vector<std::uint8_t> packetOutput (numRays * 4);
+		for (size_t r = 0; r < numRays; r++) {
+			labyrinth_core::maze::RayHit hit = fresh(&expected[r * 4],
+					&directions[r * N], {0, 0, 0, 0xFF});
+			numHits += hit.hit;
+		}
+		// over and over, for long enough to time
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t repeat = 0; repeat < numRepeats; repeat++) {
+			for (size_t r = 0; r < numRays; r++) {
+				moved(&output[r * 4], &directions[r * N], {0, 0, 0, 0xFF});
+			}
+		}
+		seconds += getSeconds(start);
+		double packet[N * W];
+		for (size_t r = 0; r < numRays; r += W) {
+			for (size_t i = 0; i < N; i++) {
+				for (size_t l = 0; l < W; l++) {
+					packet[i * W + l] = directions[(r + l) * N + i];
+				}
+			}
+			moved.template trace<W>(&packetOutput[r * 4], packet,
+					{0, 0, 0, 0xFF});
+		}
+		toreturn = toreturn && (output == expected) &&
+				(packetOutput == expected);
+	}
+	std::cout << N << "D: " << numHits << " hits, " <<
+			20 * numRepeats * numRays / seconds << " rays/s, " <<
+			(toreturn? "fine": "not fine") << std::endl;
+	return toreturn && (numHits > 0);
+}
+
+int main() {
+	bool isFine = testOrigins<3>(15);
+	isFine = testOrigins<4>(9) && isFine;
+	isFine = testOrigins<5>(7) && isFine;
+	return isFine? 0: 1;
+}
@@ -0,0 +1,110 @@
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		size_t numDims, std::uint32_t width) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(numDims, width, "1");
+	return options;
+}
+
+// returns rays per second
+double renderFrames(labyrinth_core::maze::MazeRenderer& renderer,
+		std::uint8_t* output, size_t numDims, size_t width, size_t height) {
+	const size_t numFrames = 10;
+	std::vector<double> forward (numDims), right (numDims), up (numDims);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t frame = 0; frame < numFrames; frame++) {
+		double angle = frame * 0.0174532925199432957692;
+		std::fill(forward.begin(), forward.end(), 0);
+		std::fill(right.begin(), right.end(), 0);
+		std::fill(up.begin(), up.end(), 0);
+		forward[0] = std::cos(angle);
+		forward[1] = std::sin(angle);
+		right[0] = -std::sin(angle);
+		right[1] = std::cos(angle);
+		up[2] = 1;
+		renderer.render(output, forward.data(), right.data(), up.data(),
+				width, height, static_cast<double>(width) / height, 100);
+		renderer.waitForFinished();
+	}
+	double timeSpent = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now() - start).count();
+	return numFrames * width * height * 1000000000 / timeSpent;
+}
+
+bool testPackets(size_t numDims, std::uint32_t mazeWidth) {
+	const size_t width = 1920, height = 1080;
+	labyrinth_core::maze::Maze maze (makeOptions(numDims, mazeWidth));
+	std::vector<double> camera (numDims, 1);
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera.data(), 8);
+	std::vector<std::uint8_t> scalarOutput (width * height * 4);
+	std::vector<std::uint8_t> packetOutput (width * height * 4);
+	double scalarRate = renderFrames(renderer, scalarOutput.data(),
+			numDims, width, height);
+	std::cout << numDims << "D scalar: " << scalarRate << " rays/s" << std::endl;
+	labyrinth_core::maze::MazeRenderer::FrameStats stats =
+			renderer.getLastFrameStats();
+	double idleSeconds = 0;
+	for (double threadIdleSeconds: stats.idleSeconds) {
+		idleSeconds += threadIdleSeconds;
+	}
+	std::cout << "last frame: " << stats.numTiles << " tiles, " <<
+			stats.tilesStolen << " stolen, " << idleSeconds <<
+			"s idle over all threads" << std::endl;
+	bool toreturn = true;
+	for (size_t packetSize: {4, 8, 16}) {
+		toreturn = renderer.setPacketSize(packetSize) && toreturn;
+		double packetRate = renderFrames(renderer, packetOutput.data(),
+				numDims, width, height);
+		bool isSame = scalarOutput == packetOutput;
+		std::cout << numDims << "D packets of " << packetSize << ": " <<
+				packetRate << " rays/s, " <<
+				(isSame? "same as scalar": "DIFFERENT FROM SCALAR") << std::endl;
+		toreturn = toreturn && isSame;
+	}
+	return toreturn;
+}
+
+// whatever skips the air, packets should come out the same as one at a time
+bool testAccelerations() {
+	const size_t width = 480, height = 270;
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeOptions(3, 40);
+	options.setLayout(labyrinth_core::maze::MazeLayout::CHUNKED);
+	labyrinth_core::maze::Maze maze (options);
+	maze.buildDistanceField();
+	maze.buildOccupancyPyramid();
+	double camera[] = {1, 1, 1};
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera, 4);
+	std::vector<std::uint8_t> scalarOutput (width * height * 4);
+	std::vector<std::uint8_t> packetOutput (width * height * 4);
+	bool toreturn = true;
+	for (labyrinth_core::maze::Acceleration acceleration: {
+			labyrinth_core::maze::Acceleration::NONE,
+			labyrinth_core::maze::Acceleration::DISTANCE_FIELD,
+			labyrinth_core::maze::Acceleration::OCCUPANCY_PYRAMID,
+			labyrinth_core::maze::Acceleration::CHUNKS}) {
+		toreturn = renderer.setAcceleration(acceleration) && toreturn;
+		renderer.setPacketSize(1);
+		renderFrames(renderer, scalarOutput.data(), 3, width, height);
+		renderer.setPacketSize(8);
+		renderFrames(renderer, packetOutput.data(), 3, width, height);
+		toreturn = toreturn && (scalarOutput == packetOutput);
+	}
+	std::cout << "accelerated packets: " <<
+			(toreturn? "same as scalar": "DIFFERENT FROM SCALAR") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool success = testPackets(3, 20);
+	success = testPackets(4, 10) && success;
+	success = testAccelerations() && success;
+	return success? 0: 1;
+}
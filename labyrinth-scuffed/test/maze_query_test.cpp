@@ -0,0 +1,299 @@
+#include <labyrinth_core/maze/maze_viewer.hpp>
+#include "maze_test_common.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <cmath>
+#include <cstdlib>
+
+// counts every allocation, to check that moving around doesn't allocate.
+// all of new and delete are replaced, arrays and sized ones too, so that
+// they all go through malloc and free together
+std::atomic<size_t> numAllocations (0);
+
+void* countedNew(size_t size) {
+	numAllocations++;
+	void* toreturn = std::malloc(size? size: 1);
+	if (!toreturn) {
+		throw std::bad_alloc();
+	}
+	return toreturn;
+}
+
+void* operator new(size_t size) {
+	return countedNew(size);
+}
+
+void* operator new[](size_t size) {
+	return countedNew(size);
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		std::uint32_t width) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(3, width, "query");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::BACKTRACKER);
+	return options;
+}
+
+// 9 by 9 by 9 of air, but for a wall at x = 6
+labyrinth_core::maze::Maze makeWall() {
+	std::uint32_t dims[] = {9, 9, 9};
+	labyrinth_core::maze::Maze maze (3, dims);
+	for (std::int32_t x = 0; x < 9; x++) {
+		for (std::int32_t y = 0; y < 9; y++) {
+			for (std::int32_t z = 0; z < 9; z++) {
+				std::int32_t loc[] = {x, y, z};
+				maze.setBlock(loc, (x == 6)? 1: 0);
+			}
+		}
+	}
+	return maze;
+}
+
+// the batch should hit exactly what casting the rays one at a time does
+bool testCast() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	labyrinth_core::maze::MazeQuery query (maze);
+	double origin[] = {1, 1, 1};
+	const size_t numRays = 10000;
+	std::mt19937 mtrand (3);
+	std::normal_distribution<double> distro;
+	std::vector<double> directions (numRays * 3);
+	for (size_t k = 0; k < numRays; k++) {
+		double magnitude = 0;
+		for (size_t i = 0; i < 3; i++) {
+			directions[k * 3 + i] = distro(mtrand);
+			magnitude += directions[k * 3 + i] * directions[k * 3 + i];
+		}
+		for (size_t i = 0; i < 3; i++) {
+			directions[k * 3 + i] /= std::sqrt(magnitude);
+		}
+	}
+	std::vector<labyrinth_core::maze::RayHit> hits (numRays);
+	std::vector<std::int32_t> blocks (numRays * 3);
+	auto start = std::chrono::high_resolution_clock::now();
+	query.cast(origin, directions.data(), numRays, hits.data(), blocks.data());
+	double batchSeconds = getSeconds(start);
+	bool toreturn = true;
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t k = 0; k < numRays; k++) {
+		labyrinth_core::maze::MazeKernel<> kernel (maze, origin);
+		std::int32_t block[3];
+		labyrinth_core::maze::RayHit hit =
+				kernel(nullptr, &directions[k * 3], {0, 0, 0, 0xFF}, block);
+		toreturn = toreturn && (hit.hit == hits[k].hit);
+		if (hit.hit) {
+			toreturn = toreturn && (hit.t == hits[k].t) &&
+					(hit.block == hits[k].block) && (hit.axis == hits[k].axis) &&
+					(hit.face == hits[k].face) && (block[0] == blocks[k * 3]) &&
+					(block[1] == blocks[k * 3 + 1]) &&
+					(block[2] == blocks[k * 3 + 2]);
+		}
+	}
+	double kernelSeconds = getSeconds(start);
+	std::cout << "cast: " << batchSeconds << "s batched, " << kernelSeconds <<
+			"s with a kernel per ray, " << (toreturn? "fine": "not fine") <<
+			std::endl;
+	return toreturn;
+}
+
+// the middle of a slice looking straight at the wall should be the wall
+bool testPick() {
+	labyrinth_core::maze::Maze maze = makeWall();
+	labyrinth_core::maze::MazeViewer::ViewerOptions options (3);
+	options.addSlice(labyrinth_core::maze::MazeViewer::Slice(3, 100, 80));
+	double camera[] = {2, 4, 4};
+	labyrinth_core::maze::MazeViewer viewer (maze, options, camera);
+	std::int32_t block[3];
+	labyrinth_core::maze::RayHit hit = viewer.pick(0, 50, 40, block);
+	bool toreturn = hit.hit && (std::abs(hit.t - 3.5) < 1e-5) &&
+			(hit.axis == 0) && (hit.face == -1) &&
+			(block[0] == 6) && (block[1] == 4) && (block[2] == 4);
+	// up and to the right, it's still the wall, but further up and right
+	hit = viewer.pick(0, 99, 0, block);
+	toreturn = toreturn && hit.hit && (block[0] == 6) && (block[1] > 4) &&
+			(block[2] > 4);
+	// and there's nothing behind
+	viewer.rotateRight(180);
+	hit = viewer.pick(0, 50, 40, block);
+	toreturn = toreturn && !hit.hit;
+	std::cout << "pick: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+// walking into the wall at an angle should slide along it
+bool testSlide() {
+	labyrinth_core::maze::Maze maze = makeWall();
+	labyrinth_core::maze::MazeQuery query (maze);
+	double position[] = {2, 4, 4};
+	double displacement[] = {10, 1, -0.5};
+	bool isBlocked = query.move(position, displacement, 0.2);
+	bool toreturn = isBlocked && (position[0] < 5.3) &&
+			(position[0] > 5.3 - 1e-5) && (position[1] == 5) &&
+			(position[2] == 3.5);
+	// and then away from it
+	double away[] = {-10, 0, 0};
+	isBlocked = query.move(position, away, 0.2);
+	toreturn = toreturn && !isBlocked && (std::abs(position[0] + 4.7) < 1e-5);
+	// and from the other side
+	double other[] = {8, 4, 4};
+	double back[] = {-3, 0, 0};
+	isBlocked = query.move(other, back, 0.2);
+	toreturn = toreturn && isBlocked && (other[0] > 6.7) &&
+			(other[0] < 6.7 + 1e-5);
+	std::cout << "slide: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+// a sphere should slide along the wall the same as the box does, but
+// round the edge of a lone block that the box would catch on
+bool testSphere() {
+	labyrinth_core::maze::Maze maze = makeWall();
+	labyrinth_core::maze::MazeQuery query (maze);
+	double position[] = {2, 4, 4};
+	double displacement[] = {10, 1, -0.5};
+	bool isBlocked = query.moveSphere(position, displacement, 0.2);
+	bool toreturn = isBlocked && (position[0] < 5.3) &&
+			(position[0] > 5.3 - 1e-5) && (std::abs(position[1] - 5) < 1e-9) &&
+			(std::abs(position[2] - 3.5) < 1e-9);
+	std::uint32_t dims[] = {9, 9, 9};
+	labyrinth_core::maze::Maze lone (3, dims);
+	for (std::int32_t x = 0; x < 9; x++) {
+		for (std::int32_t y = 0; y < 9; y++) {
+			for (std::int32_t z = 0; z < 9; z++) {
+				std::int32_t loc[] = {x, y, z};
+				lone.setBlock(loc, ((x == 4) && (y == 4) && (z == 4))? 1: 0);
+			}
+		}
+	}
+	// setting the maze shouldn't make the kernel again: the one
+	// allocation is the copy of the dimensions getDimensions makes
+	size_t allocationsBefore = numAllocations;
+	query.setMaze(lone);
+	toreturn = toreturn && (numAllocations - allocationsBefore <= 1);
+	// past the edge, 0.16 out along y and z: 0.23 from it, but
+	// the box reaches 0.04 into the block along both
+	double pastSphere[] = {2, 4.66, 4.66};
+	double pastBox[] = {2, 4.66, 4.66};
+	double along[] = {5, 0, 0};
+	toreturn = toreturn && !query.moveSphere(pastSphere, along, 0.2) &&
+			(std::abs(pastSphere[0] - 7) < 1e-9) &&
+			query.move(pastBox, along, 0.2) && (pastBox[0] < 3.3);
+	// and clipping the edge pushes it out around it
+	double clip[] = {2, 4.6, 4.6};
+	toreturn = toreturn && query.moveSphere(clip, along, 0.2) &&
+			(clip[0] > 6.9) && (clip[1] > 4.6) &&
+			(clip[2] > 4.6);
+	std::cout << "sphere: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+// whether a box of radius around position is clear of every block
+bool isClear(const labyrinth_core::maze::Maze& maze, const double* position,
+		double radius) {
+	std::int32_t low[3], high[3];
+	for (size_t i = 0; i < 3; i++) {
+		low[i] = std::max(0.0, std::floor(position[i] - radius + 0.5));
+		high[i] = std::min(40.0, std::ceil(position[i] + radius + 0.5) - 1);
+	}
+	for (std::int32_t x = low[0]; x <= high[0]; x++) {
+		for (std::int32_t y = low[1]; y <= high[1]; y++) {
+			for (std::int32_t z = low[2]; z <= high[2]; z++) {
+				std::int32_t loc[] = {x, y, z};
+				if (maze.isOccupied(maze.getInd(loc))) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// wandering around a maze, with a few keys held at once, should never
+// get the camera into a wall, nor allocate anything
+bool testWander() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	labyrinth_core::maze::MazeViewer::ViewerOptions options (3);
+	options.addSlice(labyrinth_core::maze::MazeViewer::Slice(3, 100, 80));
+	options.addSlice(labyrinth_core::maze::MazeViewer::Slice(3, 100, 80));
+	double camera[] = {1, 1, 1};
+	labyrinth_core::maze::MazeViewer viewer (maze, options, camera);
+	std::mt19937 mtrand (8);
+	std::uniform_real_distribution<double> distro (0, 1);
+	bool toreturn = true;
+	size_t allocationsBefore = numAllocations;
+	auto start = std::chrono::high_resolution_clock::now();
+	const size_t numFrames = 100000;
+	for (size_t frame = 0; frame < numFrames; frame++) {
+		double amount = distro(mtrand) * 0.3;
+		switch (mtrand() % 6) {
+		case 0:
+			viewer.moveForward(amount);
+			viewer.moveRight(amount);
+			break;
+		case 1:
+			viewer.moveBackwards(amount);
+			viewer.moveLeft(amount);
+			break;
+		case 2:
+			viewer.moveUp(amount);
+			viewer.moveDown(amount / 2);
+			break;
+		case 3:
+			viewer.rotateRight(amount * 300);
+			viewer.moveForward(amount);
+			break;
+		case 4:
+			viewer.rotateUp(amount * 300);
+			viewer.moveForward(amount);
+			break;
+		default:
+			viewer.rotateClockwise(amount * 300);
+			viewer.moveLeft(amount);
+			break;
+		}
+		toreturn = toreturn && isClear(maze, viewer.getCamera(), 0.2 - 1e-7);
+	}
+	double seconds = getSeconds(start);
+	size_t allocations = numAllocations - allocationsBefore;
+	toreturn = toreturn && (allocations == 0);
+	const double* end = viewer.getCamera();
+	std::cout << "wander: " << numFrames / seconds << " frames/s, " <<
+			allocations << " allocations, ended up at (" << end[0] << ", " <<
+			end[1] << ", " << end[2] << "), " <<
+			(toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testCast();
+	isFine = testPick() && isFine;
+	isFine = testSlide() && isFine;
+	isFine = testSphere() && isFine;
+	isFine = testWander() && isFine;
+	return isFine? 0: 1;
+}
@@ -0,0 +1,143 @@
+#include <labyrinth_core/maze/maze.hpp>
+#include <labyrinth_core/maze/maze_random.hpp>
+#include "maze_test_common.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// the known answers that come with Random123
+bool testKnownAnswers() {
+	const std::uint32_t inputs[3][6] = {
+		{0, 0, 0, 0, 0, 0},
+		{0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF},
+		{0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344, 0xA4093822, 0x299F31D0}
+	};
+	const std::uint32_t outputs[3][4] = {
+		{0x6627E8D5, 0xE169C58D, 0xBC57AC4C, 0x9B00DBD8},
+		{0x408F276D, 0x41C83B0E, 0xA20BC7C6, 0x6D5451FD},
+		{0xD16CFE09, 0x94FDCCEB, 0x5001E420, 0x24126EA1}
+	};
+	bool toreturn = true;
+	for (size_t i = 0; i < 3; i++) {
+		std::uint32_t ctr[4] = {inputs[i][0], inputs[i][1],
+				inputs[i][2], inputs[i][3]};
+		labyrinth_core::maze::Philox::scramble(ctr, inputs[i] + 4);
+		for (size_t j = 0; j < 4; j++) {
+			toreturn = toreturn && (ctr[j] == outputs[i][j]);
+		}
+	}
+	std::cout << "known answers " << (toreturn? "right": "wrong") << std::endl;
+	return toreturn;
+}
+
+// generate should give the same words as scramble does one at a time,
+// wherever it starts, and fast
+bool testBlocks() {
+	std::seed_seq seq {1, 2, 3};
+	labyrinth_core::maze::Philox philox;
+	philox.seed(seq);
+	std::uint32_t key[2];
+	seq.generate(key, key + 2);
+	const size_t numCounters = 1 << 20;
+	std::vector<std::uint32_t> words (numCounters * 4);
+	auto start = std::chrono::high_resolution_clock::now();
+	philox.generate(0, numCounters, words.data());
+	double seconds = getSeconds(start);
+	std::vector<std::uint32_t> later (13 * 4);
+	philox.generate(numCounters - 13, 13, later.data());
+	bool toreturn = true;
+	for (std::uint64_t counter: {static_cast<std::uint64_t>(0),
+			static_cast<std::uint64_t>(12345), numCounters - 1}) {
+		std::uint32_t ctr[4] = {static_cast<std::uint32_t>(counter), 0, 1, 0};
+		labyrinth_core::maze::Philox::scramble(ctr, key);
+		for (size_t j = 0; j < 4; j++) {
+			toreturn = toreturn && (words[counter * 4 + j] == ctr[j]);
+		}
+	}
+	for (size_t j = 0; j < later.size(); j++) {
+		toreturn = toreturn && (later[j] == words[(numCounters - 13) * 4 + j]);
+	}
+	std::cout << "blocks: " << numCounters * 16 / seconds / 1e9 <<
+			" GB/s on 1 thread, " << (toreturn? "right": "wrong") << std::endl;
+	return toreturn;
+}
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::StorageMode storageMode,
+		labyrinth_core::maze::MazeLayout layout,
+		labyrinth_core::maze::RandomEngine randomEngine) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(dims, "random test");
+	options.setStorageMode(storageMode);
+	options.setLayout(layout);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::BACKTRACKER);
+	options.setRandomEngine(randomEngine);
+	return options;
+}
+
+size_t countDifferent(const labyrinth_core::maze::Maze& a,
+		const labyrinth_core::maze::Maze& b,
+		const std::vector<std::uint32_t>& dims) {
+	std::vector<std::int32_t> loc (dims.size(), 0);
+	size_t numBlocks = 1;
+	for (std::uint32_t dim: dims) {
+		numBlocks *= dim;
+	}
+	size_t toreturn = 0;
+	for (size_t k = 0; k < numBlocks; k++) {
+		if ((a.getBlock(loc.begin()) != b.getBlock(loc.begin())) ||
+				(a.isOccupied(a.getInd(loc.begin())) !=
+						b.isOccupied(b.getInd(loc.begin())))) {
+			toreturn++;
+		}
+		for (size_t i = loc.size(); i-- > 0;) {
+			if (++loc[i] < static_cast<std::int32_t>(dims[i])) {
+				break;
+			}
+			loc[i] = 0;
+		}
+	}
+	return toreturn;
+}
+
+// the walls should only depend on the seed, and not on how they are packed,
+// and Philox should fill them in much faster
+bool testFill(const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::MazeLayout layout) {
+	for (std::uint32_t dim: dims) {
+		std::cout << dim << " ";
+	}
+	std::cout << "maze:" << std::endl;
+	bool toreturn = true;
+	for (labyrinth_core::maze::RandomEngine randomEngine: {
+			labyrinth_core::maze::RandomEngine::MT19937,
+			labyrinth_core::maze::RandomEngine::PHILOX}) {
+		auto start = std::chrono::high_resolution_clock::now();
+		labyrinth_core::maze::Maze maze (makeOptions(dims,
+				labyrinth_core::maze::StorageMode::BYTE, layout, randomEngine));
+		double seconds = getSeconds(start);
+		labyrinth_core::maze::Maze packed (makeOptions(dims,
+				labyrinth_core::maze::StorageMode::TRIBIT, layout, randomEngine));
+		size_t numDifferent = countDifferent(maze, packed, dims);
+		std::cout << "    " <<
+				((randomEngine == labyrinth_core::maze::RandomEngine::PHILOX)?
+						"philox": "mt19937") << ": " << seconds << "s, " <<
+				numDifferent << " blocks different packed" << std::endl;
+		toreturn = toreturn && (numDifferent == 0);
+	}
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testKnownAnswers();
+	isFine = testBlocks() && isFine;
+	isFine = testFill({4001, 4001},
+			labyrinth_core::maze::MazeLayout::ROW_MAJOR) && isFine;
+	isFine = testFill({201, 201, 201},
+			labyrinth_core::maze::MazeLayout::BRICKED) && isFine;
+	isFine = testFill({41, 41, 41, 41},
+			labyrinth_core::maze::MazeLayout::CHUNKED) && isFine;
+	return isFine? 0: 1;
+}
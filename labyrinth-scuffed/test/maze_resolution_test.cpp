@@ -0,0 +1,136 @@
+#include <labyrinth_core/maze/maze_viewer.hpp>
+#include "maze_test_common.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <cmath>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		std::uint32_t width) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(3, width, "resolution");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::BACKTRACKER);
+	return options;
+}
+
+// renders numFrames frames, turning a bit each time, and
+// returns the median of how long they took
+double renderFrames(labyrinth_core::maze::MazeViewer& viewer,
+		size_t numFrames) {
+	std::vector<double> seconds;
+	for (size_t frame = 0; frame < numFrames; frame++) {
+		viewer.rotateRight(0.5);
+		viewer.render();
+		seconds.push_back(viewer.getLastFrameStats().frameSeconds);
+	}
+	std::sort(seconds.begin(), seconds.end());
+	return seconds[seconds.size() / 2];
+}
+
+// with a target a quarter of what full size takes, slices should get
+// rendered smaller until they keep to it, and then stay that size
+bool testTarget() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	labyrinth_core::maze::MazeViewer::ViewerOptions options (3);
+	options.addSlice(labyrinth_core::maze::MazeViewer::Slice(3, 1200, 900));
+	options.setNumThreads(4);
+	double camera[] = {1, 1, 1};
+	labyrinth_core::maze::MazeViewer viewer (maze, options, camera);
+	double fullSeconds = renderFrames(viewer, 5);
+	double target = fullSeconds / 4;
+	viewer.setTargetFrameSeconds(target);
+	renderFrames(viewer, 30);
+	double scale = viewer.getResolutionScale(0);
+	// now it's found what keeps to it, it shouldn't keep changing
+	size_t numChanges = 0;
+	std::vector<double> seconds;
+	for (size_t frame = 0; frame < 30; frame++) {
+		viewer.rotateRight(0.5);
+		viewer.render();
+		seconds.push_back(viewer.getLastFrameStats().frameSeconds);
+		numChanges += viewer.getResolutionScale(0) != scale;
+		scale = viewer.getResolutionScale(0);
+	}
+	std::sort(seconds.begin(), seconds.end());
+	double scaledSeconds = seconds[seconds.size() / 2];
+	const labyrinth_core::maze::MazeViewer::Frame* frame = viewer.getFrame();
+	// the frame is what got rendered, smaller than the slice
+	bool toreturn = (scale < 0.8) && (scale > 0.25) &&
+			(std::abs(scaledSeconds / target - 1) < 0.5) && (numChanges <= 3) &&
+			(frame->getWidth(0) < 1200) && (viewer.getSliceSizes()[0].first == 1200);
+	// and without the target, it's all of it again
+	viewer.setTargetFrameSeconds(0);
+	viewer.render();
+	toreturn = toreturn && (viewer.getFrame()->getWidth(0) == 1200) &&
+			(viewer.getFrame()->getHeight(0) == 900);
+	std::cout << "target: " << fullSeconds * 1000 << "ms at full size, " <<
+			scaledSeconds * 1000 << "ms at " << scale << " for " <<
+			target * 1000 << "ms, changed " << numChanges << " times in 30 frames, " <<
+			(toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+// once there's time to spare, it should go back up, a bit at a time
+bool testRaise() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	labyrinth_core::maze::MazeViewer::ViewerOptions options (3);
+	options.addSlice(labyrinth_core::maze::MazeViewer::Slice(3, 400, 300));
+	options.setNumThreads(4);
+	options.setTargetFrameSeconds(1e-6);
+	double camera[] = {1, 1, 1};
+	labyrinth_core::maze::MazeViewer viewer (maze, options, camera);
+	renderFrames(viewer, 3);
+	double lowest = viewer.getResolutionScale(0);
+	viewer.setTargetFrameSeconds(10);
+	size_t numFrames = 0;
+	double last = lowest;
+	bool isGradual = true;
+	while ((viewer.getResolutionScale(0) < 1) && (numFrames < 200)) {
+		renderFrames(viewer, 1);
+		numFrames++;
+		isGradual = isGradual && (viewer.getResolutionScale(0) <= last * 1.1 + 1e-9);
+		last = viewer.getResolutionScale(0);
+	}
+	bool toreturn = (lowest == 0.25) && isGradual &&
+			(viewer.getResolutionScale(0) == 1) && (numFrames > 8);
+	std::cout << "raise: down to " << lowest << ", back up in " << numFrames <<
+			" frames, " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+// outside the maze, a slice looking at it should get scaled down
+// further than one looking away, where every ray misses straight away
+bool testSlices() {
+	labyrinth_core::maze::Maze maze (makeOptions(41));
+	labyrinth_core::maze::MazeViewer::ViewerOptions options (3);
+	labyrinth_core::maze::MazeViewer::Slice toward (3, 800, 600);
+	labyrinth_core::maze::MazeViewer::Slice away (3, 800, 600);
+	double backwards[] = {-1, 0, 0};
+	away.setForward(backwards);
+	options.addSlice(toward);
+	options.addSlice(away);
+	options.setNumThreads(4);
+	double camera[] = {-3, 20, 20};
+	labyrinth_core::maze::MazeViewer viewer (maze, options, camera);
+	viewer.render();
+	viewer.setTargetFrameSeconds(viewer.getLastFrameStats().frameSeconds / 3);
+	for (size_t frame = 0; frame < 20; frame++) {
+		viewer.render();
+	}
+	bool toreturn = viewer.getResolutionScale(0) <
+			viewer.getResolutionScale(1);
+	std::cout << "slices: " << viewer.getResolutionScale(0) << " looking at it, " <<
+			viewer.getResolutionScale(1) << " looking away, " <<
+			(toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testTarget();
+	isFine = testRaise() && isFine;
+	isFine = testSlices() && isFine;
+	return isFine? 0: 1;
+}
@@ -0,0 +1,206 @@
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		size_t numDims, std::uint32_t width,
+		labyrinth_core::maze::MazeLayout layout) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(numDims, width, "snapshots");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setLayout(layout);
+	options.setAlgorithm(labyrinth_core::maze::MazeAlgorithm::BACKTRACKER);
+	return options;
+}
+
+std::vector<std::uint8_t> getBlocks(const labyrinth_core::maze::Maze& maze) {
+	std::vector<std::uint8_t> toreturn;
+	size_t numDims = maze.getNumDims();
+	std::uint32_t* dims = maze.getDimensions();
+	std::vector<std::int32_t> loc (numDims, 0);
+	while (true) {
+		size_t ind = maze.getInd(loc.begin());
+		toreturn.push_back(maze.getBlock(ind));
+		toreturn.push_back(maze.isOccupied(ind));
+		toreturn.push_back(maze.getEmptyRadius(ind));
+		size_t i = numDims;
+		while (i-- > 0) {
+			if (++loc[i] < static_cast<std::int32_t>(dims[i])) {
+				break;
+			}
+			loc[i] = 0;
+		}
+		if (i >= numDims) {
+			break;
+		}
+	}
+	delete[] dims;
+	return toreturn;
+}
+
+// changes every 7th block of the middle layer along the first axis
+void scribble(labyrinth_core::maze::Maze& maze, std::uint8_t block) {
+	size_t numDims = maze.getNumDims();
+	std::uint32_t* dims = maze.getDimensions();
+	std::vector<std::int32_t> loc (numDims, 1);
+	loc[0] = dims[0] / 2;
+	for (size_t k = 0; loc[1] < static_cast<std::int32_t>(dims[1]) - 1; k++) {
+		if (k % 7 == 0) {
+			maze.setBlock(loc.begin(), block);
+		}
+		for (size_t i = numDims; i-- > 1;) {
+			if (++loc[i] < static_cast<std::int32_t>(dims[i]) - 1) {
+				break;
+			}
+			if (i > 1) {
+				loc[i] = 1;
+			}
+		}
+	}
+	delete[] dims;
+}
+
+// a copy shouldn't see anything done to the maze after it was made,
+// and the maze should see all of it
+bool testCopies(labyrinth_core::maze::MazeLayout layout, const char* name) {
+	labyrinth_core::maze::Maze maze (makeOptions(3, 61, layout));
+	maze.buildDistanceField(4);
+	maze.buildOccupancyPyramid();
+	std::vector<std::uint8_t> before = getBlocks(maze);
+	auto start = std::chrono::high_resolution_clock::now();
+	const labyrinth_core::maze::Maze copy (maze);
+	double copySeconds = getSeconds(start);
+	size_t bytesBefore = maze.getNumBytes();
+	start = std::chrono::high_resolution_clock::now();
+	scribble(maze, 5);
+	double scribbleSeconds = getSeconds(start);
+	// a second copy, of the changed maze, for the next changes
+	labyrinth_core::maze::Maze second (maze);
+	std::vector<std::uint8_t> changed = getBlocks(maze);
+	maze.setStorageMode(labyrinth_core::maze::StorageMode::BYTE);
+	scribble(maze, 0);
+	// the same changes, made to a maze that was never copied
+	labyrinth_core::maze::Maze fresh (makeOptions(3, 61, layout));
+	fresh.buildDistanceField(4);
+	fresh.buildOccupancyPyramid();
+	scribble(fresh, 5);
+	scribble(fresh, 0);
+
+	bool toreturn = (getBlocks(copy) == before) &&
+			(getBlocks(second) == changed) && (changed != before) &&
+			(getBlocks(maze) == getBlocks(fresh)) &&
+			(copy.getStorageMode() ==
+					labyrinth_core::maze::StorageMode::TRIBIT) &&
+			(copy.getNumBytes() == bytesBefore);
+	std::vector<std::int32_t> corner (3, 1);
+	std::vector<std::int32_t> farCorner (3, 59);
+	const labyrinth_core::maze::OccupancyPyramid* pyramid =
+			maze.getOccupancyPyramid();
+	const labyrinth_core::maze::OccupancyPyramid* freshPyramid =
+			fresh.getOccupancyPyramid();
+	for (size_t level = 0; level < pyramid->getNumLevels(); level++) {
+		toreturn = toreturn &&
+				(pyramid->isOccupied(level, corner.data()) ==
+						freshPyramid->isOccupied(level, corner.data())) &&
+				(pyramid->isOccupied(level, farCorner.data()) ==
+						freshPyramid->isOccupied(level, farCorner.data()));
+	}
+	std::cout << name << ": copied in " << copySeconds << "s, changed in " <<
+			scribbleSeconds << "s, " << (toreturn? "fine": "not fine") <<
+			std::endl;
+	return toreturn;
+}
+
+// the first change after a copy should be quick, only copying the bits of
+// the distance field and the occupancy pyramid it changes, and changes
+// should leave the distances as if they had been worked out from scratch
+bool testDistances(size_t numDims, std::uint32_t width,
+		std::uint8_t maxDistance) {
+	labyrinth_core::maze::Maze maze (makeOptions(numDims, width,
+			labyrinth_core::maze::MazeLayout::BRICKED));
+	auto start = std::chrono::high_resolution_clock::now();
+	maze.buildDistanceField(maxDistance);
+	maze.buildOccupancyPyramid();
+	double buildSeconds = getSeconds(start);
+	const labyrinth_core::maze::Maze copy (maze);
+	std::vector<std::uint8_t> before = getBlocks(copy);
+	std::vector<std::int32_t> middle (numDims, width / 2 | 1);
+	start = std::chrono::high_resolution_clock::now();
+	maze.setBlock(middle.begin(), copy.getBlock(middle.begin())? 0: 5);
+	double firstSeconds = getSeconds(start);
+	scribble(maze, 5);
+	scribble(maze, 0);
+	labyrinth_core::maze::Maze rebuilt (maze);
+	rebuilt.buildDistanceField(maxDistance);
+	bool toreturn = (getBlocks(maze) == getBlocks(rebuilt)) &&
+			(getBlocks(copy) == before);
+	std::cout << numDims << "D distances: built in " << buildSeconds <<
+			"s, first change after a copy in " << firstSeconds << "s, " <<
+			(toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+std::vector<std::uint8_t> renderFrame(
+		labyrinth_core::maze::MazeRenderer& renderer, size_t numDims) {
+	const size_t width = 160, height = 120;
+	std::vector<double> forward (numDims, 0.1), right (numDims, 0),
+			up (numDims, 0);
+	forward[0] = 1;
+	right[1] = 1;
+	up[2] = 1;
+	std::vector<std::uint8_t> toreturn (width * height * 4);
+	renderer.render(toreturn.data(), forward.data(), right.data(), up.data(),
+			width, height, static_cast<double>(width) / height, 200);
+	renderer.waitForFinished();
+	return toreturn;
+}
+
+// renderers made from the maze should keep rendering the same thing while
+// the maze gets changed on another thread
+bool testRendering(labyrinth_core::maze::MazeLayout layout, const char* name) {
+	labyrinth_core::maze::Maze maze (makeOptions(3, 61, layout));
+	std::vector<double> camera (3, 1.5);
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera.data(), 4);
+	std::vector<std::uint8_t> expected = renderFrame(renderer, 3);
+	std::atomic<bool> isEditing (true);
+	size_t numEdits = 0;
+	std::thread editor ([&maze, &isEditing, &numEdits] () -> void {
+		for (std::uint8_t block = 0; isEditing; block = (block + 1) % 3) {
+			scribble(maze, block);
+			// nor should copying it, which shares the same blocks
+			labyrinth_core::maze::Maze copy (maze);
+			numEdits++;
+		}
+	});
+	bool toreturn = true;
+	for (size_t frame = 0; frame < 20; frame++) {
+		toreturn = toreturn && (renderFrame(renderer, 3) == expected);
+	}
+	isEditing = false;
+	editor.join();
+	toreturn = toreturn && (numEdits > 0);
+	std::cout << name << ": rendered while making " << numEdits <<
+			" rounds of changes, " << (toreturn? "fine": "not fine") <<
+			std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testCopies(labyrinth_core::maze::MazeLayout::ROW_MAJOR,
+			"row major");
+	isFine = testCopies(labyrinth_core::maze::MazeLayout::CHUNKED,
+			"chunked") && isFine;
+	isFine = testDistances(3, 201, 8) && isFine;
+	// taking out a wall in 4D works out (4 * 4 + 1)^4 distances again
+	isFine = testDistances(4, 31, 4) && isFine;
+	isFine = testRendering(labyrinth_core::maze::MazeLayout::BRICKED,
+			"bricked") && isFine;
+	isFine = testRendering(labyrinth_core::maze::MazeLayout::CHUNKED,
+			"chunked") && isFine;
+	return isFine? 0: 1;
+}
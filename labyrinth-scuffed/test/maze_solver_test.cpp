@@ -0,0 +1,123 @@
+#include <labyrinth_core/maze/maze.hpp>
+#include "maze_test_common.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <cstdlib>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::MazeAlgorithm algorithm, size_t numThreads) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(dims, "solver test");
+	options.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT);
+	options.setNumThreads(numThreads);
+	options.setAlgorithm(algorithm);
+	return options;
+}
+
+// whether path is air all the way, goes one step at a time from (1, 1, ...)
+// to the outside, and agrees with the distances
+bool isPathFine(const labyrinth_core::maze::Maze& maze,
+		const labyrinth_core::maze::Maze::MazeSolution& solution) {
+	const std::vector<size_t>& path = solution.path;
+	size_t numDims = maze.getNumDims();
+	std::uint32_t* dims = maze.getDimensions();
+	std::vector<std::int32_t> loc (numDims), prevLoc (numDims);
+	bool toreturn = !path.empty();
+	for (size_t k = 0; toreturn && (k < path.size()); k++) {
+		maze.fromInd(path[k], loc.begin());
+		toreturn = !maze.isOccupied(path[k]) &&
+				(solution.distances[path[k]] == k);
+		if (k == 0) {
+			for (size_t i = 0; i < numDims; i++) {
+				toreturn = toreturn && (loc[i] == 1);
+			}
+		} else {
+			std::int32_t numSteps = 0;
+			for (size_t i = 0; i < numDims; i++) {
+				numSteps += std::abs(loc[i] - prevLoc[i]);
+			}
+			toreturn = toreturn && (numSteps == 1);
+		}
+		prevLoc = loc;
+	}
+	bool isOutside = false;
+	for (size_t i = 0; toreturn && (i < numDims); i++) {
+		isOutside = isOutside || (loc[i] == 0) ||
+				(loc[i] == static_cast<std::int32_t>(dims[i] - 1));
+	}
+	delete[] dims;
+	return toreturn && isOutside;
+}
+
+bool testSolve(const std::vector<std::uint32_t>& dims,
+		labyrinth_core::maze::MazeAlgorithm algorithm, const char* name,
+		size_t numGenThreads) {
+	for (std::uint32_t dim: dims) {
+		std::cout << dim << " ";
+	}
+	std::cout << name << " maze:" << std::endl;
+	labyrinth_core::maze::Maze maze (makeOptions(dims, algorithm,
+			numGenThreads));
+	bool toreturn = true;
+	labyrinth_core::maze::Maze::MazeSolution first;
+	for (size_t numThreads: {1, 2, 8}) {
+		auto start = std::chrono::high_resolution_clock::now();
+		labyrinth_core::maze::Maze::MazeSolution solution =
+				maze.solve(numThreads);
+		double seconds = getSeconds(start);
+		bool isFine = isPathFine(maze, solution);
+		bool isSame = (numThreads == 1) ||
+				((solution.distances == first.distances) &&
+						(solution.path == first.path));
+		std::cout << "    " << numThreads << " threads: " << seconds <<
+				"s, " << solution.numReached / seconds << " blocks/s, path " <<
+				solution.path.size() << " long, " << solution.numReached <<
+				" reached, farthest " << solution.maxDistance << " away, " <<
+				(isFine? "fine": "not fine") << ", " <<
+				(isSame? "same": "different") << std::endl;
+		if (numThreads == 1) {
+			first = solution;
+		}
+		toreturn = toreturn && isFine && isSame;
+	}
+	return toreturn;
+}
+
+// a maze with no way out has no path, but still has distances
+bool testNoExit() {
+	std::uint32_t dims[] = {9, 9, 9};
+	labyrinth_core::maze::Maze maze (3, dims);
+	for (std::int32_t x = 0; x < 9; x++) {
+		for (std::int32_t y = 0; y < 9; y++) {
+			for (std::int32_t z = 0; z < 9; z++) {
+				std::int32_t loc[] = {x, y, z};
+				bool isInside = (x > 0) && (x < 8) && (y > 0) && (y < 8) &&
+						(z > 0) && (z < 8);
+				maze.setBlock(loc, isInside? 0: 1);
+			}
+		}
+	}
+	labyrinth_core::maze::Maze::MazeSolution solution = maze.solve();
+	bool toreturn = solution.path.empty() && (solution.numReached == 343) &&
+			(solution.maxDistance == 18);
+	std::cout << "no exit: " << (toreturn? "fine": "not fine") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testNoExit();
+	isFine = testSolve({3000, 3000},
+			labyrinth_core::maze::MazeAlgorithm::KRUSKAL, "kruskal", 1) && isFine;
+	isFine = testSolve({3000, 3000},
+			labyrinth_core::maze::MazeAlgorithm::BACKTRACKER, "backtracker", 1) &&
+			isFine;
+	isFine = testSolve({40, 40, 40, 40},
+			labyrinth_core::maze::MazeAlgorithm::HEADS, "heads", 8) && isFine;
+	isFine = testSolve({40, 40, 40, 40},
+			labyrinth_core::maze::MazeAlgorithm::WILSON, "wilson", 1) && isFine;
+	return isFine? 0: 1;
+}
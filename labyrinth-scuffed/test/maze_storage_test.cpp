@@ -0,0 +1,122 @@
+#include <labyrinth_core/maze/maze_renderer.hpp>
+#include "maze_test_common.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+labyrinth_core::maze::Maze::MazeGenerationOptions makeOptions(
+		size_t numDims, std::uint32_t width,
+		labyrinth_core::maze::StorageMode storageMode) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options =
+			makeTestOptions(numDims, width, "1");
+	options.setStorageMode(storageMode);
+	return options;
+}
+
+// returns seconds per frame
+double timeFrames(const labyrinth_core::maze::Maze& maze,
+		std::uint8_t* output) {
+	const size_t numFrames = 10;
+	const size_t width = 1920, height = 1080;
+	size_t numDims = maze.getNumDims();
+	std::vector<double> camera (numDims, 1);
+	std::vector<double> forward (numDims, 0.1), right (numDims, 0),
+			up (numDims, 0);
+	forward[0] = 1;
+	right[1] = 1;
+	up[2] = 1;
+	labyrinth_core::maze::MazeRenderer renderer (maze, camera.data(), 8);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t frame = 0; frame < numFrames; frame++) {
+		renderer.render(output, forward.data(), right.data(), up.data(),
+				width, height, static_cast<double>(width) / height, 100);
+		renderer.waitForFinished();
+	}
+	double timeSpent = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now() - start).count();
+	return timeSpent / 1000000000 / numFrames;
+}
+
+bool testStorage(size_t numDims, std::uint32_t mazeWidth) {
+	const labyrinth_core::maze::StorageMode modes[] = {
+		labyrinth_core::maze::StorageMode::BYTE,
+		labyrinth_core::maze::StorageMode::NIBBLE,
+		labyrinth_core::maze::StorageMode::TRIBIT
+	};
+	const char* names[] = {"byte", "nibble", "tribit"};
+	labyrinth_core::maze::Maze byteMaze (
+			makeOptions(numDims, mazeWidth, modes[0]));
+	std::vector<std::uint8_t> byteOutput (1920 * 1080 * 4);
+	double byteSeconds = timeFrames(byteMaze, byteOutput.data());
+	std::cout << numDims << "D, width " << mazeWidth << ", " << names[0] <<
+			": " << byteMaze.getNumBytes() << " bytes, " <<
+			byteSeconds << "s per frame" << std::endl;
+	std::uint32_t* dims = byteMaze.getDimensions();
+	size_t numBlocks = 1;
+	for (size_t i = 0; i < numDims; i++) {
+		numBlocks *= dims[i];
+	}
+	delete[] dims;
+
+	bool toreturn = true;
+	for (size_t m = 1; m < 3; m++) {
+		labyrinth_core::maze::Maze maze (
+				makeOptions(numDims, mazeWidth, modes[m]));
+		size_t numWrong = 0;
+		for (size_t i = 0; i < numBlocks; i++) {
+			if ((maze.getBlock(i) != byteMaze.getBlock(i)) ||
+					(maze.isOccupied(i) != byteMaze.isOccupied(i))) {
+				numWrong++;
+			}
+		}
+		std::vector<std::uint8_t> output (1920 * 1080 * 4);
+		double seconds = timeFrames(maze, output.data());
+		std::cout << numDims << "D, width " << mazeWidth << ", " << names[m] <<
+				": " << maze.getNumBytes() << " bytes, " <<
+				seconds << "s per frame, " << numWrong << " blocks wrong, " <<
+				((output == byteOutput)? "same": "different") <<
+				" pixels" << std::endl;
+		if ((numWrong > 0) || (output != byteOutput)) {
+			toreturn = false;
+		}
+	}
+	return toreturn;
+}
+
+bool testWidening() {
+	std::uint32_t dims[] = {10, 10, 10};
+	labyrinth_core::maze::Maze maze (3, dims,
+			labyrinth_core::maze::StorageMode::TRIBIT);
+	// more different blocks than 3 bits can hold
+	for (size_t i = 0; i < 1000; i++) {
+		maze.setBlock(i, i % 12);
+	}
+	bool toreturn = maze.getStorageMode() ==
+			labyrinth_core::maze::StorageMode::NIBBLE;
+	for (size_t i = 0; i < 1000; i++) {
+		if (maze.getBlock(i) != i % 12) {
+			toreturn = false;
+		}
+	}
+	// can't go back down to 3 bits
+	toreturn = toreturn &&
+			!maze.setStorageMode(labyrinth_core::maze::StorageMode::TRIBIT) &&
+			maze.setStorageMode(labyrinth_core::maze::StorageMode::BYTE) &&
+			maze.setStorageMode(labyrinth_core::maze::StorageMode::NIBBLE);
+	for (size_t i = 0; i < 1000; i++) {
+		if (maze.getBlock(i) != i % 12) {
+			toreturn = false;
+		}
+	}
+	std::cout << "widening: " << (toreturn? "ok": "broken") << std::endl;
+	return toreturn;
+}
+
+int main() {
+	bool isFine = testWidening();
+	isFine = testStorage(3, 30) && isFine;
+	isFine = testStorage(4, 12) && isFine;
+	isFine = testStorage(5, 8) && isFine;
+	return isFine? 0: 1;
+}
@@ -0,0 +1,44 @@
+#ifndef TEST_MAZE_TEST_COMMON_HPP_
+#define TEST_MAZE_TEST_COMMON_HPP_
+
+#include <labyrinth_core/maze/maze.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The options the tests generate their mazes with, carving all of it with
+ * HEADS. Tests set whatever else they need on top.
+ */
+inline labyrinth_core::maze::Maze::MazeGenerationOptions makeTestOptions(
+		const std::vector<std::uint32_t>& dims, const std::string& seed) {
+	labyrinth_core::maze::Maze::MazeGenerationOptions options;
+	options.setDimensions(dims);
+	options.setSeed(seed);
+	options.setDensity(1);
+	options.setBranchProbability(0.05);
+	options.setBranchDeathProbability(0.01);
+	options.setTwistProbability(0.5);
+	options.setFlowProbability(0.7);
+	options.setRestrictNewAmount(1);
+	options.setLoopProbability(0);
+	options.setBlockProbability(0);
+	options.setMaxUseless(50000000);
+	return options;
+}
+
+inline labyrinth_core::maze::Maze::MazeGenerationOptions makeTestOptions(
+		size_t numDims, std::uint32_t width, const std::string& seed) {
+	return makeTestOptions(std::vector<std::uint32_t>(numDims, width), seed);
+}
+
+inline double getSeconds(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::duration<double>>(
+			std::chrono::high_resolution_clock::now() - start).count();
+}
+
+#endif /* TEST_MAZE_TEST_COMMON_HPP_ */
@@ -6,7 +6,7 @@
 
 #include "libs/lodepng.h"
 
-void writeIMG(const labyrinth_core::maze::MazeViewer& viewer,
+void writeIMG(labyrinth_core::maze::MazeViewer& viewer,
 		size_t width, size_t height) {
 	const std::string dirname = "/home/study/produceviewer/";
 	static size_t i = 0;